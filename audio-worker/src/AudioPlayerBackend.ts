@@ -25,6 +25,7 @@ import { AudioBackendMessage, VisualizerMessage } from "shared/visualizer";
 import WebAssemblyWrapper from "shared/wasm/WebAssemblyWrapper";
 import AbstractBackend from "shared/worker/AbstractBackend";
 import Effects from "shared/worker/Effects";
+import TimeStretcher from "shared/worker/TimeStretcher";
 const dbg = debugFor("AudioPlayerBackend");
 
 import AudioSource from "./AudioSource";
@@ -35,11 +36,14 @@ type AudioBufferClearOption = "no-clear" | "clear-data-and-offsets";
 
 interface AudioDataItem {
     samplesWritten: number;
+    // Behind samplesWritten while the time stretcher holds the rest.
+    samplesBuffered: number;
     length: number;
     startFrames: number;
     endFrames: number;
     channelData: ChannelData;
     audioSourceId: number;
+    endsAudioSource: boolean;
 }
 
 interface InitialBufferOptions {
@@ -59,14 +63,20 @@ interface AudioSourceEventWaiter {
 
 export class AudioData {
     private readonly cab: CircularAudioBuffer;
+    private readonly wasm: WebAssemblyWrapper;
+    private readonly sampleRate: number;
+    private timeStretcher: TimeStretcher | null = null;
+    private stretchedSourceFrames: number = 0;
     private data: AudioDataItem[];
     private clearedFrameIndex: number = 0;
     private seekFrameOffset: number = 0;
     private samplesWrittenWaiters: AudioSourceEventWaiter[] = [];
     private allSamplesWrittenWaiters: AudioSourceEventWaiter[] = [];
 
-    constructor(cab: CircularAudioBuffer, initial: AudioDataInitial) {
+    constructor(cab: CircularAudioBuffer, wasm: WebAssemblyWrapper, sampleRate: number, initial: AudioDataInitial) {
         this.cab = cab;
+        this.wasm = wasm;
+        this.sampleRate = sampleRate;
         this.data = [];
         this.cab.setPaused();
         if (initial === "background") {
@@ -89,6 +99,25 @@ export class AudioData {
         return this.cab.isPaused();
     }
 
+    /**
+     * Audio is stretched as it's written into the buffer, so what is already buffered
+     * plays at the previous rate until it's cleared. The buffer marks where the rate
+     * changes for the reader.
+     */
+    setPlaybackRate(playbackRate: number) {
+        if (playbackRate === 1 && !this.timeStretcher) {
+            return;
+        }
+        if (!this.timeStretcher) {
+            this.timeStretcher = new TimeStretcher(this.wasm, {
+                channelCount: this.cab.channelCount,
+                sampleRate: this.sampleRate,
+            });
+        }
+        this.timeStretcher.setPlaybackRate(playbackRate);
+        this.cab.setPlaybackRate(this.timeStretcher.playbackRate);
+    }
+
     pause(fadeOutDelayFrames: number) {
         this.cab.requestPause(fadeOutDelayFrames);
     }
@@ -131,6 +160,9 @@ export class AudioData {
             const b = this.data[i];
             ret += (b.length - b.samplesWritten) / sampleRate;
         }
+        if (this.timeStretcher) {
+            ret += this.timeStretcher.getBufferedFrames() / sampleRate;
+        }
         return ret + this.cab.getReadableFramesLength() / sampleRate;
     }
 
@@ -143,6 +175,8 @@ export class AudioData {
     clear(seekOffset: number) {
         this.data = [];
         this.cab.clear();
+        this.timeStretcher?.reset();
+        this.stretchedSourceFrames = 0;
         dbg("clear", "cleared");
         this.clearOffsets(seekOffset);
     }
@@ -161,11 +195,13 @@ export class AudioData {
         if (hasSound) {
             this.data.push({
                 samplesWritten: 0,
+                samplesBuffered: 0,
                 startFrames: bufferDescriptor.startFrames,
                 endFrames: bufferDescriptor.endFrames,
                 channelData,
                 length: bufferDescriptor.length,
                 audioSourceId: bufferDescriptor.audioSourceId,
+                endsAudioSource: false,
             });
         } else {
             this.clearedFrameIndex -= bufferDescriptor.length;
@@ -176,6 +212,24 @@ export class AudioData {
         this.writeToAudioBuffer();
     }
 
+    /**
+     * No more data is coming for audioSource, what the time stretcher holds of it is rendered
+     * without waiting for more input.
+     */
+    endAudioSource(audioSource: AudioSource) {
+        for (let i = this.data.length - 1; i >= 0; --i) {
+            const item = this.data[i];
+            if (item.audioSourceId === audioSource.id) {
+                item.endsAudioSource = true;
+                if (item.samplesWritten >= item.length) {
+                    this.timeStretcher?.flush();
+                }
+                break;
+            }
+        }
+        this.writeToAudioBuffer();
+    }
+
     getCurrentlyPlayedFrame() {
         const current = this.cab.getCurrentFrameNumber();
         if (current >= this.clearedFrameIndex) {
@@ -290,7 +344,7 @@ export class AudioData {
         const ids: Set<number> = new Set();
         for (let i = 0; i < this.data.length; ++i) {
             const item = this.data[i];
-            if (item.samplesWritten >= item.length) {
+            if (item.samplesBuffered >= item.length) {
                 ids.add(item.audioSourceId);
             } else if (ids.has(item.audioSourceId)) {
                 ids.delete(item.audioSourceId);
@@ -304,7 +358,7 @@ export class AudioData {
     _checkWriteWaiters() {
         for (let i = 0; i < this.data.length; ++i) {
             const item = this.data[i];
-            if (item.samplesWritten > 0) {
+            if (item.samplesBuffered > 0) {
                 this._checkWaiters(item.audioSourceId, this.samplesWrittenWaiters);
             }
         }
@@ -318,7 +372,7 @@ export class AudioData {
     hasWrittenSamplesFor(audioSource: AudioSource) {
         for (let i = 0; i < this.data.length; ++i) {
             const item = this.data[i];
-            if (item.samplesWritten > 0 && item.audioSourceId === audioSource.id) {
+            if (item.samplesBuffered > 0 && item.audioSourceId === audioSource.id) {
                 return true;
             }
         }
@@ -328,7 +382,7 @@ export class AudioData {
     allBuffersWrittenFor(audioSource: AudioSource) {
         for (let i = 0; i < this.data.length; ++i) {
             const item = this.data[i];
-            if (item.samplesWritten < item.length && item.audioSourceId === audioSource.id) {
+            if (item.samplesBuffered < item.length && item.audioSourceId === audioSource.id) {
                 return false;
             }
         }
@@ -340,9 +394,20 @@ export class AudioData {
         if (!q.length) {
             return;
         }
-        const cab = this.cab;
+        const { cab, timeStretcher } = this;
         let writableFramesLength: number;
         while ((writableFramesLength = cab.getWritableFramesLength()) > 0) {
+            if (timeStretcher) {
+                const { channels, frames } = timeStretcher.read(writableFramesLength);
+                if (frames > 0) {
+                    cab.write(channels, frames);
+                    this._stretchedFramesBuffered(frames * timeStretcher.playbackRate);
+                    continue;
+                }
+                if (timeStretcher.getBufferedFrames() === 0) {
+                    this._stretcherDrained();
+                }
+            }
             let item: AudioDataItem | null = null;
             for (let i = 0; i < q.length; ++i) {
                 const maybeItem = q[i]!;
@@ -353,17 +418,54 @@ export class AudioData {
             }
 
             if (item === null) {
-                return;
+                break;
             }
 
-            const frames = Math.min(item.length - item.samplesWritten, writableFramesLength);
             const channels = item.channelData.map(v => v.subarray(item!.samplesWritten));
+            if (timeStretcher) {
+                const frames = Math.min(item.length - item.samplesWritten, timeStretcher.getWritableFrames());
+                const written = timeStretcher.write(channels, frames);
+                item.samplesWritten += written;
+                if (written === 0) {
+                    break;
+                }
+                if (item.endsAudioSource && item.samplesWritten >= item.length) {
+                    timeStretcher.flush();
+                }
+                continue;
+            }
+            const frames = Math.min(item.length - item.samplesWritten, writableFramesLength);
             const written = cab.write(channels, frames);
             item.samplesWritten += written;
+            item.samplesBuffered = item.samplesWritten;
             writableFramesLength -= written;
-            this._checkWriteWaiters();
         }
-        this._checkAllBuffersWrittenWaiters();
+        this._checkAllWaiters();
+    }
+
+    /**
+     * Credits source frames that the time stretcher has rendered into the buffer to the
+     * items they were written from, in order.
+     */
+    _stretchedFramesBuffered(sourceFrames: number) {
+        let remaining = this.stretchedSourceFrames + sourceFrames;
+        const q = this.data;
+        for (let i = 0; i < q.length && remaining >= 1; ++i) {
+            const item = q[i]!;
+            const frames = Math.min(item.samplesWritten - item.samplesBuffered, Math.floor(remaining));
+            item.samplesBuffered += frames;
+            remaining -= frames;
+        }
+        // The rate only approximates how much input the output stands for.
+        this.stretchedSourceFrames = remaining < 1 ? remaining : 0;
+    }
+
+    _stretcherDrained() {
+        const q = this.data;
+        for (let i = 0; i < q.length; ++i) {
+            q[i]!.samplesBuffered = q[i]!.samplesWritten;
+        }
+        this.stretchedSourceFrames = 0;
     }
 }
 
@@ -495,7 +597,8 @@ export default class AudioPlayerBackend extends AbstractBackend<
     _sendTimeUpdate() {
         const { totalTime, currentTime } = this;
         if (totalTime > 0 && totalTime > currentTime) {
-            const remaining = totalTime - currentTime;
+            // Counted to where the audio ends so that trailing silence isn't crossfaded.
+            const remaining = Math.max(0, this._mainAudioSource!.audioEnd - currentTime);
             const crossfadeDuration = this.getCrossfadeDuration(this._mainAudioSource!);
             if (remaining <= crossfadeDuration + PRELOAD_THRESHOLD_SECONDS) {
                 void this._requestNextTrackIfNeeded("sendTimeUpdate");
@@ -651,9 +754,17 @@ export default class AudioPlayerBackend extends AbstractBackend<
 
     _initialAudioConfigurationReceived = (config: AudioBackendInitOpts) => {
         this._config = config;
-        this.primaryData = new AudioData(new CircularAudioBuffer(config.sab, config.channelCount), "foreground");
+        const { sampleRate, channelCount } = config;
+        this.primaryData = new AudioData(
+            new CircularAudioBuffer(config.sab, channelCount),
+            this._wasm,
+            sampleRate,
+            "foreground"
+        );
         this.secondaryData = new AudioData(
-            new CircularAudioBuffer(config.backgroundSab, config.channelCount),
+            new CircularAudioBuffer(config.backgroundSab, channelCount),
+            this._wasm,
+            sampleRate,
             "background"
         );
         this.activeData = this.primaryData;
@@ -698,6 +809,7 @@ export default class AudioPlayerBackend extends AbstractBackend<
         if (!this._config) {
             throw new Error("initial configuration not received");
         }
+        const { playbackRate } = this._config;
         for (const key of typedKeys(config)) {
             const value = config[key];
             if (value) {
@@ -706,6 +818,10 @@ export default class AudioPlayerBackend extends AbstractBackend<
             }
         }
         this._configUpdated();
+        if (this._config.playbackRate !== playbackRate) {
+            // Buffered audio was stretched at the previous rate, it's replaced like on a seek.
+            void this._seek({ time: this.currentTime, resumeAfterInitialization: false });
+        }
     };
 
     setSwapTargets(swapTargets: SwapTargetType, source: string) {
@@ -741,7 +857,7 @@ export default class AudioPlayerBackend extends AbstractBackend<
             time = Math.max(
                 0,
                 Math.min(
-                    this.totalTime -
+                    this._mainAudioSource.audioEnd -
                         this.getCrossfadeDuration(this._mainAudioSource) -
                         TIME_UPDATE_RESOLUTION -
                         this.bufferTime,
@@ -886,6 +1002,9 @@ export default class AudioPlayerBackend extends AbstractBackend<
                 this._timeUpdateReceived(false);
                 cancellationToken.check();
                 if (audioSource.ended || audioSource.destroyed) {
+                    if (audioSource.ended) {
+                        targetData.endAudioSource(audioSource);
+                    }
                     if (!initialBufferLoaded) {
                         dbg(label, "initial buffer not loaded before ending", "audioSource", audioSourceString);
                         if (initialBufferOptions.clear) {
@@ -1056,6 +1175,8 @@ export default class AudioPlayerBackend extends AbstractBackend<
         const { bufferTime, sampleRate } = this._config!;
         const bufferFrameLength = closestPowerOf2(Math.round(bufferTime * sampleRate));
         this._config!.bufferTime = bufferFrameLength / sampleRate;
+        this.primaryData!.setPlaybackRate(this._config!.playbackRate);
+        this.secondaryData!.setPlaybackRate(this._config!.playbackRate);
     }
 
     get currentTime() {
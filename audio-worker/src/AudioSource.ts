@@ -15,6 +15,8 @@ import AudioPlayerBackend, { AudioData } from "./AudioPlayerBackend";
 import seeker from "./seeker";
 
 const dbg = debugFor("AudioSource");
+// Leading silence shorter than this is played rather than seeked past.
+const MIN_SKIPPED_SILENCE_SECONDS = 0.25;
 
 interface SeekResult {
     baseTime: number;
@@ -45,6 +47,7 @@ export default class AudioSource extends CancellableOperations(
     private _crossfader: Crossfader;
     private _initialized: boolean = false;
     private _lastFrame: number = 0;
+    private _audioEnd: number = 0;
     private _targetData: AudioData | null = null;
     codecName: CodecName;
     private _destroyed: boolean;
@@ -104,6 +107,17 @@ export default class AudioSource extends CancellableOperations(
         return this.demuxData.duration;
     }
 
+    /**
+     * Where the audible part of the track ends, the fade-out and crossfade end here
+     * instead of at the end of trailing silence when silence trimming is enabled.
+     */
+    get audioEnd() {
+        if (!this.demuxData) {
+            return 0;
+        }
+        return this._audioEnd;
+    }
+
     get sampleRate() {
         if (!this.demuxData) {
             throw new Error(`no demuxData set`);
@@ -327,6 +341,27 @@ export default class AudioSource extends CancellableOperations(
 
         this.demuxData = demuxData;
         this._filePosition = this.demuxData!.dataStart;
+
+        let audioStart = 0;
+        this._audioEnd = demuxData.duration;
+        if (this.backend.silenceTrimming) {
+            const trackInfo = await tagDatabase.getTrackInfoByTrackUid(trackUid);
+            cancellationToken.check();
+            if (
+                trackInfo &&
+                trackInfo.audioStart !== undefined &&
+                trackInfo.audioStart >= MIN_SKIPPED_SILENCE_SECONDS
+            ) {
+                audioStart = trackInfo.audioStart;
+            }
+            if (
+                trackInfo &&
+                trackInfo.audioEnd !== undefined &&
+                demuxData.duration - trackInfo.audioEnd >= MIN_SKIPPED_SILENCE_SECONDS
+            ) {
+                this._audioEnd = trackInfo.audioEnd;
+            }
+        }
         const { sampleRate, channelCount, targetBufferLengthAudioFrames, duration, _crossfader: crossfader } = this;
 
         dbg(
@@ -344,9 +379,10 @@ export default class AudioSource extends CancellableOperations(
         const loudnessAnalyzerSerializedState = await tagDatabase.getLoudnessAnalyzerStateForTrack(trackUid);
         cancellationToken.check();
 
-        if (loudnessAnalyzerSerializedState) {
-            this._loudnessNormalizer.initializeFromSerializedState(loudnessAnalyzerSerializedState);
-        } else {
+        if (
+            !loudnessAnalyzerSerializedState ||
+            !this._loudnessNormalizer.initializeFromSerializedState(loudnessAnalyzerSerializedState)
+        ) {
             this._loudnessNormalizer.initialize(channelCount, sampleRate);
         }
 
@@ -360,35 +396,35 @@ export default class AudioSource extends CancellableOperations(
             bufferAudioFrameCount: targetBufferLengthAudioFrames,
             effects,
             bufferTime,
-            duration,
+            duration: this._audioEnd,
             crossfader,
         });
         this._lastFrame = Math.round(demuxData.duration * this.backend.sampleRate);
 
         const crossfadeDuration = getCrossfadeDuration(this);
-        this._crossfader.setDuration(crossfadeDuration);
-        this._crossfader.setFadeInEnabled(isPreloadForNextTrack);
-        this._crossfader.setFadeOutEnabled(true);
+        const startTime = progress > 0 ? progress * demuxData.duration : audioStart;
 
-        if (progress > 0) {
-            const time = progress * demuxData.duration;
-            let { baseTime } = await this._seek(time, cancellationToken);
+        let baseTime = 0;
+        if (startTime > 0) {
+            ({ baseTime } = await this._seek(startTime, cancellationToken));
             cancellationToken.check();
             baseTime = Math.min(
-                demuxData.duration - crossfadeDuration - TIME_UPDATE_RESOLUTION - this.backend.bufferTime,
+                this._audioEnd - crossfadeDuration - TIME_UPDATE_RESOLUTION - this.backend.bufferTime,
                 Math.max(0, baseTime)
             );
-            cancellationToken.check();
-            this._initialized = true;
-            return {
-                baseTime,
-                baseFrame: Math.round(baseTime * this.backend.sampleRate),
-                demuxData,
-                cancellationToken,
-            };
         }
+
+        // After seeking, which resets the crossfader for seeks within the track.
+        this._crossfader.setDuration(crossfadeDuration);
+        this._crossfader.setFadeInEnabled(isPreloadForNextTrack);
+        this._crossfader.setFadeOutEnabled(true);
         this._initialized = true;
-        return { baseTime: 0, baseFrame: 0, demuxData, cancellationToken };
+        return {
+            baseTime,
+            baseFrame: Math.round(baseTime * this.backend.sampleRate),
+            demuxData,
+            cancellationToken,
+        };
     }
 
     async _decodeNextBuffer(
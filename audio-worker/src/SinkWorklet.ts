@@ -1,5 +1,5 @@
 import { CURVE_LENGTH, getCurve, MAX_FRAME, TIME_UPDATE_RESOLUTION, WEB_AUDIO_BLOCK_SIZE } from "shared/src/audio";
-import TimeStretcher from "shared/src/worker/TimeStretcher";
+import CircularAudioBuffer from "shared/src/worker/CircularAudioBuffer";
 
 const FADE_MINIMUM_VOLUME = 0.05;
 declare global {
@@ -23,7 +23,7 @@ declare global {
 }
 
 class SinkWorklet extends AudioWorkletProcessor<{}> {
-    private cab: TimeStretcher | null = null;
+    private cab: CircularAudioBuffer | null = null;
     private resumeFadeInFrameCount: number = 0;
     private resumeFadeInCurve = getCurve(new Float32Array(CURVE_LENGTH + 1), FADE_MINIMUM_VOLUME, 1);
     private framesProcessedAfterPauseRequest: number = 0;
@@ -36,26 +36,18 @@ class SinkWorklet extends AudioWorkletProcessor<{}> {
     private baseVolume: number = FADE_MINIMUM_VOLUME;
     private lastFramePosted: number = 0;
     private previousBlockWasPaused: boolean = true;
-    private playbackRate: number = 1;
 
     constructor() {
         super();
         this.port.onmessage = e => {
             if (e.data.type === "init") {
                 this.resumeFadeInFrameCount = Math.round(0.3 * sampleRate);
-                this.cab = new TimeStretcher(e.data.sab, {
-                    channelCount: e.data.channelCount,
-                    sampleRate,
-                    playbackRate: this.playbackRate,
-                });
+                this.cab = new CircularAudioBuffer(e.data.sab, e.data.channelCount);
                 if (e.data.background) {
                     this.cab.setBackgrounded();
                 } else {
                     this.cab.unsetBackgrounded();
                 }
-            } else if (e.data.type === "setPlaybackRate") {
-                this.playbackRate = Math.round(Math.min(4, Math.max(0.5, e.data.playbackRate)) * 20) / 20;
-                this.cab!.updatePlaybackRate(this.playbackRate);
             }
         };
     }
@@ -134,7 +126,8 @@ class SinkWorklet extends AudioWorkletProcessor<{}> {
         if (framesWritten < 0) {
             return true;
         }
-        this.frameNumber = (this.frameNumber + Math.round(framesWritten * this.playbackRate)) % MAX_FRAME;
+        // Time stretched audio advances the source by more or less than what was read.
+        this.frameNumber = (this.frameNumber + cab.takeSourceFramesRead()) % MAX_FRAME;
         if (volume !== -1) {
             for (const channel of channels) {
                 for (let i = 0; i < framesWritten; ++i) {
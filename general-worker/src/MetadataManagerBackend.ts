@@ -30,6 +30,7 @@ import getCodec from "shared/worker/codec";
 import Fingerprinter from "shared/worker/Fingerprinter";
 import JobProcessor from "shared/worker/JobProcessor";
 import LoudnessAnalyzer from "shared/worker/LoudnessAnalyzer";
+import LoudnessScanner from "shared/worker/LoudnessScanner";
 import getCodecName from "shared/worker/sniffer";
 
 import parseAcoustId, { AcoustIdResponse, CoverArtResponse, ParsedAcoustIdResult } from "./acoustId";
@@ -219,6 +220,23 @@ export default class MetadataManagerBackend extends AbstractBackend<
                 this.postMessageToMetadataFrontend({ type: "albumArt", albumArt, trackUid, preference, requestReason });
             },
 
+            async getLoudnessOfTracks({ trackUids, requestReason }) {
+                if (!this.canUseDatabase()) return;
+                // Merged from the stored histograms without decoding, tracks that haven't
+                // been analyzed yet are left out.
+                const histograms = await this._tagdb.getLoudnessHistogramsForTracks(trackUids);
+                const { integratedLoudness, loudnessRange } = new LoudnessAnalyzer(this._wasm).mergeHistograms(
+                    histograms
+                );
+                this.postMessageToMetadataFrontend({
+                    type: "loudnessOfTracks",
+                    integratedLoudness,
+                    loudnessRange,
+                    trackUids,
+                    requestReason,
+                });
+            },
+
             async parseMetadata({ fileReference }) {
                 if (!this.canUseDatabase()) return;
                 const trackUid = await fileReferenceToTrackUid(fileReference);
@@ -412,7 +430,7 @@ export default class MetadataManagerBackend extends AbstractBackend<
         trackUid: ArrayBuffer,
         fileReference: FileReference
     ) => {
-        let decoder, loudnessAnalyzer;
+        let scanner, loudnessAnalyzer;
         const { _wasm: wasm } = this;
         try {
             const trackInfo = await this.getTrackInfoByTrackUid(trackUid);
@@ -436,60 +454,50 @@ export default class MetadataManagerBackend extends AbstractBackend<
                 }
             }
 
-            const DecoderContext = getCodec(trackInfo.codecName!);
-
-            if (!DecoderContext) {
-                throw new Error("unknown codec " + trackInfo.codecName);
+            if (trackInfo.codecName !== "mp3") {
+                throw codecNotSupportedError();
             }
 
             const { sampleRate, duration, channels, demuxData } = trackInfo;
-            const sourceSampleRate = sampleRate;
-            const sourceChannelCount = channels as ChannelCount;
-            const { dataStart, dataEnd } = demuxData;
+            const { dataStart, dataEnd, maxByteSizePerAudioFrame } = demuxData as TrackMetadata;
 
             if (duration >= 15) {
-                decoder = new DecoderContext(wasm, {
-                    targetBufferLengthAudioFrames: BUFFER_DURATION * sampleRate,
-                });
-                decoder.start(demuxData as TrackMetadata);
-
+                scanner = new LoudnessScanner(wasm, demuxData as TrackMetadata);
                 loudnessAnalyzer = new LoudnessAnalyzer(wasm);
-                loudnessAnalyzer.initialize(sourceChannelCount, sourceSampleRate);
+                loudnessAnalyzer.initialize(channels as ChannelCount, sampleRate);
 
-                const audioPipeline = new AudioProcessingPipeline(wasm, {
-                    sourceSampleRate,
-                    sourceChannelCount,
-                    destinationSampleRate: sourceSampleRate,
-                    destinationChannelCount: sourceChannelCount,
-                    decoder,
-                    bufferTime: BUFFER_DURATION,
-                    duration,
-                    bufferAudioFrameCount: sourceSampleRate * BUFFER_DURATION,
-                    loudnessAnalyzer,
-                });
-
-                const fileStartPosition = dataStart!;
-                let filePosition = fileStartPosition;
-                const fileEndPosition = dataEnd!;
+                const bytesToRead = Math.ceil(BUFFER_DURATION * sampleRate * maxByteSizePerAudioFrame);
+                let filePosition = dataStart;
+                const fileEndPosition = dataEnd;
 
-                while (filePosition < fileEndPosition && !loudnessAnalyzer.isHistoryStateFilled()) {
-                    const bytesRead = await audioPipeline.decodeFromFileViewAtOffset(
-                        fileView,
-                        filePosition,
-                        demuxData as TrackMetadata,
-                        cancellationToken,
-                        0
-                    );
-                    audioPipeline.consumeFilledBuffer();
+                while (filePosition < fileEndPosition) {
+                    await fileView.readBlockOfSizeAt(bytesToRead, filePosition, cancellationToken);
+                    cancellationToken.check();
+                    const src = fileView.blockAtOffset(filePosition - fileView.start);
+                    const bytesRead = scanner.analyzeMp3(src, loudnessAnalyzer);
+                    if (bytesRead === 0) {
+                        break;
+                    }
                     filePosition += bytesRead;
                 }
 
                 const serializedState = loudnessAnalyzer.serialize();
                 await this._tagdb.setLoudnessAnalyzerStateForTrack(trackUid, serializedState);
+                await this._tagdb.setLoudnessHistogramsForTrack(trackUid, loudnessAnalyzer.serializeHistograms());
+                const { integratedLoudness, loudnessRange, maxShortTermLoudness } =
+                    loudnessAnalyzer.getLoudnessStatistics();
+                await this._tagdb.updateLoudnessStatistics(
+                    trackUid,
+                    integratedLoudness,
+                    loudnessRange,
+                    maxShortTermLoudness
+                );
+                const { audioStart, audioEnd } = scanner.getAudioBounds();
+                await this._tagdb.updateAudioBounds(trackUid, audioStart / sampleRate, audioEnd / sampleRate);
                 await this._tagdb.updateHasInitialLoudnessInfo(trackUid, true);
             }
         } finally {
-            if (decoder) decoder.destroy();
+            if (scanner) scanner.destroy();
             if (loudnessAnalyzer) loudnessAnalyzer.destroy();
         }
     };
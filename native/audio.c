@@ -6,6 +6,7 @@
 #include "channel_mixer.c"
 #include "mp3_decoder.c"
 #include "effects.c"
+#include "time_stretcher.c"
 #include "loudness_analyzer.c"
 
 extern void initialize(int, int, int);
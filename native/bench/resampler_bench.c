@@ -0,0 +1,344 @@
+// Host-built quality/throughput benchmark for the resampler converters.
+//
+// Build and run with `yarn bench-resampler`, or manually:
+//
+//   cc -O2 -o build/resampler_bench native/bench/resampler_bench.c -lm
+//   ./build/resampler_bench > resampler_bench.json
+//
+// Unlike the wasm build this links against the host libc, the converters are compiled
+// straight from the vendored libsamplerate sources. The sinc converters are disabled in
+// the wasm module but are measured here so that the numbers exist when deciding whether
+// to enable them. Output is a single JSON document on stdout.
+
+#define _POSIX_C_SOURCE 199309L
+#define HAVE_STDBOOL_H 1
+#define ENABLE_SINC_FAST_CONVERTER 1
+#define ENABLE_SINC_MEDIUM_CONVERTER 1
+#define ENABLE_LINEAR_CONVERTER 1
+#define PACKAGE "bench"
+#define VERSION "1.0"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../third-party/libsamplerate/samplerate.c"
+#include "../third-party/libsamplerate/src_zoh.c"
+#include "../third-party/libsamplerate/src_linear.c"
+#include "../third-party/libsamplerate/src_sinc.c"
+
+#define BENCH_FORMAT_VERSION 1
+#define BENCH_CHANNELS 2
+#define BENCH_BLOCK_FRAMES 1024
+#define BENCH_THROUGHPUT_SECONDS 10
+#define BENCH_THROUGHPUT_RUNS 5
+#define BENCH_TONE_SECONDS 2
+#define BENCH_TONE_AMPLITUDE 0.5
+#define BENCH_THD_FREQUENCY 1000.0
+#define BENCH_PASSBAND_POINTS 16
+#define BENCH_PASSBAND_EDGE 0.35
+#define BENCH_ALIAS_POINTS 8
+// Output frames discarded at both ends of tone measurements so filter delay and
+// start-up transients don't count as distortion.
+#define BENCH_SETTLE_FRAMES 4096
+#define BENCH_FLOOR_DB -200.0
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct {
+    int type;
+    const char* name;
+} BenchConverter;
+
+typedef struct {
+    uint32_t source_sample_rate;
+    uint32_t destination_sample_rate;
+} BenchRatio;
+
+static const BenchConverter converters[] = {
+    { SRC_ZERO_ORDER_HOLD, "zoh" },
+    { SRC_LINEAR, "linear" },
+    { SRC_SINC_FASTEST, "sinc_fastest" },
+    { SRC_SINC_MEDIUM_QUALITY, "sinc_medium" },
+};
+
+static const BenchRatio ratios[] = {
+    { 44100, 48000 },
+    { 48000, 44100 },
+    { 22050, 48000 },
+    { 32000, 48000 },
+    { 88200, 48000 },
+    { 96000, 48000 },
+};
+
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static double to_db(double ratio) {
+    if (ratio <= 0.0) {
+        return BENCH_FLOOR_DB;
+    }
+    return MAX(BENCH_FLOOR_DB, 20.0 * log10(ratio));
+}
+
+static uint32_t xorshift_state = 0x9E3779B9u;
+static float white_noise(void) {
+    xorshift_state ^= xorshift_state << 13;
+    xorshift_state ^= xorshift_state >> 17;
+    xorshift_state ^= xorshift_state << 5;
+    return (float)((double)xorshift_state / 4294967295.0 * 2.0 - 1.0) * 0.5f;
+}
+
+static void fill_sine(float* dst, uint32_t frames, double frequency, uint32_t sample_rate) {
+    const double w = 2.0 * M_PI * frequency / (double)sample_rate;
+    for (uint32_t i = 0; i < frames; ++i) {
+        float sample = (float)(BENCH_TONE_AMPLITUDE * sin(w * (double)i));
+        for (uint32_t ch = 0; ch < BENCH_CHANNELS; ++ch) {
+            dst[i * BENCH_CHANNELS + ch] = sample;
+        }
+    }
+}
+
+// Streams the whole input through the converter in player-sized blocks. Returns
+// the number of output frames produced or -1 on error.
+static long run_converter(SRC_STATE* state,
+                          double ratio,
+                          const float* input,
+                          uint32_t input_frames,
+                          float* output,
+                          uint32_t output_capacity) {
+    src_reset(state);
+    uint32_t input_offset = 0;
+    long output_offset = 0;
+
+    for (;;) {
+        SRC_DATA data;
+        uint32_t block = MIN(BENCH_BLOCK_FRAMES, input_frames - input_offset);
+        data.data_in = input + input_offset * BENCH_CHANNELS;
+        data.input_frames = block;
+        data.data_out = output + output_offset * BENCH_CHANNELS;
+        data.output_frames = output_capacity - output_offset;
+        data.end_of_input = input_offset + block >= input_frames;
+        data.src_ratio = ratio;
+
+        if (src_process(state, &data)) {
+            return -1;
+        }
+        input_offset += data.input_frames_used;
+        output_offset += data.output_frames_gen;
+
+        if (data.end_of_input && data.output_frames_gen == 0) {
+            break;
+        }
+        if (output_offset >= output_capacity) {
+            break;
+        }
+    }
+    return output_offset;
+}
+
+// Least-squares fit of a sine of known frequency (plus DC) to the left channel.
+// Returns the fitted amplitude and stores residual/fitted RMS ratio in residual_out.
+static double fit_sine(const float* samples,
+                       long frames,
+                       double frequency,
+                       uint32_t sample_rate,
+                       double* residual_out) {
+    const double w = 2.0 * M_PI * frequency / (double)sample_rate;
+    long start = MIN(BENCH_SETTLE_FRAMES, frames / 4);
+    long end = MAX(start + 1, frames - BENCH_SETTLE_FRAMES);
+    double ss = 0, sc = 0, cc = 0, s1 = 0, c1 = 0, n = 0;
+    double ys = 0, yc = 0, y1 = 0;
+
+    for (long i = start; i < end; ++i) {
+        double s = sin(w * (double)i);
+        double c = cos(w * (double)i);
+        double y = samples[i * BENCH_CHANNELS];
+        ss += s * s;
+        sc += s * c;
+        cc += c * c;
+        s1 += s;
+        c1 += c;
+        n += 1;
+        ys += y * s;
+        yc += y * c;
+        y1 += y;
+    }
+
+    // Solve the 3x3 normal equations [ss sc s1; sc cc c1; s1 c1 n] x = [ys yc y1].
+    double m[3][4] = {
+        { ss, sc, s1, ys },
+        { sc, cc, c1, yc },
+        { s1, c1, n, y1 },
+    };
+    for (int col = 0; col < 3; ++col) {
+        int pivot = col;
+        for (int row = col + 1; row < 3; ++row) {
+            if (fabs(m[row][col]) > fabs(m[pivot][col])) {
+                pivot = row;
+            }
+        }
+        for (int k = 0; k < 4; ++k) {
+            double tmp = m[col][k];
+            m[col][k] = m[pivot][k];
+            m[pivot][k] = tmp;
+        }
+        if (m[col][col] == 0.0) {
+            *residual_out = 1.0;
+            return 0.0;
+        }
+        for (int row = 0; row < 3; ++row) {
+            if (row != col) {
+                double f = m[row][col] / m[col][col];
+                for (int k = col; k < 4; ++k) {
+                    m[row][k] -= f * m[col][k];
+                }
+            }
+        }
+    }
+    double a = m[0][3] / m[0][0];
+    double b = m[1][3] / m[1][1];
+    double dc = m[2][3] / m[2][2];
+
+    double residual = 0.0;
+    for (long i = start; i < end; ++i) {
+        double fitted = a * sin(w * (double)i) + b * cos(w * (double)i) + dc;
+        double diff = samples[i * BENCH_CHANNELS] - fitted;
+        residual += diff * diff;
+    }
+    double amplitude = sqrt(a * a + b * b);
+    double fitted_rms = amplitude / sqrt(2.0);
+    *residual_out = fitted_rms > 0.0 ? sqrt(residual / n) / fitted_rms : 1.0;
+    return amplitude;
+}
+
+static double rms(const float* samples, long frames) {
+    long start = MIN(BENCH_SETTLE_FRAMES, frames / 4);
+    long end = MAX(start + 1, frames - BENCH_SETTLE_FRAMES);
+    double sum = 0.0;
+    for (long i = start; i < end; ++i) {
+        double y = samples[i * BENCH_CHANNELS];
+        sum += y * y;
+    }
+    return sqrt(sum / (double)(end - start));
+}
+
+static void bench(const BenchConverter* converter, const BenchRatio* r, int is_first) {
+    const double ratio = (double)r->destination_sample_rate / (double)r->source_sample_rate;
+    const uint32_t noise_frames = r->source_sample_rate * BENCH_THROUGHPUT_SECONDS;
+    const uint32_t tone_frames = r->source_sample_rate * BENCH_TONE_SECONDS;
+    const uint32_t max_input_frames = MAX(noise_frames, tone_frames);
+    const uint32_t output_capacity = (uint32_t)ceil(ratio * max_input_frames) + BENCH_BLOCK_FRAMES;
+    const double source_nyquist = r->source_sample_rate / 2.0;
+    const double destination_nyquist = r->destination_sample_rate / 2.0;
+    const double passband_edge = BENCH_PASSBAND_EDGE * MIN(r->source_sample_rate, r->destination_sample_rate);
+
+    float* input = malloc(sizeof(float) * max_input_frames * BENCH_CHANNELS);
+    float* output = malloc(sizeof(float) * output_capacity * BENCH_CHANNELS);
+    int error = 0;
+    SRC_STATE* state = src_new(converter->type, BENCH_CHANNELS, &error);
+    if (!input || !output || !state) {
+        fprintf(stderr, "%s: %s\n", converter->name, error ? src_strerror(error) : "out of memory");
+        exit(1);
+    }
+
+    // Throughput over white noise, best of several runs.
+    for (uint32_t i = 0; i < noise_frames * BENCH_CHANNELS; ++i) {
+        input[i] = white_noise();
+    }
+    double best_ns_per_frame = INFINITY;
+    for (int run = 0; run < BENCH_THROUGHPUT_RUNS; ++run) {
+        double start = now_ns();
+        long frames = run_converter(state, ratio, input, noise_frames, output, output_capacity);
+        double elapsed = now_ns() - start;
+        if (frames <= 0) {
+            fprintf(stderr, "%s: conversion failed\n", converter->name);
+            exit(1);
+        }
+        best_ns_per_frame = MIN(best_ns_per_frame, elapsed / (double)frames);
+    }
+
+    // THD+N of a 1 kHz tone.
+    double thd_n_ratio;
+    fill_sine(input, tone_frames, BENCH_THD_FREQUENCY, r->source_sample_rate);
+    long frames = run_converter(state, ratio, input, tone_frames, output, output_capacity);
+    fit_sine(output, frames, BENCH_THD_FREQUENCY, r->destination_sample_rate, &thd_n_ratio);
+
+    // Passband ripple from a stepped log sweep up to the passband edge.
+    double min_gain_db = INFINITY;
+    double max_gain_db = -INFINITY;
+    for (int i = 0; i < BENCH_PASSBAND_POINTS; ++i) {
+        double frequency = 20.0 * pow(passband_edge / 20.0, (double)i / (BENCH_PASSBAND_POINTS - 1));
+        double residual;
+        fill_sine(input, tone_frames, frequency, r->source_sample_rate);
+        frames = run_converter(state, ratio, input, tone_frames, output, output_capacity);
+        double gain_db = to_db(fit_sine(output, frames, frequency, r->destination_sample_rate, &residual) /
+                               BENCH_TONE_AMPLITUDE);
+        min_gain_db = MIN(min_gain_db, gain_db);
+        max_gain_db = MAX(max_gain_db, gain_db);
+    }
+
+    // Alias rejection: when downsampling, tones between the new and old Nyquist must
+    // vanish entirely. When upsampling, the spectral images of a tone near the old
+    // Nyquist are everything that is left after removing the tone itself.
+    double worst_alias_db = BENCH_FLOOR_DB;
+    for (int i = 0; i < BENCH_ALIAS_POINTS; ++i) {
+        double t = (i + 0.5) / BENCH_ALIAS_POINTS;
+        double frequency, alias_ratio;
+        if (destination_nyquist < source_nyquist) {
+            frequency = destination_nyquist * 1.1 + t * (source_nyquist * 0.95 - destination_nyquist * 1.1);
+            fill_sine(input, tone_frames, frequency, r->source_sample_rate);
+            frames = run_converter(state, ratio, input, tone_frames, output, output_capacity);
+            alias_ratio = rms(output, frames) / (BENCH_TONE_AMPLITUDE / sqrt(2.0));
+        } else {
+            frequency = passband_edge + t * (source_nyquist * 0.95 - passband_edge);
+            fill_sine(input, tone_frames, frequency, r->source_sample_rate);
+            frames = run_converter(state, ratio, input, tone_frames, output, output_capacity);
+            fit_sine(output, frames, frequency, r->destination_sample_rate, &alias_ratio);
+        }
+        worst_alias_db = MAX(worst_alias_db, to_db(alias_ratio));
+    }
+
+    printf("%s\n    {\"converter\": \"%s\", \"source_sample_rate\": %u, \"destination_sample_rate\": %u, "
+           "\"ns_per_output_frame\": %.3f, \"thd_n_db\": %.2f, \"passband_ripple_db\": %.4f, "
+           "\"alias_rejection_db\": %.2f}",
+           is_first ? "" : ",",
+           converter->name,
+           r->source_sample_rate,
+           r->destination_sample_rate,
+           best_ns_per_frame,
+           to_db(thd_n_ratio),
+           max_gain_db - min_gain_db,
+           -worst_alias_db);
+
+    src_delete(state);
+    free(input);
+    free(output);
+}
+
+int main(void) {
+    printf("{\n  \"version\": %d,\n  \"channels\": %d,\n  \"block_frames\": %d,\n  \"results\": [",
+           BENCH_FORMAT_VERSION,
+           BENCH_CHANNELS,
+           BENCH_BLOCK_FRAMES);
+    int is_first = 1;
+    for (size_t c = 0; c < ARRAY_LENGTH(converters); ++c) {
+        for (size_t r = 0; r < ARRAY_LENGTH(ratios); ++r) {
+            bench(&converters[c], &ratios[r], is_first);
+            is_first = 0;
+            fflush(stdout);
+        }
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
@@ -2,19 +2,250 @@
 
 static int channel_mixer_error = 0;
 
+// Stereo downmix rows per input layout, ITU-R BS.775 weights. LFE is dropped as the
+// recommendation suggests. Entries beyond the input channel count are unused.
+#define K CHANNEL_MIXER_MINUS_3DB
+static const float stereo_downmix_rows[CHANNEL_MIXER_MAX_CHANNELS + 1][2][CHANNEL_MIXER_MAX_CHANNELS] = {
+    [1] = {{ 1.0f }, { 1.0f }},
+    [2] = {{ 1.0f, 0.0f }, { 0.0f, 1.0f }},
+    // FL FR FC
+    [3] = {{ 1.0f, 0.0f, K }, { 0.0f, 1.0f, K }},
+    // FL FR BL BR
+    [4] = {{ 1.0f, 0.0f, K, 0.0f }, { 0.0f, 1.0f, 0.0f, K }},
+    // FL FR FC BL BR
+    [5] = {{ 1.0f, 0.0f, K, K, 0.0f }, { 0.0f, 1.0f, K, 0.0f, K }},
+    // FL FR FC LFE BL BR
+    [6] = {{ 1.0f, 0.0f, K, 0.0f, K, 0.0f }, { 0.0f, 1.0f, K, 0.0f, 0.0f, K }},
+    // FL FR FC LFE BC SL SR, back center is split evenly between both sides.
+    [7] = {{ 1.0f, 0.0f, K, 0.0f, 0.5f, K, 0.0f }, { 0.0f, 1.0f, K, 0.0f, 0.5f, 0.0f, K }},
+    // FL FR FC LFE BL BR SL SR
+    [8] = {{ 1.0f, 0.0f, K, 0.0f, K, 0.0f, K, 0.0f }, { 0.0f, 1.0f, K, 0.0f, 0.0f, K, 0.0f, K }},
+};
+#undef K
+
 EXPORT char* channel_mixer_get_error() {
     switch (channel_mixer_error) {
         case CHANNEL_MIXER_ERR_SUCCESS: return NULL;
         case CHANNEL_MIXER_ERR_UNSUPPORTED: return "Unsupported channel counts";
         case CHANNEL_MIXER_ERR_ALLOC_FAILED: return "Memory allocation failed";
+        case CHANNEL_MIXER_ERR_INVALID_MATRIX: return "Mixing matrix does not match channel counts";
+        case CHANNEL_MIXER_ERR_INSUFFICIENT_CAPACITY: return "Buffer is too small to mix in place";
         default: return "Unknown error";
     }
 }
 
+static void channel_mixer_build_default_matrix(uint8_t input_channels, uint8_t output_channels, float* matrix) {
+    const float* left = stereo_downmix_rows[input_channels][0];
+    const float* right = stereo_downmix_rows[input_channels][1];
+    float scale = 1.0f;
+
+    // Downmixes of 3+ channels are normalized so that a full scale signal on every
+    // input channel can't clip.
+    if (input_channels > 2) {
+        float sum = 0.0f;
+        for (uint8_t i = 0; i < input_channels; ++i) {
+            sum += left[i];
+        }
+        scale = 1.0f / sum;
+    }
+
+    memset(matrix, 0, sizeof(float) * input_channels * output_channels);
+    if (output_channels == 1) {
+        for (uint8_t i = 0; i < input_channels; ++i) {
+            matrix[i] = input_channels == 1 ? 1.0f : (left[i] + right[i]) * 0.5f * scale;
+        }
+    } else if (output_channels == 2 || input_channels > output_channels) {
+        // Multichannel to fewer (non-stereo) outputs is folded into the front pair.
+        for (uint8_t i = 0; i < input_channels; ++i) {
+            matrix[0 * input_channels + i] = left[i] * scale;
+            matrix[1 * input_channels + i] = right[i] * scale;
+        }
+    } else if (input_channels == 1) {
+        matrix[0] = 1.0f;
+        matrix[1] = 1.0f;
+    } else {
+        for (uint8_t i = 0; i < input_channels; ++i) {
+            matrix[i * input_channels + i] = 1.0f;
+        }
+    }
+}
+
+static void channel_mixer_mix_generic(const float* input,
+                                      float* output,
+                                      uint32_t frame_count,
+                                      const float* matrix,
+                                      uint8_t input_channels,
+                                      uint8_t output_channels) {
+    // The frame is copied out before any output is written so that downmixing is safe when
+    // output aliases input.
+    float frame[CHANNEL_MIXER_MAX_CHANNELS];
+    for (uint32_t i = 0; i < frame_count; ++i) {
+        memmove(frame, input + i * input_channels, input_channels * sizeof(float));
+        for (uint8_t o = 0; o < output_channels; ++o) {
+            const float* row = matrix + o * input_channels;
+            float sum = 0.0f;
+            for (uint8_t c = 0; c < input_channels; ++c) {
+                sum += row[c] * frame[c];
+            }
+            output[i * output_channels + o] = sum;
+        }
+    }
+}
+
+static void channel_mixer_mix_1_to_2(const float* input,
+                                     float* output,
+                                     uint32_t frame_count,
+                                     const float* matrix,
+                                     uint8_t input_channels,
+                                     uint8_t output_channels) {
+    const f32x4 gains = { matrix[0], matrix[1], matrix[0], matrix[1] };
+    uint32_t i = 0;
+    for (; i + 4 <= frame_count; i += 4) {
+        f32x4 mono = f32x4_load(input + i);
+        f32x4_store(output + i * 2, SIMD_SHUFFLE_F32X4(mono, mono, 0, 0, 1, 1) * gains);
+        f32x4_store(output + i * 2 + 4, SIMD_SHUFFLE_F32X4(mono, mono, 2, 2, 3, 3) * gains);
+    }
+    for (; i < frame_count; ++i) {
+        output[i * 2] = input[i] * matrix[0];
+        output[i * 2 + 1] = input[i] * matrix[1];
+    }
+}
+
+static void channel_mixer_mix_2_to_1(const float* input,
+                                     float* output,
+                                     uint32_t frame_count,
+                                     const float* matrix,
+                                     uint8_t input_channels,
+                                     uint8_t output_channels) {
+    const f32x4 left_gain = f32x4_splat(matrix[0]);
+    const f32x4 right_gain = f32x4_splat(matrix[1]);
+    uint32_t i = 0;
+    for (; i + 4 <= frame_count; i += 4) {
+        f32x4 left, right;
+        f32x4_deinterleave2(f32x4_load(input + i * 2), f32x4_load(input + i * 2 + 4), &left, &right);
+        f32x4_store(output + i, left * left_gain + right * right_gain);
+    }
+    for (; i < frame_count; ++i) {
+        output[i] = input[i * 2] * matrix[0] + input[i * 2 + 1] * matrix[1];
+    }
+}
+
+// N to stereo, two frames per iteration. Each input channel is broadcast into
+// [frame0 frame0 frame1 frame1] lanes and multiplied by its [left right left right]
+// column of the matrix. N is a compile time constant so the channel loop unrolls and
+// every column stays in a register.
+#define CHANNEL_MIXER_TO_STEREO_KERNEL(N)                                                               \
+static void channel_mixer_mix_##N##_to_2(const float* input,                                           \
+                                         float* output,                                                 \
+                                         uint32_t frame_count,                                          \
+                                         const float* matrix,                                           \
+                                         uint8_t input_channels,                                        \
+                                         uint8_t output_channels) {                                     \
+    f32x4 columns[N];                                                                                   \
+    for (int c = 0; c < N; ++c) {                                                                       \
+        columns[c] = (f32x4){ matrix[c], matrix[N + c], matrix[c], matrix[N + c] };                     \
+    }                                                                                                   \
+    uint32_t i = 0;                                                                                     \
+    for (; i + 2 <= frame_count; i += 2) {                                                              \
+        const float* frames = input + i * N;                                                            \
+        f32x4 sum = f32x4_splat(0.0f);                                                                  \
+        for (int c = 0; c < N; ++c) {                                                                   \
+            sum += (f32x4){ frames[c], frames[c], frames[N + c], frames[N + c] } * columns[c];         \
+        }                                                                                               \
+        f32x4_store(output + i * 2, sum);                                                               \
+    }                                                                                                   \
+    for (; i < frame_count; ++i) {                                                                      \
+        const float* frame = input + i * N;                                                             \
+        float left = 0.0f;                                                                              \
+        float right = 0.0f;                                                                             \
+        for (int c = 0; c < N; ++c) {                                                                   \
+            left += frame[c] * matrix[c];                                                               \
+            right += frame[c] * matrix[N + c];                                                          \
+        }                                                                                               \
+        output[i * 2] = left;                                                                           \
+        output[i * 2 + 1] = right;                                                                      \
+    }                                                                                                   \
+}
+
+CHANNEL_MIXER_TO_STEREO_KERNEL(6)
+CHANNEL_MIXER_TO_STEREO_KERNEL(8)
+#undef CHANNEL_MIXER_TO_STEREO_KERNEL
+
+// Upmixing in place has to run from the last frame to the first, since every output frame
+// is larger than the input frame it is computed from.
+static void channel_mixer_upmix_in_place_generic(float* samples,
+                                                 uint32_t frame_count,
+                                                 const float* matrix,
+                                                 uint8_t input_channels,
+                                                 uint8_t output_channels) {
+    float frame[CHANNEL_MIXER_MAX_CHANNELS];
+    for (uint32_t i = frame_count; i-- > 0;) {
+        memmove(frame, samples + i * input_channels, input_channels * sizeof(float));
+        for (uint8_t o = 0; o < output_channels; ++o) {
+            const float* row = matrix + o * input_channels;
+            float sum = 0.0f;
+            for (uint8_t c = 0; c < input_channels; ++c) {
+                sum += row[c] * frame[c];
+            }
+            samples[i * output_channels + o] = sum;
+        }
+    }
+}
+
+static void channel_mixer_upmix_in_place_1_to_2(float* samples, uint32_t frame_count, const float* matrix) {
+    const f32x4 gains = { matrix[0], matrix[1], matrix[0], matrix[1] };
+    uint32_t i = frame_count;
+    while (i & 3) {
+        --i;
+        float mono = samples[i];
+        samples[i * 2] = mono * matrix[0];
+        samples[i * 2 + 1] = mono * matrix[1];
+    }
+    while (i > 0) {
+        i -= 4;
+        f32x4 mono = f32x4_load(samples + i);
+        f32x4_store(samples + i * 2 + 4, SIMD_SHUFFLE_F32X4(mono, mono, 2, 2, 3, 3) * gains);
+        f32x4_store(samples + i * 2, SIMD_SHUFFLE_F32X4(mono, mono, 0, 0, 1, 1) * gains);
+    }
+}
+
+static ChannelMixerKernel channel_mixer_select_kernel(uint8_t input_channels, uint8_t output_channels) {
+    if (output_channels == 2) {
+        switch (input_channels) {
+            case 1: return channel_mixer_mix_1_to_2;
+            case 6: return channel_mixer_mix_6_to_2;
+            case 8: return channel_mixer_mix_8_to_2;
+        }
+    } else if (output_channels == 1 && input_channels == 2) {
+        return channel_mixer_mix_2_to_1;
+    }
+    return channel_mixer_mix_generic;
+}
+
 EXPORT uint32_t channel_mixer_get_length(ChannelMixer* channel_mixer, uint32_t byte_length, uint8_t input_channel_count) {
     return (uint32_t)((double)channel_mixer->output_channels / (double)input_channel_count * (double) byte_length);
 }
 
+static int channel_mixer_prepare(ChannelMixer* channel_mixer, uint8_t input_channel_count) {
+    uint8_t output_channel_count = channel_mixer->output_channels;
+    if (input_channel_count == 0 || input_channel_count > CHANNEL_MIXER_MAX_CHANNELS ||
+        output_channel_count == 0 || output_channel_count > CHANNEL_MIXER_MAX_CHANNELS) {
+        channel_mixer_error = CHANNEL_MIXER_ERR_UNSUPPORTED;
+        return CHANNEL_MIXER_ERR_UNSUPPORTED;
+    }
+
+    if (channel_mixer->matrix_input_channels != input_channel_count) {
+        if (channel_mixer->has_custom_matrix) {
+            channel_mixer_error = CHANNEL_MIXER_ERR_INVALID_MATRIX;
+            return CHANNEL_MIXER_ERR_INVALID_MATRIX;
+        }
+        channel_mixer_build_default_matrix(input_channel_count, output_channel_count, channel_mixer->matrix);
+        channel_mixer->matrix_input_channels = input_channel_count;
+        channel_mixer->kernel = channel_mixer_select_kernel(input_channel_count, output_channel_count);
+    }
+    return CHANNEL_MIXER_ERR_SUCCESS;
+}
+
 EXPORT int channel_mixer_mix(ChannelMixer* channel_mixer,
                              uint8_t input_channel_count,
                              float* input,
@@ -23,48 +254,115 @@ EXPORT int channel_mixer_mix(ChannelMixer* channel_mixer,
     channel_mixer->output = (float*)NULL;
     uint8_t output_channel_count = channel_mixer->output_channels;
 
-    if (output_channel_count == input_channel_count) {
+    if (output_channel_count == input_channel_count && !channel_mixer->has_custom_matrix) {
         channel_mixer->output = input;
         return CHANNEL_MIXER_ERR_SUCCESS;
     }
 
+    int err = channel_mixer_prepare(channel_mixer, input_channel_count);
+    if (err) {
+        return err;
+    }
+
     const uint32_t input_audio_frame_length = input_byte_length / input_channel_count / sizeof(float);
-    if (output_channel_count == 1) {
-        if (input_channel_count == 2) {
-            float* buf = channelMixerGetBuffer(channel_mixer, input_byte_length / 2);
-            for (uint32_t i = 0; i < input_audio_frame_length; ++i) {
-                buf[i] = (input[i * 2] + input[i * 2 + 1]) / 2.0f;
-            }
-            channel_mixer->output = buf;
-            return CHANNEL_MIXER_ERR_SUCCESS;
-        } else {
-            channel_mixer_error = CHANNEL_MIXER_ERR_UNSUPPORTED;
-            return CHANNEL_MIXER_ERR_UNSUPPORTED;
-        }
-    } else if (output_channel_count == 2) {
-        if (input_channel_count == 1) {
-            float* buf = channelMixerGetBuffer(channel_mixer, input_byte_length * 2);
+    float* buf = channelMixerGetBuffer(channel_mixer,
+                                       input_audio_frame_length * output_channel_count * sizeof(float));
+    if (!buf) {
+        channel_mixer_error = CHANNEL_MIXER_ERR_ALLOC_FAILED;
+        return CHANNEL_MIXER_ERR_ALLOC_FAILED;
+    }
+    channel_mixer->kernel(input,
+                          buf,
+                          input_audio_frame_length,
+                          channel_mixer->matrix,
+                          input_channel_count,
+                          output_channel_count);
+    channel_mixer->output = buf;
+    return CHANNEL_MIXER_ERR_SUCCESS;
+}
 
-            for (uint32_t i = 0; i < input_audio_frame_length; ++i) {
-                buf[i * 2] = input[i];
-                buf[i * 2 + 1] = input[i];
-            }
-            channel_mixer->output = buf;
-            return CHANNEL_MIXER_ERR_SUCCESS;
-        } else {
-            channel_mixer_error = CHANNEL_MIXER_ERR_UNSUPPORTED;
-            return CHANNEL_MIXER_ERR_UNSUPPORTED;
-        }
+EXPORT int channel_mixer_mix_in_place(ChannelMixer* channel_mixer,
+                                      uint8_t input_channel_count,
+                                      float* samples,
+                                      uint32_t input_byte_length,
+                                      uint32_t capacity_byte_length) {
+    channel_mixer_error = CHANNEL_MIXER_ERR_SUCCESS;
+    channel_mixer->output = samples;
+    uint8_t output_channel_count = channel_mixer->output_channels;
+
+    if (output_channel_count == input_channel_count && !channel_mixer->has_custom_matrix) {
+        return CHANNEL_MIXER_ERR_SUCCESS;
+    }
+
+    int err = channel_mixer_prepare(channel_mixer, input_channel_count);
+    if (err) {
+        channel_mixer->output = (float*)NULL;
+        return err;
+    }
+
+    const uint32_t frame_count = input_byte_length / input_channel_count / sizeof(float);
+    if (output_channel_count <= input_channel_count) {
+        // Every kernel reads a frame before writing its smaller output frame, which never
+        // lands past the next input frame.
+        channel_mixer->kernel(samples,
+                              samples,
+                              frame_count,
+                              channel_mixer->matrix,
+                              input_channel_count,
+                              output_channel_count);
+        return CHANNEL_MIXER_ERR_SUCCESS;
+    }
+
+    if ((uint64_t)frame_count * output_channel_count * sizeof(float) > capacity_byte_length) {
+        channel_mixer->output = (float*)NULL;
+        channel_mixer_error = CHANNEL_MIXER_ERR_INSUFFICIENT_CAPACITY;
+        return CHANNEL_MIXER_ERR_INSUFFICIENT_CAPACITY;
+    }
+
+    if (input_channel_count == 1 && output_channel_count == 2) {
+        channel_mixer_upmix_in_place_1_to_2(samples, frame_count, channel_mixer->matrix);
     } else {
-        return CHANNEL_MIXER_ERR_UNSUPPORTED;
+        channel_mixer_upmix_in_place_generic(samples,
+                                             frame_count,
+                                             channel_mixer->matrix,
+                                             input_channel_count,
+                                             output_channel_count);
     }
+    return CHANNEL_MIXER_ERR_SUCCESS;
+}
+
+EXPORT int channel_mixer_set_matrix(ChannelMixer* channel_mixer, uint8_t input_channels, float* coefficients) {
+    channel_mixer_error = CHANNEL_MIXER_ERR_SUCCESS;
+    uint8_t output_channels = channel_mixer->output_channels;
+    if (input_channels == 0 || input_channels > CHANNEL_MIXER_MAX_CHANNELS) {
+        channel_mixer_error = CHANNEL_MIXER_ERR_INVALID_MATRIX;
+        return CHANNEL_MIXER_ERR_INVALID_MATRIX;
+    }
+    memmove(channel_mixer->matrix, coefficients, sizeof(float) * input_channels * output_channels);
+    channel_mixer->matrix_input_channels = input_channels;
+    channel_mixer->has_custom_matrix = 1;
+    channel_mixer->kernel = channel_mixer_select_kernel(input_channels, output_channels);
+    return CHANNEL_MIXER_ERR_SUCCESS;
+}
+
+EXPORT void channel_mixer_use_default_matrix(ChannelMixer* channel_mixer) {
+    channel_mixer->has_custom_matrix = 0;
+    channel_mixer->matrix_input_channels = 0;
 }
 
 EXPORT ChannelMixer* channel_mixer_create(uint8_t channels) {
     channel_mixer_error = CHANNEL_MIXER_ERR_SUCCESS;
+    if (channels == 0 || channels > CHANNEL_MIXER_MAX_CHANNELS) {
+        channel_mixer_error = CHANNEL_MIXER_ERR_UNSUPPORTED;
+        return NULL;
+    }
     ChannelMixer* mixer = malloc(sizeof(ChannelMixer));
     if (mixer) {
+        mixer->output = NULL;
         mixer->output_channels = channels;
+        mixer->matrix_input_channels = 0;
+        mixer->has_custom_matrix = 0;
+        mixer->kernel = channel_mixer_mix_generic;
     } else {
         channel_mixer_error = CHANNEL_MIXER_ERR_ALLOC_FAILED;
     }
@@ -77,4 +375,6 @@ EXPORT void channel_mixer_destroy(ChannelMixer* channel_mixer) {
 
 EXPORT void channel_mixer_set_output_channels(ChannelMixer* channel_mixer, uint8_t channels) {
     channel_mixer->output_channels = channels;
+    channel_mixer->matrix_input_channels = 0;
+    channel_mixer->has_custom_matrix = 0;
 }
@@ -1,25 +1,56 @@
 #ifndef CHANNEL_MIXER_H
 #define CHANNEL_MIXER_H
 
+#include <simd.h>
+
+#define CHANNEL_MIXER_MAX_CHANNELS 8
+#define CHANNEL_MIXER_MATRIX_LENGTH (CHANNEL_MIXER_MAX_CHANNELS * CHANNEL_MIXER_MAX_CHANNELS)
+// -3 dB, ITU-R BS.775 weight for center and surround channels in a stereo downmix.
+#define CHANNEL_MIXER_MINUS_3DB 0.7071067811865476f
+
 enum {
     CHANNEL_MIXER_ERR_SUCCESS = 0,
     CHANNEL_MIXER_ERR_UNSUPPORTED = 1,
     CHANNEL_MIXER_ERR_ALLOC_FAILED = 2,
+    CHANNEL_MIXER_ERR_INVALID_MATRIX = 3,
+    CHANNEL_MIXER_ERR_INSUFFICIENT_CAPACITY = 4,
 
     CHANNEL_MIXER_ERR_MAX_ERROR
 };
 
+typedef void (*ChannelMixerKernel)(const float* input,
+                                   float* output,
+                                   uint32_t frame_count,
+                                   const float* matrix,
+                                   uint8_t input_channels,
+                                   uint8_t output_channels);
+
+// Input channels are expected in WAVE_FORMAT_EXTENSIBLE order:
+// FL FR FC LFE BL BR SL SR (6.1 uses FL FR FC LFE BC SL SR).
 typedef struct _channel_mixer {
     float* output;
     uint8_t output_channels;
+    // Input channel count the current matrix was built for, 0 when no matrix is built.
+    uint8_t matrix_input_channels;
+    uint8_t has_custom_matrix;
+    ChannelMixerKernel kernel;
+    // Row-major, output_channels rows of matrix_input_channels coefficients.
+    float matrix[CHANNEL_MIXER_MATRIX_LENGTH];
 } ChannelMixer;
 
 EXPORT char* channel_mixer_get_error(void);
 EXPORT uint32_t channel_mixer_get_length(ChannelMixer* channel_mixer, uint32_t input_length, uint8_t input_channels);
 EXPORT int channel_mixer_mix(ChannelMixer*, uint8_t, float*, uint32_t);
+EXPORT int channel_mixer_mix_in_place(ChannelMixer*, uint8_t, float*, uint32_t, uint32_t);
 EXPORT ChannelMixer* channel_mixer_create(uint8_t channels);
 EXPORT void channel_mixer_destroy(ChannelMixer* channel_mixer);
 EXPORT void channel_mixer_set_output_channels(ChannelMixer* channel_mixer, uint8_t channels);
+EXPORT int channel_mixer_set_matrix(ChannelMixer* channel_mixer, uint8_t input_channels, float* coefficients);
+EXPORT void channel_mixer_use_default_matrix(ChannelMixer* channel_mixer);
+
+static void channel_mixer_build_default_matrix(uint8_t input_channels, uint8_t output_channels, float* matrix);
+static int channel_mixer_prepare(ChannelMixer* channel_mixer, uint8_t input_channel_count);
+static ChannelMixerKernel channel_mixer_select_kernel(uint8_t input_channels, uint8_t output_channels);
 
 extern float* channelMixerGetBuffer(ChannelMixer* this, uint32_t length);
 #endif //CHANNEL_MIXER_H
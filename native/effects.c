@@ -1,20 +1,209 @@
 #include "effects.h"
 
-static float effects_bass_boost_state[EFFECT_BASS_BOOST_MAX_CHANNELS];
-static double effects_equalizer_state[EFFECT_EQUALIZER_STATE_LENGTH];
 static const float bass_boost_gain1 = 1.0 / (EFFECT_BASS_BOOST_SELECTIVITY + 1.0);
 static const float bass_boost_gain2 = 1.5;
 
-EXPORT void effects_equalizer_reset() {
-    for (int i = 0; i < EFFECT_EQUALIZER_STATE_LENGTH; ++i) {
-        effects_equalizer_state[i] = 0.0;
+EXPORT EffectsContext* effects_context_create() {
+    EffectsContext* effects_context = malloc(sizeof(EffectsContext));
+    if (effects_context) {
+        Equalizer* equalizer = &effects_context->equalizer;
+        memset(equalizer, 0, sizeof(Equalizer));
+        for (int band = 0; band < EFFECT_EQUALIZER_BAND_COUNT; ++band) {
+            equalizer->bands[band].type = EFFECT_EQUALIZER_BAND_PEAKING;
+            equalizer->bands[band].q = 1.0;
+            equalizer->coefficients[band * EFFECT_EQUALIZER_COEFF_PARAMS] = 1.0;
+        }
+        memset(&effects_context->convolver, 0, sizeof(Convolver));
+        memset(&effects_context->limiter, 0, sizeof(Limiter));
+        memset(&effects_context->chain, 0, sizeof(EffectChain));
+        effects_context->chain.params[EFFECT_CHAIN_PARAM_GAIN] = 1.0;
+        effects_context->chain.params[EFFECT_CHAIN_PARAM_PREVIOUS_GAIN] = -1.0;
+        effects_context_reset(effects_context);
+    }
+    return effects_context;
+}
+
+EXPORT void effects_context_destroy(EffectsContext* effects_context) {
+    effects_convolver_set_impulse_response(effects_context, NULL);
+    effects_limiter_free_interpolator(&effects_context->limiter);
+    free(effects_context);
+}
+
+EXPORT void effects_context_reset(EffectsContext* effects_context) {
+    effects_equalizer_reset(effects_context);
+    effects_bass_boost_reset(effects_context);
+    effects_noise_sharpening_reset(effects_context);
+    effects_convolver_reset(effects_context);
+    effects_limiter_reset(effects_context);
+}
+
+// Audio EQ Cookbook (R. Bristow-Johnson) shelf and peaking filters, normalized by a0.
+static void effects_equalizer_design_band(const EqualizerBand* band, double* coeffs) {
+    double a0, a1, a2, b0, b1, b2;
+    const double A = pow(10.0, band->gain / 40.0);
+    const double k = band->cos_w0;
+    const double alpha = band->sin_w0 / (2.0 * band->q);
+
+    if (band->type == EFFECT_EQUALIZER_BAND_PEAKING) {
+        b0 = 1.0 + alpha * A;
+        b1 = -2.0 * k;
+        b2 = 1.0 - alpha * A;
+        a0 = 1.0 + alpha / A;
+        a1 = -2.0 * k;
+        a2 = 1.0 - alpha / A;
+    } else {
+        const double k2 = 2.0 * sqrt(A) * alpha;
+        const double a_plus_one = A + 1.0;
+        const double a_minus_one = A - 1.0;
+        if (band->type == EFFECT_EQUALIZER_BAND_LOWSHELF) {
+            b0 = A * (a_plus_one - a_minus_one * k + k2);
+            b1 = 2.0 * A * (a_minus_one - a_plus_one * k);
+            b2 = A * (a_plus_one - a_minus_one * k - k2);
+            a0 = a_plus_one + a_minus_one * k + k2;
+            a1 = -2.0 * (a_minus_one + a_plus_one * k);
+            a2 = a_plus_one + a_minus_one * k - k2;
+        } else {
+            b0 = A * (a_plus_one + a_minus_one * k + k2);
+            b1 = -2.0 * A * (a_minus_one + a_plus_one * k);
+            b2 = A * (a_plus_one + a_minus_one * k - k2);
+            a0 = a_plus_one - a_minus_one * k + k2;
+            a1 = 2.0 * (a_minus_one - a_plus_one * k);
+            a2 = a_plus_one - a_minus_one * k - k2;
+        }
     }
+
+    coeffs[0] = b0 / a0;
+    coeffs[1] = b1 / a0;
+    coeffs[2] = b2 / a0;
+    coeffs[3] = a1 / a0;
+    coeffs[4] = a2 / a0;
 }
 
-EXPORT void effects_bass_boost_reset() {
-    for (int i = 0; i < EFFECT_BASS_BOOST_MAX_CHANNELS; ++i) {
-        effects_bass_boost_state[i] = 0.0;
+static void effects_equalizer_update_band(Equalizer* equalizer, int band_index) {
+    EqualizerBand* band = &equalizer->bands[band_index];
+    if (equalizer->sample_rate == 0) {
+        return;
     }
+    const double w0 = 2.0 * M_PI * band->frequency / (double)equalizer->sample_rate;
+    band->cos_w0 = cos(w0);
+    band->sin_w0 = sin(w0);
+    effects_equalizer_design_band(band, equalizer->coefficients + band_index * EFFECT_EQUALIZER_COEFF_PARAMS);
+}
+
+// A band leaving the active set has ramped to exactly 0 dB. Its remaining state is
+// cleared so that it starts from rest if it becomes active again.
+static void effects_equalizer_update_active_bands(Equalizer* equalizer) {
+    uint32_t active_mask = 0;
+    uint8_t active_band_count = 0;
+    for (int band = 0; band < EFFECT_EQUALIZER_BAND_COUNT; ++band) {
+        if (equalizer->bands[band].gain != 0.0 || equalizer->bands[band].target_gain != 0.0) {
+            active_mask |= 1 << band;
+            equalizer->active_bands[active_band_count++] = band;
+        }
+    }
+
+    uint32_t deactivated = equalizer->active_mask & ~active_mask;
+    for (int band = 0; band < EFFECT_EQUALIZER_BAND_COUNT; ++band) {
+        if (deactivated & (1 << band)) {
+            for (int pair = 0; pair < EFFECT_EQUALIZER_MAX_CHANNELS / 2; ++pair) {
+                equalizer->state.state[pair][band][0] = f64x2_splat(0.0);
+                equalizer->state.state[pair][band][1] = f64x2_splat(0.0);
+            }
+        }
+    }
+    equalizer->active_mask = active_mask;
+    equalizer->active_band_count = active_band_count;
+}
+
+// Jumps every band to its target gain.
+static void effects_equalizer_finish_ramp(Equalizer* equalizer) {
+    for (int band = 0; band < EFFECT_EQUALIZER_BAND_COUNT; ++band) {
+        if (equalizer->bands[band].gain != equalizer->bands[band].target_gain) {
+            equalizer->bands[band].gain = equalizer->bands[band].target_gain;
+            effects_equalizer_update_band(equalizer, band);
+        }
+    }
+    equalizer->ramp_blocks_remaining = 0;
+    effects_equalizer_update_active_bands(equalizer);
+}
+
+// Moves each band 1/remaining of the way to its target gain.
+static void effects_equalizer_step_ramp(Equalizer* equalizer) {
+    const double remaining = (double)equalizer->ramp_blocks_remaining;
+    for (int band_index = 0; band_index < EFFECT_EQUALIZER_BAND_COUNT; ++band_index) {
+        EqualizerBand* band = &equalizer->bands[band_index];
+        if (band->gain != band->target_gain) {
+            band->gain = remaining > 1.0 ? band->gain + (band->target_gain - band->gain) / remaining
+                                         : band->target_gain;
+            effects_equalizer_design_band(band,
+                                          equalizer->coefficients + band_index * EFFECT_EQUALIZER_COEFF_PARAMS);
+        }
+    }
+    if (--equalizer->ramp_blocks_remaining == 0) {
+        effects_equalizer_update_active_bands(equalizer);
+    }
+}
+
+// Clears filter memory. A pending gain ramp is completed immediately, since there is no
+// previous output left to be continuous with.
+EXPORT void effects_equalizer_reset(EffectsContext* effects_context) {
+    memset(&effects_context->equalizer.state, 0, sizeof(effects_context->equalizer.state));
+    effects_equalizer_finish_ramp(&effects_context->equalizer);
+}
+
+EXPORT void effects_equalizer_set_sample_rate(EffectsContext* effects_context, uint32_t sample_rate) {
+    Equalizer* equalizer = &effects_context->equalizer;
+    if (equalizer->sample_rate == sample_rate) {
+        return;
+    }
+    equalizer->sample_rate = sample_rate;
+    for (int band = 0; band < EFFECT_EQUALIZER_BAND_COUNT; ++band) {
+        equalizer->bands[band].gain = equalizer->bands[band].target_gain;
+        effects_equalizer_update_band(equalizer, band);
+    }
+    equalizer->ramp_blocks_remaining = 0;
+    effects_equalizer_update_active_bands(equalizer);
+}
+
+// Changing only the gain of a band ramps to it, changing anything else takes effect
+// immediately.
+EXPORT void effects_equalizer_set_band(EffectsContext* effects_context,
+                                       uint32_t band_index,
+                                       uint32_t type,
+                                       double frequency,
+                                       double q,
+                                       double gain) {
+    if (band_index >= EFFECT_EQUALIZER_BAND_COUNT || q <= 0.0) {
+        return;
+    }
+    Equalizer* equalizer = &effects_context->equalizer;
+    EqualizerBand* band = &equalizer->bands[band_index];
+    if (band->type != type || band->frequency != frequency || band->q != q) {
+        band->type = type;
+        band->frequency = frequency;
+        band->q = q;
+        band->gain = gain;
+        band->target_gain = gain;
+        effects_equalizer_update_band(equalizer, band_index);
+    } else if (band->target_gain != gain) {
+        band->target_gain = gain;
+        equalizer->ramp_blocks_remaining = EFFECT_EQUALIZER_RAMP_BLOCKS;
+    }
+    effects_equalizer_update_active_bands(equalizer);
+}
+
+EXPORT int effects_equalizer_is_ramping(EffectsContext* effects_context) {
+    return effects_context->equalizer.ramp_blocks_remaining > 0;
+}
+
+EXPORT void effects_bass_boost_reset(EffectsContext* effects_context) {
+    for (int i = 0; i < EFFECT_MAX_CHANNELS / 4; ++i) {
+        effects_context->bass_boost.state[i] = f32x4_splat(0.0f);
+    }
+}
+
+EXPORT void effects_noise_sharpening_reset(EffectsContext* effects_context) {
+    memset(effects_context->noise_sharpening.previous, 0, sizeof(effects_context->noise_sharpening.previous));
 }
 
 static double get_fade_in_volume(double t0, double t, double t1) {
@@ -27,50 +216,144 @@ static double get_fade_out_volume(double t0, double t, double t1) {
     return sqrt(0.5 * (1.0 - t));
 }
 
-EXPORT void effects_bass_boost_apply(double effect_size,
-                               uint32_t channel_count,
-                               float* samples,
-                               uint32_t byte_length) {
-    if (channel_count > EFFECT_BASS_BOOST_MAX_CHANNELS) {
-        return;
+// Mono has no lanes to spread over, the recursion is inherently serial.
+static void effects_bass_boost_apply_mono(BassBoost* bass_boost, float ratio, float* samples, uint32_t length) {
+    float state = bass_boost->state[0][0];
+    for (uint32_t i = 0; i < length; ++i) {
+        float sample = samples[i];
+        state = (sample + EFFECT_DENORMAL_OFFSET + state * EFFECT_BASS_BOOST_SELECTIVITY) * bass_boost_gain1;
+        samples[i] = (sample + state * ratio) * bass_boost_gain2;
     }
-    size_t length = byte_length / sizeof(float) / channel_count;
-    const float ratio = EFFECT_BASS_BOOST_MIN_RATIO + effect_size * (EFFECT_BASS_BOOST_MAX_RATIO - EFFECT_BASS_BOOST_MIN_RATIO);
+    bass_boost->state[0][0] = state;
+}
 
-    for (int i = 0; i < length; ++i) {
-        for (int ch = 0; ch < channel_count; ++ch) {
-            float sample = samples[i * channel_count + ch];
-            effects_bass_boost_state[ch] = (sample + effects_bass_boost_state[ch] * EFFECT_BASS_BOOST_SELECTIVITY) * bass_boost_gain1;
-            sample = (sample + effects_bass_boost_state[ch] * ratio) * bass_boost_gain2;
-            samples[i * channel_count + ch] = sample;
+// Two frames [L0 R0 L1 R1] per vector. The first frame's state is computed in the low
+// lanes, then broadcast to compute the second frame's state in the high lanes.
+static void effects_bass_boost_apply_stereo(BassBoost* bass_boost, float ratio, float* samples, uint32_t length) {
+    const f32x4 selectivity = f32x4_splat(EFFECT_BASS_BOOST_SELECTIVITY);
+    const f32x4 gain1 = f32x4_splat(bass_boost_gain1);
+    const f32x4 gain2 = f32x4_splat(bass_boost_gain2);
+    const f32x4 offset = f32x4_splat(EFFECT_DENORMAL_OFFSET);
+    const f32x4 ratios = f32x4_splat(ratio);
+    f32x4 state = SIMD_SHUFFLE_F32X4(bass_boost->state[0], bass_boost->state[0], 0, 1, 0, 1);
+    uint32_t i = 0;
+    for (; i + 2 <= length; i += 2) {
+        f32x4 input = f32x4_load(samples + i * 2);
+        f32x4 biased = input + offset;
+        f32x4 first = (biased + state * selectivity) * gain1;
+        f32x4 second = (biased + SIMD_SHUFFLE_F32X4(first, first, 0, 1, 0, 1) * selectivity) * gain1;
+        f32x4 both = SIMD_SHUFFLE_F32X4(first, second, 0, 1, 6, 7);
+        f32x4_store(samples + i * 2, (input + both * ratios) * gain2);
+        state = SIMD_SHUFFLE_F32X4(second, second, 2, 3, 2, 3);
+    }
+    for (; i < length; ++i) {
+        for (int ch = 0; ch < 2; ++ch) {
+            float sample = samples[i * 2 + ch];
+            state[ch] = (sample + EFFECT_DENORMAL_OFFSET + state[ch] * EFFECT_BASS_BOOST_SELECTIVITY) * bass_boost_gain1;
+            samples[i * 2 + ch] = (sample + state[ch] * ratio) * bass_boost_gain2;
         }
     }
+    bass_boost->state[0] = state;
+}
 
-    const uint32_t* effects_bass_boost_state_bits = (uint32_t*) effects_bass_boost_state;
-    for (int j = 0; j < EFFECT_BASS_BOOST_MAX_CHANNELS; ++j) {
-        if ((effects_bass_boost_state_bits[j] & 0x7F800000) == 0) {
-            effects_bass_boost_state[j] = 0.0;
+// One frame per step with a lane per channel, for up to 8 channels.
+static void effects_bass_boost_apply_multichannel(BassBoost* bass_boost,
+                                                  float ratio,
+                                                  uint8_t channel_count,
+                                                  float* samples,
+                                                  uint32_t length) {
+    const f32x4 selectivity = f32x4_splat(EFFECT_BASS_BOOST_SELECTIVITY);
+    const f32x4 gain1 = f32x4_splat(bass_boost_gain1);
+    const f32x4 gain2 = f32x4_splat(bass_boost_gain2);
+    const f32x4 offset = f32x4_splat(EFFECT_DENORMAL_OFFSET);
+    const f32x4 ratios = f32x4_splat(ratio);
+    const int vector_count = (channel_count + 3) / 4;
+    // Lanes past the last channel are kept at zero, otherwise the denormal offset and
+    // whatever a wider channel layout left in the state would feed back into them forever.
+    float lanes[EFFECT_MAX_CHANNELS] = { 0 };
+    for (uint8_t ch = 0; ch < channel_count; ++ch) {
+        lanes[ch] = 1.0f;
+    }
+    float frame[EFFECT_MAX_CHANNELS] = { 0 };
+    for (uint32_t i = 0; i < length; ++i) {
+        float* samples_frame = samples + i * channel_count;
+        memmove(frame, samples_frame, channel_count * sizeof(float));
+        for (int v = 0; v < vector_count; ++v) {
+            const f32x4 mask = f32x4_load(lanes + v * 4);
+            f32x4 input = f32x4_load(frame + v * 4);
+            f32x4 state = (input + offset + bass_boost->state[v] * selectivity) * gain1 * mask;
+            bass_boost->state[v] = state;
+            f32x4_store(frame + v * 4, (input + state * ratios) * gain2 * mask);
         }
+        memmove(samples_frame, frame, channel_count * sizeof(float));
     }
 }
 
-EXPORT void effects_noise_sharpening(double effect_size,
-                                     uint8_t channel_count,
+EXPORT void effects_bass_boost_apply(EffectsContext* effects_context,
+                                     double effect_size,
+                                     uint32_t channel_count,
                                      float* samples,
-                                     size_t byte_length) {
-    size_t length = byte_length / sizeof(float) / channel_count;
+                                     uint32_t byte_length) {
+    if (channel_count == 0 || channel_count > EFFECT_MAX_CHANNELS) {
+        return;
+    }
+    if (effect_size <= 0) {
+        return;
+    }
+    uint32_t length = byte_length / sizeof(float) / channel_count;
+    const float ratio = EFFECT_BASS_BOOST_MIN_RATIO + effect_size * (EFFECT_BASS_BOOST_MAX_RATIO - EFFECT_BASS_BOOST_MIN_RATIO);
 
-    if (effect_size > 0) {
+    BassBoost* bass_boost = &effects_context->bass_boost;
+    if (channel_count == 1) {
+        effects_bass_boost_apply_mono(bass_boost, ratio, samples, length);
+    } else if (channel_count == 2) {
+        effects_bass_boost_apply_stereo(bass_boost, ratio, samples, length);
+    } else {
+        effects_bass_boost_apply_multichannel(bass_boost, ratio, channel_count, samples, length);
+    }
+}
 
-        for (size_t i = length - 1; i >= 1; --i) {
-            for (uint8_t ch = 0; ch < channel_count; ++ch) {
-                float sample = samples[i * channel_count + ch];
-                float previous_sample = samples[(i - 1) * channel_count + ch];
-                float diff = sample - previous_sample;
-                samples[i * channel_count + ch] = sample + (effect_size * diff);
-            }
-        }
+// y[n] = x[n] + k * (x[n] - x[n - 1]) per channel. Interleaved, the previous frame's sample
+// is simply channel_count floats back, so the buffer is treated as one flat array and
+// processed backwards to keep the inputs intact. The first frame is differenced against
+// the last frame of the previous buffer.
+EXPORT void effects_noise_sharpening(EffectsContext* effects_context,
+                                     double effect_size,
+                                     uint8_t channel_count,
+                                     float* samples,
+                                     uint32_t byte_length) {
+    if (channel_count == 0 || channel_count > EFFECT_MAX_CHANNELS) {
+        return;
+    }
+    const uint32_t length = byte_length / sizeof(float) / channel_count;
+    if (length == 0 || effect_size <= 0) {
+        return;
+    }
+    NoiseSharpening* noise_sharpening = &effects_context->noise_sharpening;
+    const uint32_t sample_count = length * channel_count;
+    const float k = effect_size;
+    float last_frame[EFFECT_MAX_CHANNELS];
+    memmove(last_frame, samples + sample_count - channel_count, channel_count * sizeof(float));
+
+    const f32x4 ks = f32x4_splat(k);
+    uint32_t j = sample_count;
+    while (j >= channel_count + 4) {
+        j -= 4;
+        f32x4 sample = f32x4_load(samples + j);
+        f32x4 previous_sample = f32x4_load(samples + j - channel_count);
+        f32x4_store(samples + j, sample + ks * (sample - previous_sample));
+    }
+    while (j > channel_count) {
+        --j;
+        float sample = samples[j];
+        samples[j] = sample + k * (sample - samples[j - channel_count]);
     }
+    for (uint8_t ch = 0; ch < channel_count; ++ch) {
+        float sample = samples[ch];
+        samples[ch] = sample + k * (sample - noise_sharpening->previous[ch]);
+    }
+
+    memmove(noise_sharpening->previous, last_frame, channel_count * sizeof(float));
 }
 
 EXPORT void effects_crossfade_fade_in(double track_current_time,
@@ -138,74 +421,787 @@ EXPORT void effects_crossfade_fade_out(double track_current_time,
     }
 }
 
-#define EFFECT_APPLY_BAND(input, output, state_index_base, param_base, param_ptr)                       \
-        output = param_ptr[param_base + 0] * input +                                                    \
-                 param_ptr[param_base + 1] * effects_equalizer_state[state_index_base + 0] +            \
-                 param_ptr[param_base + 2] * effects_equalizer_state[state_index_base + 1] -            \
-                 param_ptr[param_base + 3] * effects_equalizer_state[state_index_base + 2] -            \
-                 param_ptr[param_base + 4] * effects_equalizer_state[state_index_base + 3];             \
-        effects_equalizer_state[state_index_base + 1] = effects_equalizer_state[state_index_base + 0];  \
-        effects_equalizer_state[state_index_base + 0] = input;                                          \
-        effects_equalizer_state[state_index_base + 3] = effects_equalizer_state[state_index_base + 2];  \
-        effects_equalizer_state[state_index_base + 2] = output;
+// Two channels share one f64x2, so a channel pair costs the same number of instructions
+// as a single channel. Coefficients and state of the active bands are copied into locals
+// for the duration of the buffer. One kernel is generated per active band count N, so the
+// band loop fully unrolls and all of them stay in registers. stride is the frame size in
+// samples.
+#define EFFECT_EQUALIZER_PAIR_KERNEL(N)                                                                 \
+static void effects_equalizer_apply_pair_##N(f64x2 (*pair_state)[EFFECT_EQUALIZER_STATE_PARAMS],        \
+                                             float* samples,                                            \
+                                             uint32_t stride,                                           \
+                                             uint32_t frame_length,                                     \
+                                             const double* param_ptr,                                   \
+                                             const uint8_t* active_bands) {                             \
+    f64x2 b0[N], b1[N], b2[N], a1[N], a2[N], z1[N], z2[N];                                              \
+    for (int j = 0; j < N; ++j) {                                                                       \
+        const double* coeffs = param_ptr + active_bands[j] * EFFECT_EQUALIZER_COEFF_PARAMS;             \
+        b0[j] = f64x2_splat(coeffs[0]);                                                                 \
+        b1[j] = f64x2_splat(coeffs[1]);                                                                 \
+        b2[j] = f64x2_splat(coeffs[2]);                                                                 \
+        a1[j] = f64x2_splat(coeffs[3]);                                                                 \
+        a2[j] = f64x2_splat(coeffs[4]);                                                                 \
+        z1[j] = pair_state[active_bands[j]][0];                                                         \
+        z2[j] = pair_state[active_bands[j]][1];                                                         \
+    }                                                                                                   \
+                                                                                                        \
+    const f64x2 offset = f64x2_splat(EFFECT_DENORMAL_OFFSET);                                           \
+    for (uint32_t i = 0; i < frame_length; ++i) {                                                       \
+        float* frame = samples + i * stride;                                                            \
+        f64x2 x = (f64x2){ frame[0], frame[1] } + offset;                                               \
+        for (int j = 0; j < N; ++j) {                                                                   \
+            f64x2 y = b0[j] * x + z1[j];                                                                \
+            z1[j] = b1[j] * x - a1[j] * y + z2[j];                                                      \
+            z2[j] = b2[j] * x - a2[j] * y;                                                              \
+            x = y;                                                                                      \
+        }                                                                                               \
+        frame[0] = x[0];                                                                                \
+        frame[1] = x[1];                                                                                \
+    }                                                                                                   \
+                                                                                                        \
+    for (int j = 0; j < N; ++j) {                                                                       \
+        pair_state[active_bands[j]][0] = z1[j];                                                         \
+        pair_state[active_bands[j]][1] = z2[j];                                                         \
+    }                                                                                                   \
+}
+
+// Scalar version of the above for mono sources and the odd channel out, its state lives
+// in the first lane of the pair.
+#define EFFECT_EQUALIZER_SINGLE_KERNEL(N)                                                               \
+static void effects_equalizer_apply_single_##N(f64x2 (*pair_state)[EFFECT_EQUALIZER_STATE_PARAMS],      \
+                                               float* samples,                                          \
+                                               uint32_t stride,                                         \
+                                               uint32_t frame_length,                                   \
+                                               const double* param_ptr,                                 \
+                                               const uint8_t* active_bands) {                           \
+    double b0[N], b1[N], b2[N], a1[N], a2[N], z1[N], z2[N];                                             \
+    for (int j = 0; j < N; ++j) {                                                                       \
+        const double* coeffs = param_ptr + active_bands[j] * EFFECT_EQUALIZER_COEFF_PARAMS;             \
+        b0[j] = coeffs[0];                                                                              \
+        b1[j] = coeffs[1];                                                                              \
+        b2[j] = coeffs[2];                                                                              \
+        a1[j] = coeffs[3];                                                                              \
+        a2[j] = coeffs[4];                                                                              \
+        z1[j] = pair_state[active_bands[j]][0][0];                                                      \
+        z2[j] = pair_state[active_bands[j]][1][0];                                                      \
+    }                                                                                                   \
+                                                                                                        \
+    for (uint32_t i = 0; i < frame_length; ++i) {                                                       \
+        double x = (double)samples[i * stride] + EFFECT_DENORMAL_OFFSET;                                \
+        for (int j = 0; j < N; ++j) {                                                                   \
+            double y = b0[j] * x + z1[j];                                                               \
+            z1[j] = b1[j] * x - a1[j] * y + z2[j];                                                      \
+            z2[j] = b2[j] * x - a2[j] * y;                                                              \
+            x = y;                                                                                      \
+        }                                                                                               \
+        samples[i * stride] = x;                                                                        \
+    }                                                                                                   \
+                                                                                                        \
+    for (int j = 0; j < N; ++j) {                                                                       \
+        pair_state[active_bands[j]][0][0] = z1[j];                                                      \
+        pair_state[active_bands[j]][1][0] = z2[j];                                                      \
+    }                                                                                                   \
+}
+
+#define EFFECT_EQUALIZER_KERNELS(N) EFFECT_EQUALIZER_PAIR_KERNEL(N) EFFECT_EQUALIZER_SINGLE_KERNEL(N)
+EFFECT_EQUALIZER_KERNELS(1)
+EFFECT_EQUALIZER_KERNELS(2)
+EFFECT_EQUALIZER_KERNELS(3)
+EFFECT_EQUALIZER_KERNELS(4)
+EFFECT_EQUALIZER_KERNELS(5)
+EFFECT_EQUALIZER_KERNELS(6)
+EFFECT_EQUALIZER_KERNELS(7)
+EFFECT_EQUALIZER_KERNELS(8)
+EFFECT_EQUALIZER_KERNELS(9)
+EFFECT_EQUALIZER_KERNELS(10)
+#undef EFFECT_EQUALIZER_KERNELS
+#undef EFFECT_EQUALIZER_SINGLE_KERNEL
+#undef EFFECT_EQUALIZER_PAIR_KERNEL
+
+// Indexed by active band count.
+static const EqualizerKernel effects_equalizer_pair_kernels[EFFECT_EQUALIZER_BAND_COUNT + 1] = {
+    NULL,
+    effects_equalizer_apply_pair_1, effects_equalizer_apply_pair_2, effects_equalizer_apply_pair_3,
+    effects_equalizer_apply_pair_4, effects_equalizer_apply_pair_5, effects_equalizer_apply_pair_6,
+    effects_equalizer_apply_pair_7, effects_equalizer_apply_pair_8, effects_equalizer_apply_pair_9,
+    effects_equalizer_apply_pair_10
+};
+
+static const EqualizerKernel effects_equalizer_single_kernels[EFFECT_EQUALIZER_BAND_COUNT + 1] = {
+    NULL,
+    effects_equalizer_apply_single_1, effects_equalizer_apply_single_2, effects_equalizer_apply_single_3,
+    effects_equalizer_apply_single_4, effects_equalizer_apply_single_5, effects_equalizer_apply_single_6,
+    effects_equalizer_apply_single_7, effects_equalizer_apply_single_8, effects_equalizer_apply_single_9,
+    effects_equalizer_apply_single_10
+};
 
-#define EFFECT_APPLY_BAND_TO_CHANNEL(input, output, channel_index, channel_count, band_index, param_ptr)    \
-        EFFECT_APPLY_BAND(input, output,                                                                    \
-                          (band_index * channel_count + channel_index) * EFFECT_EQUALIZER_STATE_PARAMS,     \
-                          (band_index * EFFECT_EQUALIZER_COEFF_PARAMS),                                     \
-                          param_ptr)
+static void effects_equalizer_run(Equalizer* equalizer, float* samples, uint32_t channel_count, uint32_t frame_length) {
+    if (equalizer->active_band_count == 0) {
+        return;
+    }
+    EqualizerState* equalizer_state = &equalizer->state;
+    const double* param_ptr = equalizer->coefficients;
+    const uint8_t* active_bands = equalizer->active_bands;
+    EqualizerKernel pair_kernel = effects_equalizer_pair_kernels[equalizer->active_band_count];
+    EqualizerKernel single_kernel = effects_equalizer_single_kernels[equalizer->active_band_count];
+
+    if (channel_count == 1) {
+        single_kernel(equalizer_state->state[0], samples, 1, frame_length, param_ptr, active_bands);
+    } else if (channel_count == 2) {
+        pair_kernel(equalizer_state->state[0], samples, 2, frame_length, param_ptr, active_bands);
+    } else {
+        uint32_t ch = 0;
+        for (; ch + 2 <= channel_count; ch += 2) {
+            pair_kernel(equalizer_state->state[ch / 2], samples + ch, channel_count, frame_length, param_ptr,
+                        active_bands);
+        }
+        if (ch < channel_count) {
+            single_kernel(equalizer_state->state[ch / 2], samples + ch, channel_count, frame_length, param_ptr,
+                          active_bands);
+        }
+    }
+}
 
-EXPORT void effects_equalizer_apply(float* samples,
+EXPORT void effects_equalizer_apply(EffectsContext* effects_context,
+                                    float* samples,
                                     uint32_t byte_length,
-                                    uint32_t channel_count,
-                                    double* param_ptr) {
+                                    uint32_t channel_count) {
+    if (channel_count == 0 || channel_count > EFFECT_EQUALIZER_MAX_CHANNELS) {
+        return;
+    }
     uint32_t frame_length = byte_length / sizeof(float) / channel_count;
-    if (channel_count > EFFECT_EQUALIZER_MAX_CHANNELS) {
+    Equalizer* equalizer = &effects_context->equalizer;
+
+    while (equalizer->ramp_blocks_remaining > 0 && frame_length > 0) {
+        uint32_t block_length = MIN(frame_length, EFFECT_EQUALIZER_RAMP_BLOCK_FRAMES);
+        effects_equalizer_step_ramp(equalizer);
+        effects_equalizer_run(equalizer, samples, channel_count, block_length);
+        samples += block_length * channel_count;
+        frame_length -= block_length;
+    }
+
+    if (frame_length > 0) {
+        effects_equalizer_run(equalizer, samples, channel_count, frame_length);
+    }
+}
+
+// The impulse response is resampled from impulse_response_sample_rate to the sample_rate
+// of the audio it is applied to. Its gain is scaled by the inverse ratio, a response with
+// more taps per second would otherwise sum up louder.
+EXPORT ConvolverImpulseResponse* effects_convolver_impulse_response_create(const float* samples,
+                                                                           uint32_t frame_count,
+                                                                           uint32_t channel_count,
+                                                                           uint32_t impulse_response_sample_rate,
+                                                                           uint32_t sample_rate,
+                                                                           uint32_t partition_frames) {
+    if (channel_count == 0 || channel_count > EFFECT_CONVOLVER_MAX_IR_CHANNELS || frame_count == 0 ||
+        frame_count > EFFECT_CONVOLVER_MAX_IR_FRAMES || partition_frames < EFFECT_CONVOLVER_MIN_PARTITION_FRAMES ||
+        partition_frames > EFFECT_CONVOLVER_MAX_PARTITION_FRAMES || (partition_frames & (partition_frames - 1)) != 0 ||
+        impulse_response_sample_rate == 0 || sample_rate == 0) {
+        return NULL;
+    }
+
+    float* resampled = NULL;
+    float gain = 1.0f;
+    if (impulse_response_sample_rate != sample_rate) {
+        const double ratio = (double)sample_rate / (double)impulse_response_sample_rate;
+        const uint32_t resampled_capacity = (uint32_t)ceil(ratio * (double)frame_count) + 1;
+        resampled = malloc(sizeof(float) * resampled_capacity * channel_count);
+        if (!resampled) {
+            return NULL;
+        }
+        SRC_DATA data;
+        data.data_in = samples;
+        data.data_out = resampled;
+        data.input_frames = frame_count;
+        data.output_frames = resampled_capacity;
+        data.src_ratio = ratio;
+        if (src_simple(&data, SRC_LINEAR, channel_count) != 0 || data.output_frames_gen == 0) {
+            free(resampled);
+            return NULL;
+        }
+        samples = resampled;
+        frame_count = MIN(EFFECT_CONVOLVER_MAX_IR_FRAMES, (uint32_t)data.output_frames_gen);
+        gain = (float)(1.0 / ratio);
+    }
+
+    ConvolverImpulseResponse* impulse_response = malloc(sizeof(ConvolverImpulseResponse));
+    if (!impulse_response) {
+        free(resampled);
+        return NULL;
+    }
+    const uint32_t fft_size = partition_frames * 2;
+    const uint32_t partition_count = (frame_count + partition_frames - 1) / partition_frames;
+    impulse_response->reference_count = 1;
+    impulse_response->channel_count = channel_count;
+    impulse_response->frame_count = frame_count;
+    impulse_response->partition_frames = partition_frames;
+    impulse_response->partition_count = partition_count;
+    impulse_response->plan = float_fft_plan_create(fft_size);
+    impulse_response->spectra = malloc(sizeof(float) * fft_size * partition_count * channel_count);
+    float* partition = malloc(sizeof(float) * fft_size);
+    if (!impulse_response->plan || !impulse_response->spectra || !partition) {
+        free(partition);
+        free(resampled);
+        effects_convolver_impulse_response_release(impulse_response);
+        return NULL;
+    }
+
+    const float scale = gain / (float)fft_size;
+    for (uint32_t ch = 0; ch < channel_count; ++ch) {
+        for (uint32_t p = 0; p < partition_count; ++p) {
+            const uint32_t start = p * partition_frames;
+            const uint32_t frames = MIN(partition_frames, frame_count - start);
+            memset(partition, 0, sizeof(float) * fft_size);
+            for (uint32_t i = 0; i < frames; ++i) {
+                partition[i] = samples[(start + i) * channel_count + ch] * scale;
+            }
+            float_fft_forward(impulse_response->plan,
+                              partition,
+                              impulse_response->spectra + (ch * partition_count + p) * fft_size);
+        }
+    }
+    free(partition);
+    free(resampled);
+    return impulse_response;
+}
+
+EXPORT void effects_convolver_impulse_response_release(ConvolverImpulseResponse* impulse_response) {
+    if (!impulse_response || --impulse_response->reference_count > 0) {
         return;
-    } else if (channel_count == 2) {
-        for (int i = 0; i < frame_length; ++i) {
-            double tmp1, tmp2, result;
-
-            tmp1 = samples[i * 2];
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp1, tmp2, 0, 2, 0, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp2, tmp1, 0, 2, 1, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp1, tmp2, 0, 2, 2, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp2, tmp1, 0, 2, 3, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp1, tmp2, 0, 2, 4, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp2, tmp1, 0, 2, 5, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp1, tmp2, 0, 2, 6, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp2, tmp1, 0, 2, 7, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp1, tmp2, 0, 2, 8, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp2, result, 0, 2, 9, param_ptr);
-            samples[i * 2] = result;
-
-            tmp1 = samples[i * 2 + 1];
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp1, tmp2, 1, 2, 0, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp2, tmp1, 1, 2, 1, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp1, tmp2, 1, 2, 2, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp2, tmp1, 1, 2, 3, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp1, tmp2, 1, 2, 4, param_ptr);
-            tmp2 = SATURATE_DOUBLE(tmp2);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp2, tmp1, 1, 2, 5, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp1, tmp2, 1, 2, 6, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp2, tmp1, 1, 2, 7, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp1, tmp2, 1, 2, 8, param_ptr);
-            EFFECT_APPLY_BAND_TO_CHANNEL(tmp2, result, 1, 2, 9, param_ptr);
-            samples[i * 2 + 1] = result;
+    }
+    float_fft_plan_destroy(impulse_response->plan);
+    free(impulse_response->spectra);
+    free(impulse_response);
+}
 
-            if ((i & (EFFECT_BLOCK_SIZE - 1)) == 0) {
-                const uint64_t* effects_equalizer_state_bits = (uint64_t*) effects_equalizer_state;
-                for (int j = 0; j < EFFECT_EQUALIZER_STATE_LENGTH; ++j) {
-                    if ((effects_equalizer_state_bits[j] & 0x7FF0000000000000LLU) == 0LLU) {
-                        effects_equalizer_state[j] = 0.0;
-                    }
-                }
+static void effects_convolver_free_buffers(Convolver* convolver) {
+    free(convolver->delay_line);
+    convolver->delay_line = NULL;
+    convolver->input = NULL;
+    convolver->output = NULL;
+    convolver->accumulator = NULL;
+    convolver->channel_count = 0;
+}
+
+// All buffers of a context share one allocation.
+static int effects_convolver_allocate_buffers(Convolver* convolver, uint32_t channel_count) {
+    const ConvolverImpulseResponse* impulse_response = convolver->impulse_response;
+    const uint32_t partition_frames = impulse_response->partition_frames;
+    const uint32_t fft_size = partition_frames * 2;
+    const size_t delay_line_length = (size_t)fft_size * impulse_response->partition_count * channel_count;
+    const size_t input_length = (size_t)fft_size * channel_count;
+    const size_t output_length = (size_t)partition_frames * channel_count;
+
+    effects_convolver_free_buffers(convolver);
+    float* buffers = malloc(sizeof(float) * (delay_line_length + input_length + output_length + fft_size));
+    if (!buffers) {
+        return 0;
+    }
+    convolver->delay_line = buffers;
+    convolver->input = convolver->delay_line + delay_line_length;
+    convolver->output = convolver->input + input_length;
+    convolver->accumulator = convolver->output + output_length;
+    convolver->channel_count = channel_count;
+    return 1;
+}
+
+EXPORT void effects_convolver_set_impulse_response(EffectsContext* effects_context,
+                                                   ConvolverImpulseResponse* impulse_response) {
+    Convolver* convolver = &effects_context->convolver;
+    if (convolver->impulse_response == impulse_response) {
+        return;
+    }
+    if (impulse_response) {
+        impulse_response->reference_count++;
+    }
+    effects_convolver_impulse_response_release(convolver->impulse_response);
+    effects_convolver_free_buffers(convolver);
+    convolver->impulse_response = impulse_response;
+    convolver->position = 0;
+    convolver->delay_line_index = 0;
+}
+
+EXPORT void effects_convolver_reset(EffectsContext* effects_context) {
+    Convolver* convolver = &effects_context->convolver;
+    convolver->position = 0;
+    convolver->delay_line_index = 0;
+    if (convolver->channel_count > 0) {
+        const ConvolverImpulseResponse* impulse_response = convolver->impulse_response;
+        const uint32_t partition_frames = impulse_response->partition_frames;
+        const uint32_t channel_count = convolver->channel_count;
+        const size_t length = (size_t)partition_frames * 2 * impulse_response->partition_count * channel_count +
+                              (size_t)partition_frames * 3 * channel_count;
+        memset(convolver->delay_line, 0, sizeof(float) * length);
+    }
+}
+
+// accumulator += a * b over half_size bins in the split layout of float_fft_forward.
+static void effects_convolver_multiply_accumulate(float* accumulator,
+                                                  const float* a,
+                                                  const float* b,
+                                                  uint32_t half_size) {
+    // Bin 0 holds the real DC and Nyquist values, which the vector loop would mix up.
+    const float dc = accumulator[0] + a[0] * b[0];
+    const float nyquist = accumulator[half_size] + a[half_size] * b[half_size];
+
+    float* accumulator_im = accumulator + half_size;
+    const float* a_im = a + half_size;
+    const float* b_im = b + half_size;
+    for (uint32_t k = 0; k < half_size; k += 4) {
+        const f32x4 ar = f32x4_load(a + k);
+        const f32x4 ai = f32x4_load(a_im + k);
+        const f32x4 br = f32x4_load(b + k);
+        const f32x4 bi = f32x4_load(b_im + k);
+        f32x4_store(accumulator + k, f32x4_load(accumulator + k) + ar * br - ai * bi);
+        f32x4_store(accumulator_im + k, f32x4_load(accumulator_im + k) + ar * bi + ai * br);
+    }
+    accumulator[0] = dc;
+    accumulator[half_size] = nyquist;
+}
+
+// Runs once a full partition of input has been received and computes the output for the next one.
+static void effects_convolver_process_partition(Convolver* convolver) {
+    const ConvolverImpulseResponse* impulse_response = convolver->impulse_response;
+    const uint32_t partition_frames = impulse_response->partition_frames;
+    const uint32_t partition_count = impulse_response->partition_count;
+    const uint32_t fft_size = partition_frames * 2;
+    const uint32_t newest = convolver->delay_line_index == partition_count - 1 ? 0 : convolver->delay_line_index + 1;
+    float* accumulator = convolver->accumulator;
+
+    for (uint32_t ch = 0; ch < convolver->channel_count; ++ch) {
+        float* input = convolver->input + ch * fft_size;
+        float* delay_line = convolver->delay_line + ch * partition_count * fft_size;
+        const float* spectra =
+            impulse_response->spectra + (ch % impulse_response->channel_count) * partition_count * fft_size;
+
+        float_fft_forward(impulse_response->plan, input, delay_line + newest * fft_size);
+        memcpy(input, input + partition_frames, sizeof(float) * partition_frames);
+
+        memset(accumulator, 0, sizeof(float) * fft_size);
+        uint32_t slot = newest;
+        for (uint32_t p = 0; p < partition_count; ++p) {
+            effects_convolver_multiply_accumulate(
+                accumulator, delay_line + slot * fft_size, spectra + p * fft_size, partition_frames);
+            slot = slot == 0 ? partition_count - 1 : slot - 1;
+        }
+
+        // The first half wrapped around in the circular convolution, the second half is valid.
+        float_fft_inverse(impulse_response->plan, accumulator, accumulator);
+        memcpy(convolver->output + ch * partition_frames,
+               accumulator + partition_frames,
+               sizeof(float) * partition_frames);
+    }
+    convolver->delay_line_index = newest;
+}
+
+// Replaces the samples with their convolution with the impulse response, delayed by one partition.
+EXPORT void effects_convolver_apply(EffectsContext* effects_context,
+                                    float* samples,
+                                    uint32_t byte_length,
+                                    uint32_t channel_count) {
+    Convolver* convolver = &effects_context->convolver;
+    if (!convolver->impulse_response || channel_count == 0 || channel_count > EFFECT_MAX_CHANNELS) {
+        return;
+    }
+    if (convolver->channel_count != channel_count) {
+        if (!effects_convolver_allocate_buffers(convolver, channel_count)) {
+            return;
+        }
+        effects_convolver_reset(effects_context);
+    }
+
+    const uint32_t partition_frames = convolver->impulse_response->partition_frames;
+    const uint32_t fft_size = partition_frames * 2;
+    const uint32_t frame_count = byte_length / sizeof(float) / channel_count;
+    uint32_t frame = 0;
+    while (frame < frame_count) {
+        const uint32_t position = convolver->position;
+        const uint32_t frames = MIN(partition_frames - position, frame_count - frame);
+        for (uint32_t ch = 0; ch < channel_count; ++ch) {
+            float* input = convolver->input + ch * fft_size + partition_frames + position;
+            const float* output = convolver->output + ch * partition_frames + position;
+            float* channel_samples = samples + frame * channel_count + ch;
+            for (uint32_t i = 0; i < frames; ++i) {
+                input[i] = channel_samples[i * channel_count];
+                channel_samples[i * channel_count] = output[i];
             }
         }
-    } else {
+        frame += frames;
+        convolver->position += frames;
+        if (convolver->position == partition_frames) {
+            effects_convolver_process_partition(convolver);
+            convolver->position = 0;
+        }
+    }
+}
+
+static void effects_limiter_free_interpolator(Limiter* limiter) {
+    interp_destroy(limiter->interp);
+    limiter->interp = NULL;
+    free(limiter->oversampled);
+    limiter->oversampled = NULL;
+}
+
+static void effects_limiter_reset_state(Limiter* limiter) {
+    const uint32_t window_length = limiter->lookahead + 1;
+    limiter->frame_index = 0;
+    limiter->delay_index = 0;
+    limiter->window_index = 0;
+    limiter->release_gain = 1.0f;
+    limiter->window_sum = (double)window_length;
+    limiter->deque_head = 0;
+    limiter->deque_length = 0;
+    for (uint32_t i = 0; i < window_length; ++i) {
+        limiter->window_gains[i] = 1.0f;
+    }
+    memset(limiter->delay_line, 0, sizeof(float) * limiter->delay_frames * limiter->channel_count);
+
+    if (limiter->interp) {
+        interp_reset(limiter->interp);
+    }
+}
+
+// Returns 0 when the true peak interpolator could not be allocated.
+static int effects_limiter_configure(Limiter* limiter,
+                                     uint32_t sample_rate,
+                                     uint32_t channel_count,
+                                     uint8_t true_peak) {
+    if (limiter->sample_rate == sample_rate && limiter->channel_count == channel_count &&
+        limiter->true_peak == true_peak) {
+        return 1;
+    }
+
+    effects_limiter_free_interpolator(limiter);
+    limiter->sample_rate = sample_rate;
+    limiter->channel_count = channel_count;
+    limiter->true_peak = true_peak;
+    limiter->lookahead = MAX(1, MIN(EFFECT_LIMITER_MAX_LOOKAHEAD_FRAMES,
+                                    (uint32_t)(EFFECT_LIMITER_LOOKAHEAD_SECONDS * sample_rate + 0.5)));
+    limiter->release_coefficient = exp(-1.0 / (EFFECT_LIMITER_RELEASE_SECONDS * sample_rate));
+    limiter->delay_frames = limiter->lookahead;
+
+    // Same oversampling as libebur128, which measures sample peaks from 192 kHz up.
+    if (true_peak && sample_rate < 192000) {
+        const uint32_t factor = sample_rate < 96000 ? 4 : 2;
+        limiter->interp = interp_create(EFFECT_LIMITER_INTERPOLATOR_TAPS, factor, channel_count);
+        limiter->oversampled = malloc(sizeof(float) * EFFECT_LIMITER_BLOCK_FRAMES * factor * channel_count);
+        if (!limiter->interp || !limiter->oversampled) {
+            effects_limiter_free_interpolator(limiter);
+            limiter->sample_rate = 0;
+            return 0;
+        }
+        limiter->delay_frames += limiter->interp->delay / 2;
+    }
+    effects_limiter_reset_state(limiter);
+    return 1;
+}
+
+EXPORT void effects_limiter_reset(EffectsContext* effects_context) {
+    Limiter* limiter = &effects_context->limiter;
+    if (limiter->sample_rate != 0) {
+        effects_limiter_reset_state(limiter);
+    }
+}
+
+static void effects_limiter_process_block(Limiter* limiter, float ceiling, float* samples, uint32_t frame_count) {
+    const uint32_t channel_count = limiter->channel_count;
+    const uint32_t window_length = limiter->lookahead + 1;
+    const float release_coefficient = limiter->release_coefficient;
+    const float* peaks = samples;
+    uint32_t peak_stride = channel_count;
+    if (limiter->interp) {
+        interp_process(limiter->interp, frame_count, samples, limiter->oversampled);
+        peaks = limiter->oversampled;
+        peak_stride = channel_count * limiter->interp->factor;
+    }
+
+    for (uint32_t i = 0; i < frame_count; ++i) {
+        float peak = 0.0f;
+        for (uint32_t j = 0; j < peak_stride; ++j) {
+            peak = MAX(peak, fabsf(peaks[i * peak_stride + j]));
+        }
+        const float required_gain = peak > ceiling ? ceiling / peak : 1.0f;
+
+        // Expire before pushing so the deque never holds more than the window, which is
+        // exactly its capacity at the largest lookahead.
+        if (limiter->deque_length > 0 && limiter->frame_index - limiter->deque_frames[limiter->deque_head] >= window_length) {
+            limiter->deque_head = (limiter->deque_head + 1) % EFFECT_LIMITER_WINDOW_CAPACITY;
+            limiter->deque_length--;
+        }
+
+        // Gains that are not smaller than a newer one can never be the window minimum again.
+        while (limiter->deque_length > 0) {
+            const uint32_t tail = (limiter->deque_head + limiter->deque_length - 1) % EFFECT_LIMITER_WINDOW_CAPACITY;
+            if (limiter->deque_gains[tail] < required_gain) {
+                break;
+            }
+            limiter->deque_length--;
+        }
+        const uint32_t tail = (limiter->deque_head + limiter->deque_length) % EFFECT_LIMITER_WINDOW_CAPACITY;
+        limiter->deque_frames[tail] = limiter->frame_index;
+        limiter->deque_gains[tail] = required_gain;
+        limiter->deque_length++;
+
+        // Instant attack on the held minimum, exponential release.
+        const float held_gain = limiter->deque_gains[limiter->deque_head];
+        float release_gain = limiter->release_gain;
+        if (held_gain < release_gain) {
+            release_gain = held_gain;
+        } else {
+            release_gain = held_gain + release_coefficient * (release_gain - held_gain);
+        }
+        limiter->release_gain = release_gain;
+
+        limiter->window_sum += release_gain - limiter->window_gains[limiter->window_index];
+        limiter->window_gains[limiter->window_index] = release_gain;
+        limiter->window_index = limiter->window_index + 1 == window_length ? 0 : limiter->window_index + 1;
+        const float gain = (float)(limiter->window_sum / window_length);
+
+        float* delayed = limiter->delay_line + limiter->delay_index * channel_count;
+        float* frame = samples + i * channel_count;
+        for (uint32_t ch = 0; ch < channel_count; ++ch) {
+            const float sample = delayed[ch];
+            delayed[ch] = frame[ch];
+            frame[ch] = sample * gain;
+        }
+        limiter->delay_index = limiter->delay_index + 1 == limiter->delay_frames ? 0 : limiter->delay_index + 1;
+        limiter->frame_index++;
+    }
+}
+
+// Keeps every sample, or with true_peak every 4x oversampled sample, at or under the linear
+// ceiling. The output lags the input by the lookahead.
+EXPORT void effects_limiter_apply(EffectsContext* effects_context,
+                                  double ceiling,
+                                  uint32_t true_peak,
+                                  uint32_t sample_rate,
+                                  uint32_t channel_count,
+                                  float* samples,
+                                  uint32_t byte_length) {
+    Limiter* limiter = &effects_context->limiter;
+    if (ceiling <= 0 || sample_rate == 0 || channel_count == 0 || channel_count > EFFECT_MAX_CHANNELS) {
+        return;
+    }
+    if (!effects_limiter_configure(limiter, sample_rate, channel_count, true_peak != 0)) {
+        return;
+    }
+
+    const uint32_t frame_count = byte_length / sizeof(float) / channel_count;
+    for (uint32_t offset = 0; offset < frame_count; offset += EFFECT_LIMITER_BLOCK_FRAMES) {
+        effects_limiter_process_block(limiter,
+                                      (float)ceiling,
+                                      samples + offset * channel_count,
+                                      MIN(EFFECT_LIMITER_BLOCK_FRAMES, frame_count - offset));
+    }
+}
+
+EXPORT int effects_chain_set_stages(EffectsContext* effects_context, uint8_t* stages, uint32_t stage_count) {
+    if (stage_count > EFFECT_CHAIN_MAX_STAGES) {
+        return 1;
+    }
+    for (uint32_t i = 0; i < stage_count; ++i) {
+        if (stages[i] >= EFFECT_STAGE_MAX) {
+            return 1;
+        }
+    }
+    memmove(effects_context->chain.stages, stages, stage_count);
+    effects_context->chain.stage_count = stage_count;
+    return 0;
+}
+
+EXPORT double* effects_chain_get_params(EffectsContext* effects_context) {
+    return effects_context->chain.params;
+}
+
+// Per-buffer values of the gain and crossfade stages, derived once before the block loop.
+typedef struct {
+    float gain;
+    float previous_gain;
+    uint8_t ramp_gain;
+    uint32_t fade_in_frames;
+    uint32_t fade_out_frames_needed;
+    uint8_t fade_out;
+} EffectChainBufferState;
+
+static void effects_chain_apply_gain(const EffectChainBufferState* buffer_state,
+                                     float* samples,
+                                     uint32_t channel_count,
+                                     uint32_t frame_offset,
+                                     uint32_t frame_count,
+                                     uint32_t total_frame_count) {
+    if (buffer_state->ramp_gain) {
+        const float denominator = total_frame_count > 1 ? (float)(total_frame_count - 1) : 1.0f;
+        const float delta = buffer_state->gain - buffer_state->previous_gain;
+        for (uint32_t i = 0; i < frame_count; ++i) {
+            const float gain = ((float)(frame_offset + i) / denominator) * delta + buffer_state->previous_gain;
+            for (uint32_t ch = 0; ch < channel_count; ++ch) {
+                samples[i * channel_count + ch] *= gain;
+            }
+        }
+    } else if (buffer_state->gain != 1.0f) {
+        const uint32_t length = frame_count * channel_count;
+        const f32x4 gain = f32x4_splat(buffer_state->gain);
+        uint32_t i = 0;
+        for (; i + 4 <= length; i += 4) {
+            f32x4_store(samples + i, f32x4_load(samples + i) * gain);
+        }
+        for (; i < length; ++i) {
+            samples[i] *= buffer_state->gain;
+        }
+    }
+}
+
+static void effects_chain_scale(float* samples, uint32_t length, float volume) {
+    const f32x4 volumes = f32x4_splat(volume);
+    uint32_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        f32x4_store(samples + i, f32x4_load(samples + i) * volumes);
+    }
+    for (; i < length; ++i) {
+        samples[i] *= volume;
+    }
+}
+
+// Same curves as effects_crossfade_fade_in and effects_crossfade_fade_out, with the
+// volume updated once per block.
+static void effects_chain_apply_crossfade(const double* params,
+                                          const EffectChainBufferState* buffer_state,
+                                          float* samples,
+                                          uint32_t channel_count,
+                                          uint32_t frame_offset,
+                                          uint32_t frame_count) {
+    const double sample_rate = params[EFFECT_CHAIN_PARAM_SAMPLE_RATE];
+    const double fade_duration = params[EFFECT_CHAIN_PARAM_FADE_DURATION];
+    const double block_time = params[EFFECT_CHAIN_PARAM_CURRENT_TIME] + (double)frame_offset / sample_rate;
+
+    if (frame_offset < buffer_state->fade_in_frames) {
+        const uint32_t frames = MIN(frame_count, buffer_state->fade_in_frames - frame_offset);
+        effects_chain_scale(samples, frames * channel_count, get_fade_in_volume(0, block_time, fade_duration));
+    }
+
+    if (buffer_state->fade_out) {
+        const uint32_t frames_needed = buffer_state->fade_out_frames_needed;
+        if (frame_offset < frames_needed) {
+            const uint32_t frames = MIN(frame_count, frames_needed - frame_offset);
+            const double fade_start_time = params[EFFECT_CHAIN_PARAM_TRACK_DURATION] - fade_duration;
+            const double t = MIN(fade_duration, MAX(0, block_time - fade_start_time));
+            effects_chain_scale(samples, frames * channel_count, get_fade_out_volume(0, t, fade_duration));
+        }
+        if (frame_offset + frame_count > frames_needed) {
+            const uint32_t silent_start = MAX(frame_offset, frames_needed) - frame_offset;
+            memset(samples + silent_start * channel_count,
+                   0,
+                   (frame_count - silent_start) * channel_count * sizeof(float));
+        }
+    }
+}
+
+// Runs every configured stage over one block before moving on to the next, so each block
+// goes through the whole chain while it is still in cache.
+EXPORT void effects_chain_process(EffectsContext* effects_context, float* samples, uint32_t byte_length) {
+    EffectChain* chain = &effects_context->chain;
+    const double* params = chain->params;
+    const uint32_t channel_count = (uint32_t)params[EFFECT_CHAIN_PARAM_CHANNEL_COUNT];
+    const double sample_rate = params[EFFECT_CHAIN_PARAM_SAMPLE_RATE];
+    if (channel_count == 0 || channel_count > EFFECT_MAX_CHANNELS || sample_rate <= 0) {
         return;
     }
+    const uint32_t frame_count = byte_length / sizeof(float) / channel_count;
+    const double noise_sharpening = params[EFFECT_CHAIN_PARAM_NOISE_SHARPENING];
+    const double bass_boost = params[EFFECT_CHAIN_PARAM_BASS_BOOST];
+
+    EffectChainBufferState buffer_state;
+    const double gain = params[EFFECT_CHAIN_PARAM_GAIN];
+    const double previous_gain = params[EFFECT_CHAIN_PARAM_PREVIOUS_GAIN];
+    buffer_state.gain = gain;
+    buffer_state.previous_gain = previous_gain;
+    buffer_state.ramp_gain = previous_gain != -1.0 && fabs(gain - previous_gain) > EFFECT_CHAIN_GAIN_RAMP_THRESHOLD;
+
+    const double current_time = params[EFFECT_CHAIN_PARAM_CURRENT_TIME];
+    const double track_duration = params[EFFECT_CHAIN_PARAM_TRACK_DURATION];
+    const double fade_duration = params[EFFECT_CHAIN_PARAM_FADE_DURATION];
+    buffer_state.fade_in_frames = 0;
+    buffer_state.fade_out = 0;
+    buffer_state.fade_out_frames_needed = frame_count;
+    if (fade_duration > 0) {
+        if (params[EFFECT_CHAIN_PARAM_FADE_IN] != 0 && current_time <= fade_duration) {
+            buffer_state.fade_in_frames = MIN(frame_count, (uint32_t)((fade_duration - current_time) * sample_rate));
+        }
+        const double buffer_duration = (double)frame_count / sample_rate;
+        if (params[EFFECT_CHAIN_PARAM_FADE_OUT] != 0 &&
+            current_time + buffer_duration >= track_duration - fade_duration) {
+            buffer_state.fade_out = 1;
+            buffer_state.fade_out_frames_needed =
+                MIN(frame_count, (uint32_t)floor(MAX(0, track_duration - current_time) * sample_rate));
+        }
+    }
+
+    if (noise_sharpening > 0 && !chain->noise_sharpening_active) {
+        effects_noise_sharpening_reset(effects_context);
+    }
+    chain->noise_sharpening_active = noise_sharpening > 0;
+    if (bass_boost > 0 && !chain->bass_boost_active) {
+        effects_bass_boost_reset(effects_context);
+    }
+    chain->bass_boost_active = bass_boost > 0;
+    const double limiter_ceiling = params[EFFECT_CHAIN_PARAM_LIMITER_CEILING];
+    if (limiter_ceiling > 0 && !chain->limiter_active) {
+        effects_limiter_reset(effects_context);
+    }
+    chain->limiter_active = limiter_ceiling > 0;
+
+    for (uint32_t offset = 0; offset < frame_count; offset += EFFECT_CHAIN_BLOCK_FRAMES) {
+        const uint32_t block_frames = MIN(EFFECT_CHAIN_BLOCK_FRAMES, frame_count - offset);
+        const uint32_t block_byte_length = block_frames * channel_count * sizeof(float);
+        float* block = samples + offset * channel_count;
+
+        for (uint32_t i = 0; i < chain->stage_count; ++i) {
+            switch (chain->stages[i]) {
+                case EFFECT_STAGE_GAIN:
+                    effects_chain_apply_gain(&buffer_state, block, channel_count, offset, block_frames, frame_count);
+                    break;
+                case EFFECT_STAGE_NOISE_SHARPENING:
+                    effects_noise_sharpening(effects_context, noise_sharpening, channel_count, block, block_byte_length);
+                    break;
+                case EFFECT_STAGE_BASS_BOOST:
+                    effects_bass_boost_apply(effects_context, bass_boost, channel_count, block, block_byte_length);
+                    break;
+                case EFFECT_STAGE_EQUALIZER:
+                    effects_equalizer_apply(effects_context, block, block_byte_length, channel_count);
+                    break;
+                case EFFECT_STAGE_CONVOLVER:
+                    effects_convolver_apply(effects_context, block, block_byte_length, channel_count);
+                    break;
+                case EFFECT_STAGE_LIMITER:
+                    effects_limiter_apply(effects_context,
+                                          limiter_ceiling,
+                                          (uint32_t)params[EFFECT_CHAIN_PARAM_LIMITER_TRUE_PEAK],
+                                          (uint32_t)sample_rate,
+                                          channel_count,
+                                          block,
+                                          block_byte_length);
+                    break;
+                case EFFECT_STAGE_CROSSFADE:
+                    effects_chain_apply_crossfade(params, &buffer_state, block, channel_count, offset, block_frames);
+                    break;
+            }
+        }
+    }
 }
 
-#undef EFFECT_APPLY_BAND
-#undef EFFECT_APPLY_BAND_TO_CHANNEL
+// Frames the output of the chain lags its input by, as of the last processed buffer.
+EXPORT uint32_t effects_chain_get_latency(EffectsContext* effects_context) {
+    const EffectChain* chain = &effects_context->chain;
+    const Convolver* convolver = &effects_context->convolver;
+    const Limiter* limiter = &effects_context->limiter;
+    uint32_t latency = 0;
+    for (uint32_t i = 0; i < chain->stage_count; ++i) {
+        if (chain->stages[i] == EFFECT_STAGE_CONVOLVER && convolver->impulse_response && convolver->channel_count > 0) {
+            latency += convolver->impulse_response->partition_frames;
+        } else if (chain->stages[i] == EFFECT_STAGE_LIMITER && chain->limiter_active && limiter->sample_rate != 0) {
+            latency += limiter->delay_frames;
+        }
+    }
+    return latency;
+}
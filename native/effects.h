@@ -1,23 +1,243 @@
-#include <wasm.h>
-
 #ifndef EFFECTS_H
 #define EFFECTS_H
 
-#define EFFECT_BASS_BOOST_MAX_CHANNELS 5
+#include <wasm.h>
+#include <simd.h>
+#include <math.h>
+#include <fft/float_fft.c>
+// For the true peak interpolator of libebur128.
+#include "loudness_analyzer.h"
+// For resampling convolver impulse responses to the rate of the audio.
+#include "resampler.h"
+
+#define EFFECT_MAX_CHANNELS 8
+// Added to recursive filter inputs so that their state decays towards a tiny DC level
+// instead of into the denormal range when the signal goes silent.
+#define EFFECT_DENORMAL_OFFSET 1e-18f
 #define EFFECT_BASS_BOOST_SELECTIVITY 70.0
 #define EFFECT_BASS_BOOST_MAX_RATIO 16.0
 #define EFFECT_BASS_BOOST_MIN_RATIO 2.0
 #define EFFECT_BLOCK_SIZE 1024
 #define EFFECT_EQUALIZER_BAND_COUNT 10
-#define EFFECT_EQUALIZER_MAX_CHANNELS 2
-#define EFFECT_EQUALIZER_STATE_PARAMS 4
+#define EFFECT_EQUALIZER_MAX_CHANNELS EFFECT_MAX_CHANNELS
+// Transposed direct form II, z1 and z2 per band and channel.
+#define EFFECT_EQUALIZER_STATE_PARAMS 2
+// b0 b1 b2 a1 a2, normalized by a0.
 #define EFFECT_EQUALIZER_COEFF_PARAMS 5
-#define EFFECT_EQUALIZER_STATE_LENGTH (EFFECT_EQUALIZER_STATE_PARAMS * EFFECT_EQUALIZER_BAND_COUNT * EFFECT_EQUALIZER_MAX_CHANNELS)
+// Gain changes are ramped over EFFECT_EQUALIZER_RAMP_BLOCKS blocks of
+// EFFECT_EQUALIZER_RAMP_BLOCK_FRAMES, redesigning coefficients between blocks.
+#define EFFECT_EQUALIZER_RAMP_BLOCK_FRAMES 32
+#define EFFECT_EQUALIZER_RAMP_BLOCKS 64
+
+enum {
+    EFFECT_EQUALIZER_BAND_LOWSHELF = 0,
+    EFFECT_EQUALIZER_BAND_HIGHSHELF = 1,
+    EFFECT_EQUALIZER_BAND_PEAKING = 2
+};
+
+typedef struct {
+    // One lane per channel.
+    f32x4 state[EFFECT_MAX_CHANNELS / 4];
+} BassBoost;
+
+typedef struct {
+    // Channels are paired into vectors, each band has its own z1 and z2 per pair.
+    f64x2 state[EFFECT_EQUALIZER_MAX_CHANNELS / 2][EFFECT_EQUALIZER_BAND_COUNT][EFFECT_EQUALIZER_STATE_PARAMS];
+} EqualizerState;
+
+typedef struct {
+    uint32_t type;
+    double frequency;
+    double q;
+    double gain;
+    double target_gain;
+    // Depend on frequency and sample rate only, cached so that ramping gain is cheap.
+    double cos_w0;
+    double sin_w0;
+} EqualizerBand;
+
+typedef struct {
+    EqualizerState state;
+    EqualizerBand bands[EFFECT_EQUALIZER_BAND_COUNT];
+    double coefficients[EFFECT_EQUALIZER_BAND_COUNT * EFFECT_EQUALIZER_COEFF_PARAMS];
+    uint32_t sample_rate;
+    uint32_t ramp_blocks_remaining;
+    // Bands at 0 dB are exact identities and skipped. Bit n of active_mask is band n.
+    uint32_t active_mask;
+    uint8_t active_band_count;
+    uint8_t active_bands[EFFECT_EQUALIZER_BAND_COUNT];
+} Equalizer;
+
+typedef void (*EqualizerKernel)(f64x2 (*pair_state)[EFFECT_EQUALIZER_STATE_PARAMS],
+                                float* samples,
+                                uint32_t stride,
+                                uint32_t frame_length,
+                                const double* param_ptr,
+                                const uint8_t* active_bands);
+
+typedef struct {
+    // Last input frame of the previous buffer.
+    float previous[EFFECT_MAX_CHANNELS];
+} NoiseSharpening;
+
+// Uniformly partitioned overlap-save convolution. The impulse response is cut into
+// partitions of partition_frames whose spectra are multiplied with a frequency domain delay
+// line of past input spectra, so the cost per frame grows with the impulse response length
+// over the partition size, and the latency is exactly one partition.
+#define EFFECT_CONVOLVER_MIN_PARTITION_FRAMES 64
+#define EFFECT_CONVOLVER_MAX_PARTITION_FRAMES 8192
+#define EFFECT_CONVOLVER_MAX_IR_CHANNELS 2
+// 4 seconds at 96 kHz.
+#define EFFECT_CONVOLVER_MAX_IR_FRAMES (4 * 96000)
+
+// Immutable once created and shared by every context that uses it.
+typedef struct {
+    uint32_t reference_count;
+    uint32_t channel_count;
+    uint32_t frame_count;
+    uint32_t partition_frames;
+    uint32_t partition_count;
+    FloatFftPlan* plan;
+    // partition_count spectra of 2 * partition_frames floats per channel, prescaled by the
+    // 1 / (2 * partition_frames) that the inverse transform leaves out.
+    float* spectra;
+} ConvolverImpulseResponse;
+
+typedef struct {
+    ConvolverImpulseResponse* impulse_response;
+    // Channel count the buffers below were allocated for, 0 when they are not allocated.
+    uint32_t channel_count;
+    // Frames of the current partition received so far.
+    uint32_t position;
+    // Slot of the newest spectrum in the delay line.
+    uint32_t delay_line_index;
+    // Per channel partition_count input spectra, used as a ring.
+    float* delay_line;
+    // Per channel the previous and the current partition of input.
+    float* input;
+    // Per channel the output for the partition that is being received.
+    float* output;
+    float* accumulator;
+} Convolver;
+
+// Brickwall limiter. The gain needed to keep each frame under the ceiling is held over the
+// lookahead window and smoothed with a moving average of the same length, so the gain has
+// fully come down by the time a peak leaves the delay line.
+#define EFFECT_LIMITER_LOOKAHEAD_SECONDS 0.005
+#define EFFECT_LIMITER_RELEASE_SECONDS 0.08
+#define EFFECT_LIMITER_MAX_LOOKAHEAD_FRAMES 512
+// Peaks of the 4x oversampled signal lag the input by half the interpolator delay.
+#define EFFECT_LIMITER_INTERPOLATOR_TAPS 49
+#define EFFECT_LIMITER_MAX_INTERPOLATOR_LAG 16
+#define EFFECT_LIMITER_MAX_DELAY_FRAMES (EFFECT_LIMITER_MAX_LOOKAHEAD_FRAMES + EFFECT_LIMITER_MAX_INTERPOLATOR_LAG)
+// Window length is lookahead + 1 frames.
+#define EFFECT_LIMITER_WINDOW_CAPACITY (EFFECT_LIMITER_MAX_LOOKAHEAD_FRAMES + 1)
+#define EFFECT_LIMITER_BLOCK_FRAMES 256
+
+typedef struct {
+    uint32_t sample_rate;
+    uint32_t channel_count;
+    uint8_t true_peak;
+    uint32_t lookahead;
+    uint32_t delay_frames;
+    float release_coefficient;
+    // Index of the next frame, wraps around.
+    uint32_t frame_index;
+    uint32_t delay_index;
+    uint32_t window_index;
+    float release_gain;
+    double window_sum;
+    // Monotonic deque of required gains over the window, increasing from head to tail, so
+    // the head is the window minimum.
+    uint32_t deque_head;
+    uint32_t deque_length;
+    uint32_t deque_frames[EFFECT_LIMITER_WINDOW_CAPACITY];
+    float deque_gains[EFFECT_LIMITER_WINDOW_CAPACITY];
+    // Released gains over the window, averaged into the applied gain.
+    float window_gains[EFFECT_LIMITER_WINDOW_CAPACITY];
+    float delay_line[EFFECT_LIMITER_MAX_DELAY_FRAMES * EFFECT_MAX_CHANNELS];
+    interpolator* interp;
+    float* oversampled;
+} Limiter;
+
+// Frames pushed through every stage of an effect chain before moving on to the next
+// block, small enough that a stereo block stays in L1 between stages.
+#define EFFECT_CHAIN_BLOCK_FRAMES 256
+#define EFFECT_CHAIN_MAX_STAGES 8
+// Loudness normalization gain changes larger than this are ramped over the buffer.
+#define EFFECT_CHAIN_GAIN_RAMP_THRESHOLD 0.25
+
+enum {
+    EFFECT_STAGE_GAIN = 0,
+    EFFECT_STAGE_NOISE_SHARPENING = 1,
+    EFFECT_STAGE_BASS_BOOST = 2,
+    EFFECT_STAGE_EQUALIZER = 3,
+    EFFECT_STAGE_CROSSFADE = 4,
+    EFFECT_STAGE_CONVOLVER = 5,
+    EFFECT_STAGE_LIMITER = 6,
+
+    EFFECT_STAGE_MAX
+};
+
+// Per-buffer parameters of an effect chain, written by JS through a Float64Array so that
+// processing a buffer takes a single call.
+enum {
+    EFFECT_CHAIN_PARAM_CHANNEL_COUNT = 0,
+    EFFECT_CHAIN_PARAM_SAMPLE_RATE = 1,
+    EFFECT_CHAIN_PARAM_CURRENT_TIME = 2,
+    EFFECT_CHAIN_PARAM_TRACK_DURATION = 3,
+    // Loudness normalization gain, and the gain applied to the previous buffer or -1.
+    EFFECT_CHAIN_PARAM_GAIN = 4,
+    EFFECT_CHAIN_PARAM_PREVIOUS_GAIN = 5,
+    EFFECT_CHAIN_PARAM_NOISE_SHARPENING = 6,
+    EFFECT_CHAIN_PARAM_BASS_BOOST = 7,
+    EFFECT_CHAIN_PARAM_FADE_DURATION = 8,
+    EFFECT_CHAIN_PARAM_FADE_IN = 9,
+    EFFECT_CHAIN_PARAM_FADE_OUT = 10,
+    // Linear ceiling of the limiter, 0 when it is off, and whether it limits true peaks.
+    EFFECT_CHAIN_PARAM_LIMITER_CEILING = 11,
+    EFFECT_CHAIN_PARAM_LIMITER_TRUE_PEAK = 12,
+
+    EFFECT_CHAIN_PARAM_COUNT
+};
+
+typedef struct {
+    double params[EFFECT_CHAIN_PARAM_COUNT];
+    uint32_t stage_count;
+    uint8_t stages[EFFECT_CHAIN_MAX_STAGES];
+    // Whether the stateful stages ran on the previous buffer, their state is stale otherwise.
+    uint8_t noise_sharpening_active;
+    uint8_t bass_boost_active;
+    uint8_t limiter_active;
+} EffectChain;
+
+// All filter memory of one processing pipeline, so that concurrently decoded tracks
+// (e.g. the preloading source next to the playing one) never share state.
+typedef struct {
+    Equalizer equalizer;
+    BassBoost bass_boost;
+    NoiseSharpening noise_sharpening;
+    Convolver convolver;
+    Limiter limiter;
+    EffectChain chain;
+} EffectsContext;
 
 static double get_fade_in_volume(double t0, double t, double t1);
 static double get_fade_out_volume(double t0, double t, double t1);
+static void effects_limiter_free_interpolator(Limiter* limiter);
+
+EXPORT EffectsContext* effects_context_create(void);
+EXPORT void effects_context_destroy(EffectsContext* effects_context);
+EXPORT void effects_context_reset(EffectsContext* effects_context);
+
+EXPORT int effects_chain_set_stages(EffectsContext* effects_context, uint8_t* stages, uint32_t stage_count);
+EXPORT double* effects_chain_get_params(EffectsContext* effects_context);
+EXPORT void effects_chain_process(EffectsContext* effects_context, float* samples, uint32_t byte_length);
+EXPORT uint32_t effects_chain_get_latency(EffectsContext* effects_context);
 
-EXPORT void effects_noise_sharpening(double effect_size,
+EXPORT void effects_noise_sharpening_reset(EffectsContext* effects_context);
+EXPORT void effects_noise_sharpening(EffectsContext* effects_context,
+                                     double effect_size,
                                      uint8_t channel_count,
                                      float* samples,
                                      uint32_t byte_length);
@@ -39,15 +259,48 @@ EXPORT void effects_crossfade_fade_out(double track_duration,
                                       uint32_t frames_needed,
                                       uint32_t frames_requested);
 
-EXPORT void effects_equalizer_reset(void);
-EXPORT void effects_equalizer_apply(float* samples,
+EXPORT void effects_equalizer_reset(EffectsContext* effects_context);
+EXPORT void effects_equalizer_set_sample_rate(EffectsContext* effects_context, uint32_t sample_rate);
+EXPORT void effects_equalizer_set_band(EffectsContext* effects_context,
+                                       uint32_t band_index,
+                                       uint32_t type,
+                                       double frequency,
+                                       double q,
+                                       double gain);
+EXPORT int effects_equalizer_is_ramping(EffectsContext* effects_context);
+EXPORT void effects_equalizer_apply(EffectsContext* effects_context,
+                                    float* samples,
                                     uint32_t byte_length,
-                                    uint32_t channel_count,
-                                    double* param_ptr);
+                                    uint32_t channel_count);
 
-EXPORT void effects_bass_boost_reset(void);
-EXPORT void effects_bass_boost_apply(double effect_size,
+EXPORT void effects_bass_boost_reset(EffectsContext* effects_context);
+EXPORT void effects_bass_boost_apply(EffectsContext* effects_context,
+                                     double effect_size,
                                      uint32_t channel_count,
                                      float* samples,
                                      uint32_t byte_length);
+
+EXPORT ConvolverImpulseResponse* effects_convolver_impulse_response_create(const float* samples,
+                                                                           uint32_t frame_count,
+                                                                           uint32_t channel_count,
+                                                                           uint32_t impulse_response_sample_rate,
+                                                                           uint32_t sample_rate,
+                                                                           uint32_t partition_frames);
+EXPORT void effects_convolver_impulse_response_release(ConvolverImpulseResponse* impulse_response);
+EXPORT void effects_convolver_set_impulse_response(EffectsContext* effects_context,
+                                                   ConvolverImpulseResponse* impulse_response);
+EXPORT void effects_convolver_reset(EffectsContext* effects_context);
+EXPORT void effects_convolver_apply(EffectsContext* effects_context,
+                                    float* samples,
+                                    uint32_t byte_length,
+                                    uint32_t channel_count);
+
+EXPORT void effects_limiter_reset(EffectsContext* effects_context);
+EXPORT void effects_limiter_apply(EffectsContext* effects_context,
+                                  double ceiling,
+                                  uint32_t true_peak,
+                                  uint32_t sample_rate,
+                                  uint32_t channel_count,
+                                  float* samples,
+                                  uint32_t byte_length);
 #endif //EFFECTS_H
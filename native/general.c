@@ -7,6 +7,7 @@
 #include "mp3_decoder.c"
 #include "fingerprinter.c"
 #include "loudness_analyzer.c"
+#include "loudness_scanner.c"
 
 void initialize(int, int, int);
 static uintptr_t heapStart;
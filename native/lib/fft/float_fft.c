@@ -0,0 +1,325 @@
+#include "float_fft.h"
+
+static FloatFftPlan* float_fft_plan_create(uint32_t size) {
+    if (size < FLOAT_FFT_MIN_SIZE || size > FLOAT_FFT_MAX_SIZE || (size & (size - 1)) != 0) {
+        return NULL;
+    }
+
+    FloatFftPlan* plan = malloc(sizeof(FloatFftPlan));
+    if (!plan) {
+        return NULL;
+    }
+    const uint32_t half_size = size >> 1;
+    const uint32_t log2_half_size = 31 - CLZ(half_size);
+    const uint32_t first_quarter = (log2_half_size & 1) ? 2 : 1;
+    uint32_t twiddle_count = 0;
+    for (uint32_t quarter = first_quarter; quarter * 4 <= half_size; quarter <<= 2) {
+        twiddle_count += quarter * 6;
+    }
+
+    plan->size = size;
+    plan->half_size = half_size;
+    plan->bit_reverse = malloc(sizeof(uint32_t) * half_size);
+    plan->twiddles = malloc(sizeof(float) * twiddle_count);
+    plan->real_twiddles = malloc(sizeof(float) * size);
+    plan->work = malloc(sizeof(float) * size);
+    if (!plan->bit_reverse || !plan->twiddles || !plan->real_twiddles || !plan->work) {
+        float_fft_plan_destroy(plan);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < half_size; ++i) {
+        uint32_t reversed = 0;
+        for (uint32_t bit = 0; bit < log2_half_size; ++bit) {
+            reversed |= ((i >> bit) & 1) << (log2_half_size - 1 - bit);
+        }
+        plan->bit_reverse[i] = reversed;
+    }
+
+    float* twiddles = plan->twiddles;
+    for (uint32_t quarter = first_quarter; quarter * 4 <= half_size; quarter <<= 2) {
+        static const uint32_t multipliers[3] = {2, 1, 3};
+        for (uint32_t m = 0; m < 3; ++m) {
+            for (uint32_t j = 0; j < quarter; ++j) {
+                const double angle = -2.0 * M_PI * (double)(multipliers[m] * j) / (double)(quarter * 4);
+                twiddles[m * quarter + j] = cos(angle);
+                twiddles[(m + 3) * quarter + j] = sin(angle);
+            }
+        }
+        twiddles += quarter * 6;
+    }
+
+    for (uint32_t k = 0; k < half_size; ++k) {
+        const double angle = -2.0 * M_PI * (double)k / (double)size;
+        plan->real_twiddles[k] = cos(angle);
+        plan->real_twiddles[half_size + k] = sin(angle);
+    }
+    return plan;
+}
+
+static void float_fft_plan_destroy(FloatFftPlan* plan) {
+    if (!plan) {
+        return;
+    }
+    free(plan->bit_reverse);
+    free(plan->twiddles);
+    free(plan->real_twiddles);
+    free(plan->work);
+    free(plan);
+}
+
+// Length 2 transforms of adjacent values.
+static void float_fft_radix2_pass(float* re, float* im, uint32_t n) {
+    for (uint32_t i = 0; i < n; i += 8) {
+        f32x4 a, b, lo, hi;
+        f32x4_deinterleave2(f32x4_load(re + i), f32x4_load(re + i + 4), &a, &b);
+        f32x4_interleave2(a + b, a - b, &lo, &hi);
+        f32x4_store(re + i, lo);
+        f32x4_store(re + i + 4, hi);
+        f32x4_deinterleave2(f32x4_load(im + i), f32x4_load(im + i + 4), &a, &b);
+        f32x4_interleave2(a + b, a - b, &lo, &hi);
+        f32x4_store(im + i, lo);
+        f32x4_store(im + i + 4, hi);
+    }
+}
+
+// Combines transforms of length quarter into transforms of length 4 * quarter, the work of
+// two radix-2 passes with three complex multiplications per four values instead of four.
+static void float_fft_radix4_pass(float* re, float* im, uint32_t n, uint32_t quarter, const float* twiddles, int inverse) {
+    const float* w1r = twiddles;
+    const float* w2r = twiddles + quarter;
+    const float* w3r = twiddles + quarter * 2;
+    const float* w1i = twiddles + quarter * 3;
+    const float* w2i = twiddles + quarter * 4;
+    const float* w3i = twiddles + quarter * 5;
+    const float sign = inverse ? -1.0f : 1.0f;
+
+    if (quarter < 4) {
+        for (uint32_t group = 0; group < n; group += quarter * 4) {
+            for (uint32_t j = 0; j < quarter; ++j) {
+                const uint32_t i0 = group + j;
+                const uint32_t i1 = i0 + quarter;
+                const uint32_t i2 = i1 + quarter;
+                const uint32_t i3 = i2 + quarter;
+                const float rr = re[i1] * w1r[j] - im[i1] * w1i[j] * sign;
+                const float ri = re[i1] * w1i[j] * sign + im[i1] * w1r[j];
+                const float pr = re[i2] * w2r[j] - im[i2] * w2i[j] * sign;
+                const float pi = re[i2] * w2i[j] * sign + im[i2] * w2r[j];
+                const float qr = re[i3] * w3r[j] - im[i3] * w3i[j] * sign;
+                const float qi = re[i3] * w3i[j] * sign + im[i3] * w3r[j];
+                const float a0r = re[i0] + rr;
+                const float a0i = im[i0] + ri;
+                const float a1r = re[i0] - rr;
+                const float a1i = im[i0] - ri;
+                const float sr = pr + qr;
+                const float si = pi + qi;
+                // -i * (p - q) for the forward transform, i * (p - q) for the inverse.
+                const float dr = (pi - qi) * sign;
+                const float di = (qr - pr) * sign;
+                re[i0] = a0r + sr;
+                im[i0] = a0i + si;
+                re[i2] = a0r - sr;
+                im[i2] = a0i - si;
+                re[i1] = a1r + dr;
+                im[i1] = a1i + di;
+                re[i3] = a1r - dr;
+                im[i3] = a1i - di;
+            }
+        }
+        return;
+    }
+
+    const f32x4 signs = f32x4_splat(sign);
+    for (uint32_t group = 0; group < n; group += quarter * 4) {
+        float* re0 = re + group;
+        float* im0 = im + group;
+        float* re1 = re0 + quarter;
+        float* im1 = im0 + quarter;
+        float* re2 = re1 + quarter;
+        float* im2 = im1 + quarter;
+        float* re3 = re2 + quarter;
+        float* im3 = im2 + quarter;
+        for (uint32_t j = 0; j < quarter; j += 4) {
+            const f32x4 x1r = f32x4_load(re1 + j);
+            const f32x4 x1i = f32x4_load(im1 + j);
+            const f32x4 x2r = f32x4_load(re2 + j);
+            const f32x4 x2i = f32x4_load(im2 + j);
+            const f32x4 x3r = f32x4_load(re3 + j);
+            const f32x4 x3i = f32x4_load(im3 + j);
+            const f32x4 t1r = f32x4_load(w1r + j);
+            const f32x4 t1i = f32x4_load(w1i + j) * signs;
+            const f32x4 t2r = f32x4_load(w2r + j);
+            const f32x4 t2i = f32x4_load(w2i + j) * signs;
+            const f32x4 t3r = f32x4_load(w3r + j);
+            const f32x4 t3i = f32x4_load(w3i + j) * signs;
+
+            const f32x4 rr = x1r * t1r - x1i * t1i;
+            const f32x4 ri = x1r * t1i + x1i * t1r;
+            const f32x4 pr = x2r * t2r - x2i * t2i;
+            const f32x4 pi = x2r * t2i + x2i * t2r;
+            const f32x4 qr = x3r * t3r - x3i * t3i;
+            const f32x4 qi = x3r * t3i + x3i * t3r;
+
+            const f32x4 x0r = f32x4_load(re0 + j);
+            const f32x4 x0i = f32x4_load(im0 + j);
+            const f32x4 a0r = x0r + rr;
+            const f32x4 a0i = x0i + ri;
+            const f32x4 a1r = x0r - rr;
+            const f32x4 a1i = x0i - ri;
+            const f32x4 sr = pr + qr;
+            const f32x4 si = pi + qi;
+            const f32x4 dr = (pi - qi) * signs;
+            const f32x4 di = (qr - pr) * signs;
+
+            f32x4_store(re0 + j, a0r + sr);
+            f32x4_store(im0 + j, a0i + si);
+            f32x4_store(re2 + j, a0r - sr);
+            f32x4_store(im2 + j, a0i - si);
+            f32x4_store(re1 + j, a1r + dr);
+            f32x4_store(im1 + j, a1i + di);
+            f32x4_store(re3 + j, a1r - dr);
+            f32x4_store(im3 + j, a1i - di);
+        }
+    }
+}
+
+// Decimation in time over the half_size complex values of the work buffer in bit reversed order.
+static void float_fft_butterflies(const FloatFftPlan* plan, int inverse) {
+    const uint32_t n = plan->half_size;
+    float* re = plan->work;
+    float* im = plan->work + n;
+    const float* twiddles = plan->twiddles;
+
+    uint32_t quarter = 1;
+    if ((31 - CLZ(n)) & 1) {
+        float_fft_radix2_pass(re, im, n);
+        quarter = 2;
+    }
+    for (; quarter * 4 <= n; quarter <<= 2) {
+        float_fft_radix4_pass(re, im, n, quarter, twiddles, inverse);
+        twiddles += quarter * 6;
+    }
+}
+
+static inline f32x4 float_fft_reverse(f32x4 a) {
+    return SIMD_SHUFFLE_F32X4(a, a, 3, 2, 1, 0);
+}
+
+// Transforms size real samples as a half_size complex sequence of (even, odd) pairs and
+// separates the spectra of the even and odd samples afterwards. input and spectrum may be
+// the same buffer.
+static void float_fft_forward(FloatFftPlan* plan, const float* input, float* spectrum) {
+    const uint32_t n = plan->half_size;
+    float* work_re = plan->work;
+    float* work_im = plan->work + n;
+    const float* twiddles_re = plan->real_twiddles;
+    const float* twiddles_im = plan->real_twiddles + n;
+    float* re = spectrum;
+    float* im = spectrum + n;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        const uint32_t j = plan->bit_reverse[i];
+        work_re[i] = input[j * 2];
+        work_im[i] = input[j * 2 + 1];
+    }
+    float_fft_butterflies(plan, 0);
+
+    for (uint32_t k = 1; k < 4; ++k) {
+        const float ar = work_re[k];
+        const float ai = work_im[k];
+        const float br = work_re[n - k];
+        const float bi = work_im[n - k];
+        const float even_re = 0.5f * (ar + br);
+        const float even_im = 0.5f * (ai - bi);
+        const float odd_re = 0.5f * (ai + bi);
+        const float odd_im = 0.5f * (br - ar);
+        const float wr = twiddles_re[k];
+        const float wi = twiddles_im[k];
+        re[k] = even_re + wr * odd_re - wi * odd_im;
+        im[k] = even_im + wr * odd_im + wi * odd_re;
+    }
+
+    const f32x4 half = f32x4_splat(0.5f);
+    for (uint32_t k = 4; k < n; k += 4) {
+        const f32x4 ar = f32x4_load(work_re + k);
+        const f32x4 ai = f32x4_load(work_im + k);
+        const f32x4 br = float_fft_reverse(f32x4_load(work_re + n - k - 3));
+        const f32x4 bi = float_fft_reverse(f32x4_load(work_im + n - k - 3));
+        const f32x4 even_re = half * (ar + br);
+        const f32x4 even_im = half * (ai - bi);
+        const f32x4 odd_re = half * (ai + bi);
+        const f32x4 odd_im = half * (br - ar);
+        const f32x4 wr = f32x4_load(twiddles_re + k);
+        const f32x4 wi = f32x4_load(twiddles_im + k);
+        f32x4_store(re + k, even_re + wr * odd_re - wi * odd_im);
+        f32x4_store(im + k, even_im + wr * odd_im + wi * odd_re);
+    }
+
+    const float dc = work_re[0] + work_im[0];
+    const float nyquist = work_re[0] - work_im[0];
+    re[0] = dc;
+    im[0] = nyquist;
+}
+
+// Unnormalized, float_fft_inverse of float_fft_forward of x is size * x. spectrum and
+// output may be the same buffer.
+static void float_fft_inverse(FloatFftPlan* plan, const float* spectrum, float* output) {
+    const uint32_t n = plan->half_size;
+    float* work_re = plan->work;
+    float* work_im = plan->work + n;
+    const float* twiddles_re = plan->real_twiddles;
+    const float* twiddles_im = plan->real_twiddles + n;
+    const float* re = spectrum;
+    const float* im = spectrum + n;
+
+    work_re[0] = re[0] + im[0];
+    work_im[0] = re[0] - im[0];
+
+    for (uint32_t k = 1; k < 4; ++k) {
+        const float ar = re[k];
+        const float ai = im[k];
+        const float br = re[n - k];
+        const float bi = im[n - k];
+        const float dr = ar - br;
+        const float di = ai + bi;
+        // Multiplied by the conjugate twiddle.
+        const float wr = twiddles_re[k];
+        const float wi = -twiddles_im[k];
+        work_re[k] = ar + br - (dr * wi + di * wr);
+        work_im[k] = ai - bi + dr * wr - di * wi;
+    }
+
+    for (uint32_t k = 4; k < n; k += 4) {
+        const f32x4 ar = f32x4_load(re + k);
+        const f32x4 ai = f32x4_load(im + k);
+        const f32x4 br = float_fft_reverse(f32x4_load(re + n - k - 3));
+        const f32x4 bi = float_fft_reverse(f32x4_load(im + n - k - 3));
+        const f32x4 dr = ar - br;
+        const f32x4 di = ai + bi;
+        const f32x4 wr = f32x4_load(twiddles_re + k);
+        const f32x4 wi = -f32x4_load(twiddles_im + k);
+        f32x4_store(work_re + k, ar + br - (dr * wi + di * wr));
+        f32x4_store(work_im + k, ai - bi + dr * wr - di * wi);
+    }
+
+    // The bit reversal permutation is its own inverse, so it can be applied by swapping.
+    for (uint32_t i = 0; i < n; ++i) {
+        const uint32_t j = plan->bit_reverse[i];
+        if (i < j) {
+            const float tmp_re = work_re[i];
+            const float tmp_im = work_im[i];
+            work_re[i] = work_re[j];
+            work_im[i] = work_im[j];
+            work_re[j] = tmp_re;
+            work_im[j] = tmp_im;
+        }
+    }
+    float_fft_butterflies(plan, 1);
+
+    for (uint32_t i = 0; i < n; i += 4) {
+        f32x4 a, b;
+        f32x4_interleave2(f32x4_load(work_re + i), f32x4_load(work_im + i), &a, &b);
+        f32x4_store(output + i * 2, a);
+        f32x4_store(output + i * 2 + 4, b);
+    }
+}
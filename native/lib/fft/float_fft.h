@@ -0,0 +1,46 @@
+#ifndef FLOAT_FFT_H
+#define FLOAT_FFT_H
+
+#include <math.h>
+#include <simd.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define FLOAT_FFT_MIN_SIZE 16
+#define FLOAT_FFT_MAX_SIZE 65536
+
+// Precomputed tables of one transform size. A plan is immutable after creation apart from
+// its scratch buffer, so it can be shared by every user of the same size on one thread.
+//
+// Spectra use a split layout of size floats: the real parts of bins 0 .. size / 2 - 1
+// followed by their imaginary parts. Bins 0 and size / 2 are real, so the imaginary slot
+// of bin 0 holds the real part of bin size / 2.
+//
+// The size real samples are transformed as half_size complex values, in radix-4 passes
+// preceded by one radix-2 pass when half_size is an odd power of two.
+typedef struct {
+    uint32_t size;
+    uint32_t half_size;
+    uint32_t* bit_reverse;
+    // For each radix-4 pass over groups of 4 * quarter values: the real parts of
+    // exp(-2 pi i k j / (4 * quarter)) for k = 2, 1, 3 and j < quarter, then the imaginary
+    // parts, 6 * quarter floats per pass.
+    float* twiddles;
+    // Real parts of exp(-2 pi i k / size) for k < half_size, then the imaginary parts.
+    float* real_twiddles;
+    // Real parts of half_size complex values, then the imaginary parts.
+    float* work;
+} FloatFftPlan;
+
+static FloatFftPlan* float_fft_plan_create(uint32_t size);
+static void float_fft_plan_destroy(FloatFftPlan* plan);
+static void float_fft_forward(FloatFftPlan* plan, const float* input, float* spectrum);
+static void float_fft_inverse(FloatFftPlan* plan, const float* spectrum, float* output);
+
+static void float_fft_radix2_pass(float* re, float* im, uint32_t n);
+static void float_fft_radix4_pass(float* re, float* im, uint32_t n, uint32_t quarter, const float* twiddles, int inverse);
+static void float_fft_butterflies(const FloatFftPlan* plan, int inverse);
+
+#endif //FLOAT_FFT_H
@@ -0,0 +1,104 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Portable 128-bit vectors built on the GCC/Clang vector extensions. With -msimd128
+// clang lowers these to wasm SIMD instructions, without it they are scalarized, so
+// kernels written against this header are always correct and fast when SIMD is on.
+
+typedef float f32x4 __attribute__((__vector_size__(16), __aligned__(16)));
+typedef double f64x2 __attribute__((__vector_size__(16), __aligned__(16)));
+typedef int32_t i32x4 __attribute__((__vector_size__(16), __aligned__(16)));
+typedef int64_t i64x2 __attribute__((__vector_size__(16), __aligned__(16)));
+
+typedef struct {
+    f32x4 v;
+} __attribute__((__packed__, __may_alias__)) f32x4_unaligned;
+
+typedef struct {
+    f64x2 v;
+} __attribute__((__packed__, __may_alias__)) f64x2_unaligned;
+
+#if defined(__clang__)
+#define SIMD_SHUFFLE_F32X4(a, b, i0, i1, i2, i3) __builtin_shufflevector((a), (b), i0, i1, i2, i3)
+#define SIMD_SHUFFLE_F64X2(a, b, i0, i1) __builtin_shufflevector((a), (b), i0, i1)
+#else
+#define SIMD_SHUFFLE_F32X4(a, b, i0, i1, i2, i3) __builtin_shuffle((a), (b), (i32x4){ i0, i1, i2, i3 })
+#define SIMD_SHUFFLE_F64X2(a, b, i0, i1) __builtin_shuffle((a), (b), (i64x2){ i0, i1 })
+#endif
+
+static inline f32x4 f32x4_load(const float* ptr) {
+    return ((const f32x4_unaligned*)ptr)->v;
+}
+
+static inline void f32x4_store(float* ptr, f32x4 value) {
+    ((f32x4_unaligned*)ptr)->v = value;
+}
+
+static inline f32x4 f32x4_splat(float value) {
+    return (f32x4){ value, value, value, value };
+}
+
+// Lanes of a where mask is all ones, lanes of b elsewhere. Masks come from vector comparisons.
+static inline f32x4 f32x4_select(i32x4 mask, f32x4 a, f32x4 b) {
+    return (f32x4)((mask & (i32x4)a) | (~mask & (i32x4)b));
+}
+
+static inline f32x4 f32x4_min(f32x4 a, f32x4 b) {
+    return f32x4_select(a < b, a, b);
+}
+
+static inline f32x4 f32x4_max(f32x4 a, f32x4 b) {
+    return f32x4_select(a > b, a, b);
+}
+
+static inline f32x4 f32x4_abs(f32x4 a) {
+    return (f32x4)((i32x4)a & (i32x4){ 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF });
+}
+
+static inline float f32x4_horizontal_sum(f32x4 a) {
+    f32x4 pairs = a + SIMD_SHUFFLE_F32X4(a, a, 2, 3, 0, 1);
+    return pairs[0] + pairs[1];
+}
+
+static inline float f32x4_horizontal_max(f32x4 a) {
+    f32x4 pairs = f32x4_max(a, SIMD_SHUFFLE_F32X4(a, a, 2, 3, 0, 1));
+    return MAX(pairs[0], pairs[1]);
+}
+
+// Splits 4 interleaved stereo frames [l0 r0 l1 r1] [l2 r2 l3 r3] into [l0 l1 l2 l3] and [r0 r1 r2 r3].
+static inline void f32x4_deinterleave2(f32x4 a, f32x4 b, f32x4* even, f32x4* odd) {
+    *even = SIMD_SHUFFLE_F32X4(a, b, 0, 2, 4, 6);
+    *odd = SIMD_SHUFFLE_F32X4(a, b, 1, 3, 5, 7);
+}
+
+// Inverse of f32x4_deinterleave2.
+static inline void f32x4_interleave2(f32x4 even, f32x4 odd, f32x4* a, f32x4* b) {
+    *a = SIMD_SHUFFLE_F32X4(even, odd, 0, 4, 1, 5);
+    *b = SIMD_SHUFFLE_F32X4(even, odd, 2, 6, 3, 7);
+}
+
+static inline f64x2 f64x2_load(const double* ptr) {
+    return ((const f64x2_unaligned*)ptr)->v;
+}
+
+static inline void f64x2_store(double* ptr, f64x2 value) {
+    ((f64x2_unaligned*)ptr)->v = value;
+}
+
+static inline f64x2 f64x2_splat(double value) {
+    return (f64x2){ value, value };
+}
+
+static inline f64x2 f64x2_select(i64x2 mask, f64x2 a, f64x2 b) {
+    return (f64x2)((mask & (i64x2)a) | (~mask & (i64x2)b));
+}
+
+static inline f64x2 f64x2_max(f64x2 a, f64x2 b) {
+    return f64x2_select(a > b, a, b);
+}
+
+static inline f64x2 f64x2_abs(f64x2 a) {
+    return (f64x2)((i64x2)a & (i64x2){ 0x7FFFFFFFFFFFFFFFLL, 0x7FFFFFFFFFFFFFFFLL });
+}
+
+#endif //SIMD_H
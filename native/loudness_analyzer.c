@@ -14,15 +14,13 @@ EXPORT int loudness_analyzer_init(uint32_t channel_count,
     this->frames_added = 0;
     this->max_history = max_history;
 
-    ebur128_state* st = ebur128_init(channel_count, sample_rate, EBUR128_MODE_I | EBUR128_MODE_SAMPLE_PEAK);
+    ebur128_state* st = ebur128_init(channel_count,
+                                     sample_rate,
+                                     EBUR128_MODE_I | EBUR128_MODE_LRA | EBUR128_MODE_TRUE_PEAK |
+                                         EBUR128_MODE_HISTOGRAM | EBUR128_MODE_BLOCK_ENERGY);
     if (!st) {
         return EBUR128_ERROR_NOMEM;
     }
-    int err = ebur128_set_max_history(st, max_history);
-
-    if (err) {
-        return err;
-    }
     this->st = st;
     *retval = this;
     return EBUR128_SUCCESS;
@@ -44,6 +42,8 @@ EXPORT int loudness_analyzer_add_frames(LoudnessAnalyzer* this,
     return EBUR128_SUCCESS;
 }
 
+// The peak is the true peak, measured oversampled, of the frames added last so that gain
+// applied to them can be capped below inter-sample overs.
 EXPORT int loudness_analyzer_get_loudness_and_peak(LoudnessAnalyzer* this, double* loudness, double* peak) {
     *loudness = 0.0;
     uint32_t frames_needed = this->st->samplerate * 0.4;
@@ -56,7 +56,7 @@ EXPORT int loudness_analyzer_get_loudness_and_peak(LoudnessAnalyzer* this, doubl
         *loudness = result;
         double peak_value = -1.0;
         for (int ch = 0; ch < this->st->channels; ++ch) {
-            int err = ebur128_prev_sample_peak(this->st, ch, &result);
+            int err = ebur128_prev_true_peak(this->st, ch, &result);
             if (err) {
                 return err;
             }
@@ -81,16 +81,127 @@ EXPORT int loudness_analyzer_get_momentary_loudness(LoudnessAnalyzer* this, doub
     return EBUR128_SUCCESS;
 }
 
-EXPORT uint32_t loudness_analyzer_get_serialized_state_size(void) {
-    return sizeof(LoudnessAnalyzerSerializedState);
+// Integrated loudness, loudness range and the loudest 3s short-term block, at the 0.1 LU
+// resolution of the histograms. Short-term blocks start every second once 3s have been added.
+EXPORT int loudness_analyzer_get_loudness_statistics(LoudnessAnalyzer* this,
+                                                     double* loudness,
+                                                     double* range,
+                                                     double* max_short_term_loudness) {
+    int err = ebur128_loudness_global(this->st, loudness);
+    if (err) {
+        return err;
+    }
+    err = ebur128_loudness_range(this->st, range);
+    if (err) {
+        return err;
+    }
+    *max_short_term_loudness = -HUGE_VAL;
+    for (int i = SERIALIZED_HISTOGRAM_BINS - 1; i >= 0; --i) {
+        if (this->st->d->short_term_block_energy_histogram[i]) {
+            *max_short_term_loudness = ebur128_energy_to_loudness(histogram_energies[i]);
+            break;
+        }
+    }
+    return EBUR128_SUCCESS;
 }
 
-EXPORT int loudness_analyzer_export_state(LoudnessAnalyzer* this, LoudnessAnalyzerSerializedState* state) {
-    state->max_history = this->max_history;
-    state->sample_rate = this->st->samplerate;
-    state->channels = this->st->channels;
-    state->frames_added = this->frames_added;
+EXPORT uint32_t loudness_analyzer_get_serialized_state_max_size(void) {
+    return SERIALIZED_STATE_MAX_SIZE;
+}
+
+static int16_t serialize_loudness(double value) {
+    if (!isfinite(value)) {
+        return SERIALIZED_LOUDNESS_SILENT;
+    }
+    return (int16_t)MAX(SERIALIZED_LOUDNESS_SILENT + 1, MIN(32767.0, round(value * SERIALIZED_LOUDNESS_STEPS)));
+}
 
+static double deserialize_loudness(int16_t value) {
+    return value == SERIALIZED_LOUDNESS_SILENT ? -HUGE_VAL : (double)value / SERIALIZED_LOUDNESS_STEPS;
+}
+
+static uint32_t write_varint(uint8_t* out, uint32_t value) {
+    uint32_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+// Returns the bytes read, 0 if the varint doesn't end before end.
+static uint32_t read_varint(const uint8_t* in, const uint8_t* end, uint32_t* value) {
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < VARINT_MAX_BYTES && in + i < end; ++i) {
+        result |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            *value = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Writes the non-empty cells of histogram, returns the bytes written.
+static uint32_t write_histogram_cells(const unsigned long* histogram, uint8_t* out, uint16_t* cells) {
+    uint32_t length = 0;
+    uint32_t previous_cell = (uint32_t)-1;
+    *cells = 0;
+    for (uint32_t cell = 0; cell < SERIALIZED_HISTOGRAM_CELLS; ++cell) {
+        const unsigned long* bins = histogram + cell * SERIALIZED_HISTOGRAM_CELL_BINS;
+        uint64_t count = 0;
+        uint64_t weighted_bin = 0;
+        for (uint32_t i = 0; i < SERIALIZED_HISTOGRAM_CELL_BINS; ++i) {
+            count += bins[i];
+            weighted_bin += (uint64_t)bins[i] * i;
+        }
+        if (count == 0) {
+            continue;
+        }
+        const uint32_t bin = (uint32_t)((weighted_bin + count / 2) / count);
+        length += write_varint(out + length, cell - previous_cell);
+        length += write_varint(out + length, (uint32_t)(MIN(SERIALIZED_HISTOGRAM_MAX_COUNT, count) << 4) | bin);
+        previous_cell = cell;
+        (*cells)++;
+    }
+    return length;
+}
+
+// Restores cells written by write_histogram_cells into histogram, returns where they end or
+// NULL if they are malformed.
+static const uint8_t* read_histogram_cells(unsigned long* histogram,
+                                           const uint8_t* in,
+                                           const uint8_t* end,
+                                           uint32_t cells) {
+    memset(histogram, 0, sizeof(unsigned long) * SERIALIZED_HISTOGRAM_BINS);
+    uint32_t cell = (uint32_t)-1;
+    for (uint32_t i = 0; i < cells; ++i) {
+        uint32_t distance, value;
+        uint32_t length = read_varint(in, end, &distance);
+        if (!length) {
+            return NULL;
+        }
+        in += length;
+        length = read_varint(in, end, &value);
+        if (!length) {
+            return NULL;
+        }
+        in += length;
+        cell += distance;
+        const uint32_t bin = value & 0xF;
+        if (cell >= SERIALIZED_HISTOGRAM_CELLS || bin >= SERIALIZED_HISTOGRAM_CELL_BINS) {
+            return NULL;
+        }
+        histogram[cell * SERIALIZED_HISTOGRAM_CELL_BINS + bin] = value >> 4;
+    }
+    return in;
+}
+
+// out must have room for loudness_analyzer_get_serialized_state_max_size() bytes, the size
+// used is written to size.
+EXPORT int loudness_analyzer_export_state(LoudnessAnalyzer* this, uint8_t* out, uint32_t* size) {
+    *size = 0;
     double integrated_loudness = 0.0;
     int err = ebur128_loudness_global(this->st, &integrated_loudness);
     if (err) {
@@ -100,41 +211,149 @@ EXPORT int loudness_analyzer_export_state(LoudnessAnalyzer* this, LoudnessAnalyz
     double peak_value = -1.0;
     for (int ch = 0; ch < this->st->channels; ++ch) {
         double result;
-        int err = ebur128_sample_peak(this->st, ch, &result);
+        int err = ebur128_true_peak(this->st, ch, &result);
         if (err) {
             return err;
         }
         peak_value = MAX(peak_value, result);
     }
-    state->sample_peak = peak_value;
-    state->integrated_loudness = integrated_loudness;
-    state->history_length = MIN(MAX_SERIALIZED_HISTORY, this->st->d->block_list->length);
-    state->last_block_sum = this->st->d->last_block_sum;
-    memmove(&state->filter_state, &this->st->d->v, sizeof(this->st->d->v));
-    queue_export_values(this->st->d->block_list, state->history_state, state->history_length);
+
+    LoudnessAnalyzerSerializedState state;
+    memset(&state, 0, sizeof(state));
+    state.version = LOUDNESS_ANALYZER_STATE_VERSION;
+    state.channels = this->st->channels;
+    state.sample_rate = this->st->samplerate;
+    state.max_history = this->max_history;
+    state.frames_added = this->frames_added;
+    state.integrated_loudness = serialize_loudness(integrated_loudness);
+    state.true_peak = serialize_loudness(peak_value > 0.0 ? 20.0 * log10(peak_value) : -HUGE_VAL);
+
+    uint32_t length = sizeof(state);
+    length += write_histogram_cells(this->st->d->block_energy_histogram, out + length, &state.histogram_cells);
+    length += write_histogram_cells(this->st->d->short_term_block_energy_histogram,
+                                    out + length,
+                                    &state.short_term_histogram_cells);
+    memmove(out, &state, sizeof(state));
+    *size = length;
     return EBUR128_SUCCESS;
 }
 
-EXPORT int loudness_analyzer_init_from_serialized_state(LoudnessAnalyzer* this, LoudnessAnalyzerSerializedState* state) {
+// Restores a state exported with loudness_analyzer_export_state into an analyzer initialized
+// with its channel count and sample rate.
+EXPORT int loudness_analyzer_init_from_serialized_state(LoudnessAnalyzer* this,
+                                                        const uint8_t* state_bytes,
+                                                        uint32_t size) {
     const ebur128_state* st = this->st;
+    LoudnessAnalyzerSerializedState state;
+    if (size < sizeof(state)) {
+        return EBUR128_ERROR_INVALID_MODE;
+    }
+    memmove(&state, state_bytes, sizeof(state));
+    if (state.version != LOUDNESS_ANALYZER_STATE_VERSION || state.channels != st->channels ||
+        state.sample_rate != st->samplerate || state.histogram_cells > SERIALIZED_HISTOGRAM_CELLS ||
+        state.short_term_histogram_cells > SERIALIZED_HISTOGRAM_CELLS) {
+        return EBUR128_ERROR_INVALID_MODE;
+    }
+
+    const uint8_t* in = state_bytes + sizeof(state);
+    const uint8_t* end = state_bytes + size;
+    in = read_histogram_cells(st->d->block_energy_histogram, in, end, state.histogram_cells);
+    if (!in) {
+        return EBUR128_ERROR_INVALID_MODE;
+    }
+    in = read_histogram_cells(st->d->short_term_block_energy_histogram, in, end, state.short_term_histogram_cells);
+    if (!in) {
+        return EBUR128_ERROR_INVALID_MODE;
+    }
+
+    const double true_peak_db = deserialize_loudness(state.true_peak);
+    const double true_peak = isfinite(true_peak_db) ? pow(10.0, true_peak_db / 20.0) : 0.0;
     for (int i = 0; i < st->channels; ++i) {
-      st->d->sample_peak[i] = state->sample_peak;
-      st->d->prev_sample_peak[i] = state->sample_peak;
+      st->d->sample_peak[i] = true_peak;
+      st->d->prev_sample_peak[i] = true_peak;
+      st->d->true_peak[i] = true_peak;
+      st->d->prev_true_peak[i] = true_peak;
     }
 
-    this->frames_added = state->frames_added;
-    this->max_history = state->max_history;
-    memmove(&st->d->v, &state->filter_state, sizeof(st->d->v));
+    this->frames_added = state.frames_added;
+    this->max_history = state.max_history;
+    memset(&st->d->v, 0, sizeof(st->d->v));
     st->d->needed_frames = st->d->samples_in_100ms * 4;
     st->d->audio_data_index = 0;
     st->d->short_term_frame_counter = 0;
-    st->d->last_block_sum = state->last_block_sum;
+    st->d->last_block_sum = 0.0;
+    ebur128_reset_block_energies(this->st);
+    return EBUR128_SUCCESS;
+}
+
+static uint32_t export_sparse_histogram(const unsigned long* histogram, uint32_t* out) {
+    uint32_t length = 0;
+    for (uint32_t i = 0; i < SERIALIZED_HISTOGRAM_BINS; ++i) {
+        if (histogram[i]) {
+            out[length++] = (i << HISTOGRAM_COUNT_BITS) | MIN(HISTOGRAM_MAX_COUNT, histogram[i]);
+        }
+    }
+    return length;
+}
+
+static void add_sparse_histogram(unsigned long* histogram, const uint32_t* words, uint32_t length) {
+    for (uint32_t i = 0; i < length; ++i) {
+        const uint32_t index = words[i] >> HISTOGRAM_COUNT_BITS;
+        if (index < SERIALIZED_HISTOGRAM_BINS) {
+            histogram[index] += words[i] & HISTOGRAM_MAX_COUNT;
+        }
+    }
+}
+
+EXPORT uint32_t loudness_analyzer_get_histograms_max_size(void) {
+    return HISTOGRAMS_MAX_WORDS * sizeof(uint32_t);
+}
 
-    if (queue_copy_values(st->d->block_list, state->history_state, state->history_length)) {
+// Returns the size in bytes written to out.
+EXPORT uint32_t loudness_analyzer_export_histograms(LoudnessAnalyzer* this, uint32_t* out) {
+    const uint32_t block_bins = export_sparse_histogram(this->st->d->block_energy_histogram, out + 1);
+    const uint32_t short_term_bins =
+        export_sparse_histogram(this->st->d->short_term_block_energy_histogram, out + 1 + block_bins);
+    out[0] = block_bins | (short_term_bins << 16);
+    return (1 + block_bins + short_term_bins) * sizeof(uint32_t);
+}
+
+// Integrated loudness and loudness range of the tracks whose exported histograms are
+// concatenated in histograms, as if they were played back to back.
+EXPORT int loudness_analyzer_merge_histograms(const uint32_t* histograms,
+                                              uint32_t size,
+                                              double* loudness,
+                                              double* range) {
+    *loudness = -HUGE_VAL;
+    *range = 0.0;
+    ebur128_state* st =
+        ebur128_init(1, HISTOGRAM_MERGE_SAMPLE_RATE, EBUR128_MODE_I | EBUR128_MODE_LRA | EBUR128_MODE_HISTOGRAM);
+    if (!st) {
         return EBUR128_ERROR_NOMEM;
     }
 
-    return EBUR128_SUCCESS;
+    const uint32_t length = size / sizeof(uint32_t);
+    uint32_t offset = 0;
+    while (offset < length) {
+        const uint32_t block_bins = histograms[offset] & 0xFFFF;
+        const uint32_t short_term_bins = histograms[offset] >> 16;
+        offset++;
+        if (offset + block_bins + short_term_bins > length) {
+            ebur128_destroy(&st);
+            return EBUR128_ERROR_INVALID_MODE;
+        }
+        add_sparse_histogram(st->d->block_energy_histogram, histograms + offset, block_bins);
+        offset += block_bins;
+        add_sparse_histogram(st->d->short_term_block_energy_histogram, histograms + offset, short_term_bins);
+        offset += short_term_bins;
+    }
+
+    int err = ebur128_loudness_global_multiple(&st, 1, loudness);
+    if (!err) {
+        err = ebur128_loudness_range_multiple(&st, 1, range);
+    }
+    ebur128_destroy(&st);
+    return err;
 }
 
 EXPORT void loudness_analyzer_apply_gain(LoudnessAnalyzer* this,
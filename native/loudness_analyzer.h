@@ -3,7 +3,17 @@
 
 #include <libebur128/ebur128.c>
 
-#define MAX_SERIALIZED_HISTORY 300
+// Bins of the libebur128 block energy histogram, 0.1 LU each from -70 LUFS.
+#define SERIALIZED_HISTOGRAM_BINS 1000
+// Histograms are exported sparsely for storage: a header word with the count of non-empty
+// bins of the gating block histogram in the low and of the short-term block histogram in the
+// high 16 bits, then a word for each non-empty bin with the bin index in the high 10 bits and
+// its count, saturated, in the low 22 bits. Exports can be concatenated for merging.
+#define HISTOGRAM_COUNT_BITS 22
+#define HISTOGRAM_MAX_COUNT ((1u << HISTOGRAM_COUNT_BITS) - 1)
+#define HISTOGRAMS_MAX_WORDS (1 + 2 * SERIALIZED_HISTOGRAM_BINS)
+// Merged histograms are gated in a scratch state, they don't depend on its sample rate.
+#define HISTOGRAM_MERGE_SAMPLE_RATE 100
 
 typedef struct {
     uint32_t frames_added;
@@ -11,18 +21,34 @@ typedef struct {
     ebur128_state* st;
 } LoudnessAnalyzer;
 
+// Serialized state, LOUDNESS_ANALYZER_STATE_VERSION. The header is followed by the non-empty
+// cells of the gating block histogram and then of the short-term block histogram, 1 LU each.
+// A cell is a varint of its distance from the previous cell of its histogram (from -1 for the
+// first) and a varint of its count shifted left by 4 bits over the bin within the cell, at
+// 0.1 LU, that the count is restored into.
+#define LOUDNESS_ANALYZER_STATE_VERSION 2
+#define SERIALIZED_HISTOGRAM_CELL_BINS 10
+#define SERIALIZED_HISTOGRAM_CELLS (SERIALIZED_HISTOGRAM_BINS / SERIALIZED_HISTOGRAM_CELL_BINS)
+#define SERIALIZED_HISTOGRAM_MAX_COUNT ((1u << 28) - 1)
+#define VARINT_MAX_BYTES 5
+#define SERIALIZED_STATE_MAX_SIZE \
+    (sizeof(LoudnessAnalyzerSerializedState) + 2 * SERIALIZED_HISTOGRAM_CELLS * 2 * VARINT_MAX_BYTES)
+// Loudness values are stored in 0.01 dB steps, silence as SERIALIZED_LOUDNESS_SILENT.
+#define SERIALIZED_LOUDNESS_STEPS 100.0
+#define SERIALIZED_LOUDNESS_SILENT (-32768)
+
 typedef struct {
-    uint32_t max_history;
+    uint8_t version;
+    uint8_t channels;
+    uint16_t histogram_cells;
     uint32_t sample_rate;
-    uint32_t channels;
+    uint32_t max_history;
     uint32_t frames_added;
-    uint32_t history_length;
-    double sample_peak;
-    double integrated_loudness;
-    double last_block_sum;
-    double filter_state[5][5];
-    uint8_t reserved[128];
-    double history_state[MAX_SERIALIZED_HISTORY];
+    int16_t integrated_loudness;
+    // dBTP.
+    int16_t true_peak;
+    uint16_t short_term_histogram_cells;
+    uint16_t reserved;
 } LoudnessAnalyzerSerializedState;
 
 EXPORT int loudness_analyzer_init(uint32_t channel_count,
@@ -35,13 +61,25 @@ EXPORT int loudness_analyzer_add_frames(LoudnessAnalyzer* this,
                                         uint32_t frame_count);
 EXPORT int loudness_analyzer_get_loudness_and_peak(LoudnessAnalyzer* this, double* gain, double* peak);
 EXPORT int loudness_analyzer_get_momentary_loudness(LoudnessAnalyzer* this, double* gain);
-EXPORT int loudness_analyzer_init_from_serialized_state(LoudnessAnalyzer* this, LoudnessAnalyzerSerializedState* state);
+EXPORT int loudness_analyzer_get_loudness_statistics(LoudnessAnalyzer* this,
+                                                     double* loudness,
+                                                     double* range,
+                                                     double* max_short_term_loudness);
+EXPORT int loudness_analyzer_init_from_serialized_state(LoudnessAnalyzer* this,
+                                                        const uint8_t* state,
+                                                        uint32_t size);
 EXPORT void loudness_analyzer_apply_gain(LoudnessAnalyzer* this,
                                                    double gain_to_apply,
                                                    double previously_applied_gain,
                                                    float* frames,
                                                    uint32_t frame_count);
-EXPORT int loudness_analyzer_export_state(LoudnessAnalyzer* this, LoudnessAnalyzerSerializedState* state);
+EXPORT int loudness_analyzer_export_state(LoudnessAnalyzer* this, uint8_t* out, uint32_t* size);
 EXPORT int loudness_analyzer_import_state(LoudnessAnalyzer* this, LoudnessAnalyzerSerializedState* state);
-EXPORT uint32_t loudness_analyzer_get_serialized_state_size(void);
+EXPORT uint32_t loudness_analyzer_get_serialized_state_max_size(void);
+EXPORT uint32_t loudness_analyzer_get_histograms_max_size(void);
+EXPORT uint32_t loudness_analyzer_export_histograms(LoudnessAnalyzer* this, uint32_t* out);
+EXPORT int loudness_analyzer_merge_histograms(const uint32_t* histograms,
+                                              uint32_t size,
+                                              double* loudness,
+                                              double* range);
 #endif //LOUDNESS_ANALYZER_H
@@ -0,0 +1,161 @@
+#include "loudness_scanner.h"
+
+static void loudness_scanner_reset_silence_block(LoudnessScanner* scanner) {
+    scanner->block_frames = 0;
+    scanner->block_first_audible_frame = LOUDNESS_SCANNER_NO_FRAME;
+    scanner->block_last_audible_frame = 0;
+    scanner->block_sum_squares = 0.0;
+    scanner->block_peak = 0.0f;
+}
+
+static void loudness_scanner_end_silence_block(LoudnessScanner* scanner) {
+    if (scanner->block_first_audible_frame != LOUDNESS_SCANNER_NO_FRAME) {
+        const double mean_square = scanner->block_sum_squares / (scanner->block_frames * scanner->channel_count);
+        if (mean_square >= LOUDNESS_SCANNER_SILENCE_RMS * LOUDNESS_SCANNER_SILENCE_RMS ||
+            scanner->block_peak >= LOUDNESS_SCANNER_SILENCE_PEAK) {
+            if (scanner->audio_start == LOUDNESS_SCANNER_NO_FRAME) {
+                scanner->audio_start = scanner->block_first_audible_frame;
+            }
+            scanner->audio_end = scanner->block_last_audible_frame + 1;
+        }
+    }
+    loudness_scanner_reset_silence_block(scanner);
+}
+
+static void loudness_scanner_detect_silence(LoudnessScanner* scanner, const float* samples, uint32_t frame_count) {
+    const uint32_t channel_count = scanner->channel_count;
+    for (uint32_t i = 0; i < frame_count; ++i) {
+        float frame_peak = 0.0f;
+        for (uint32_t ch = 0; ch < channel_count; ++ch) {
+            const float sample = samples[i * channel_count + ch];
+            scanner->block_sum_squares += sample * sample;
+            frame_peak = MAX(frame_peak, fabsf(sample));
+        }
+        if (frame_peak >= (float)LOUDNESS_SCANNER_SILENCE_RMS) {
+            if (scanner->block_first_audible_frame == LOUDNESS_SCANNER_NO_FRAME) {
+                scanner->block_first_audible_frame = scanner->frames_scanned;
+            }
+            scanner->block_last_audible_frame = scanner->frames_scanned;
+        }
+        scanner->block_peak = MAX(scanner->block_peak, frame_peak);
+        scanner->frames_scanned++;
+        if (++scanner->block_frames == scanner->silence_block_frames) {
+            loudness_scanner_end_silence_block(scanner);
+        }
+    }
+}
+
+EXPORT LoudnessScanner* loudness_scanner_create(uint32_t encoder_delay,
+                                                uint32_t padding_frames,
+                                                int32_t padding_start_frame,
+                                                uint32_t total_mp3_frames) {
+    LoudnessScanner* scanner = malloc(sizeof(LoudnessScanner));
+    if (!scanner) {
+        return NULL;
+    }
+    scanner->mp3 = mp3_create_ctx();
+    if (!scanner->mp3) {
+        free(scanner);
+        return NULL;
+    }
+    scanner->frames_to_skip = encoder_delay + LOUDNESS_SCANNER_DECODER_DELAY;
+    scanner->padding_start_frame = padding_start_frame;
+    scanner->padding_frames = padding_frames;
+    scanner->total_mp3_frames = total_mp3_frames;
+    scanner->mp3_frame = 0;
+    scanner->invalid_frame_count = 0;
+    scanner->channel_count = 0;
+    scanner->silence_block_frames = 0;
+    scanner->frames_scanned = 0;
+    scanner->audio_start = LOUDNESS_SCANNER_NO_FRAME;
+    scanner->audio_end = 0;
+    loudness_scanner_reset_silence_block(scanner);
+    return scanner;
+}
+
+EXPORT void loudness_scanner_destroy(LoudnessScanner* scanner) {
+    mp3_destroy_ctx(scanner->mp3);
+    free(scanner);
+}
+
+// Returns the audio frames of the decoded mp3 frame that belong to the track, the rest
+// is encoder delay or padding. *first is set to the first frame that belongs to it.
+static uint32_t loudness_scanner_trim(LoudnessScanner* scanner, uint32_t frame_count, uint32_t* first) {
+    const int32_t padding_start_frame = scanner->padding_start_frame;
+    *first = 0;
+    if (padding_start_frame != -1 && (int32_t)scanner->mp3_frame >= padding_start_frame) {
+        if ((int32_t)scanner->mp3_frame > padding_start_frame) {
+            return 0;
+        }
+        frame_count -= MIN(frame_count, scanner->padding_frames);
+    }
+    const uint32_t skipped = MIN(frame_count, scanner->frames_to_skip);
+    scanner->frames_to_skip -= skipped;
+    *first = skipped;
+    return frame_count - skipped;
+}
+
+// Decodes as many frames of src as possible and adds them to analyzer, which must have
+// been initialized for the sample rate and channel count of the track. Returns the number
+// of bytes consumed, the rest has to be passed again with more data following it, a
+// negative LOUDNESS_SCANNER_ERROR_* or a negated ebur128 error.
+EXPORT int32_t loudness_scanner_analyze_mp3(LoudnessScanner* scanner,
+                                            const uint8_t* src,
+                                            uint32_t src_length,
+                                            LoudnessAnalyzer* analyzer) {
+    if (scanner->silence_block_frames == 0) {
+        scanner->silence_block_frames = analyzer->st->samplerate * LOUDNESS_SCANNER_SILENCE_BLOCK_MS / 1000;
+    }
+    uint32_t offset = 0;
+    while (offset < src_length && scanner->mp3_frame < scanner->total_mp3_frames) {
+        uint32_t bytes_written = 0;
+        const int bytes_read =
+            mp3_decode_frame(scanner->mp3, src + offset, src_length - offset, scanner->samples, &bytes_written);
+        if (bytes_read > 0) {
+            offset += bytes_read;
+        }
+
+        if (bytes_written > 0) {
+            const uint32_t channel_count = scanner->mp3->nb_channels;
+            if (channel_count != analyzer->st->channels) {
+                return LOUDNESS_SCANNER_ERROR_CHANNEL_COUNT;
+            }
+            scanner->channel_count = channel_count;
+            scanner->mp3_frame++;
+            scanner->invalid_frame_count = 0;
+            uint32_t first;
+            const uint32_t frame_count =
+                loudness_scanner_trim(scanner, bytes_written / (sizeof(float) * channel_count), &first);
+            if (frame_count > 0) {
+                float* samples = scanner->samples + first * channel_count;
+                loudness_scanner_detect_silence(scanner, samples, frame_count);
+                int err = loudness_analyzer_add_frames(analyzer, samples, frame_count);
+                if (err) {
+                    return -err;
+                }
+            }
+        } else if (src_length - offset > MP3_MAX_BYTES_FRAME_SIZE) {
+            if (++scanner->invalid_frame_count >= LOUDNESS_SCANNER_MAX_INVALID_FRAMES) {
+                return LOUDNESS_SCANNER_ERROR_INVALID_FRAMES;
+            }
+            offset += MIN(src_length - offset, LOUDNESS_SCANNER_RESYNC_BYTES);
+        } else {
+            break;
+        }
+    }
+    return (int32_t)offset;
+}
+
+// The track is audible from frame audio_start until before audio_end. Both are 0 when the
+// whole track is silent.
+EXPORT int loudness_scanner_get_audio_bounds(LoudnessScanner* scanner, uint32_t* audio_start, uint32_t* audio_end) {
+    loudness_scanner_end_silence_block(scanner);
+    if (scanner->audio_start == LOUDNESS_SCANNER_NO_FRAME) {
+        *audio_start = 0;
+        *audio_end = 0;
+    } else {
+        *audio_start = scanner->audio_start;
+        *audio_end = scanner->audio_end;
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef LOUDNESS_SCANNER_H
+#define LOUDNESS_SCANNER_H
+
+#include "mp3_decoder.h"
+#include "loudness_analyzer.h"
+
+// Decodes an mp3 track and feeds it to a loudness analyzer in the same call, for scanning
+// the loudness of a library without handing every decoded buffer to JS. Encoder delay and
+// padding are skipped as in the playback decoder.
+#define LOUDNESS_SCANNER_DECODER_DELAY 529
+#define LOUDNESS_SCANNER_MAX_INVALID_FRAMES 100
+// Bytes skipped after a position where no frame could be decoded.
+#define LOUDNESS_SCANNER_RESYNC_BYTES 419
+// Below the negated ebur128 errors that are also returned.
+#define LOUDNESS_SCANNER_ERROR_INVALID_FRAMES -100
+#define LOUDNESS_SCANNER_ERROR_CHANNEL_COUNT -101
+
+// Silence at the start and end of the track is found in blocks: a block is audible when its
+// RMS reaches -60 dBFS or its peak reaches -40 dBFS. The bounds are then refined to the first
+// and last frame of the audible blocks that reaches -60 dBFS.
+#define LOUDNESS_SCANNER_SILENCE_BLOCK_MS 10
+#define LOUDNESS_SCANNER_SILENCE_RMS 0.001
+#define LOUDNESS_SCANNER_SILENCE_PEAK 0.01f
+#define LOUDNESS_SCANNER_NO_FRAME 0xFFFFFFFF
+
+typedef struct {
+    mp3_context_t* mp3;
+    uint32_t frames_to_skip;
+    int32_t padding_start_frame;
+    // Padding audio frames at the end of the mp3 frame padding_start_frame, the frames after it
+    // are all padding.
+    uint32_t padding_frames;
+    uint32_t total_mp3_frames;
+    uint32_t mp3_frame;
+    uint32_t invalid_frame_count;
+    float samples[MP3_MAX_SAMPLES_PER_FRAME];
+
+    // Silence detection, frame positions are counted from the start of the trimmed track.
+    uint32_t channel_count;
+    uint32_t silence_block_frames;
+    uint32_t frames_scanned;
+    uint32_t block_frames;
+    uint32_t block_first_audible_frame;
+    uint32_t block_last_audible_frame;
+    double block_sum_squares;
+    float block_peak;
+    uint32_t audio_start;
+    uint32_t audio_end;
+} LoudnessScanner;
+
+EXPORT LoudnessScanner* loudness_scanner_create(uint32_t encoder_delay,
+                                                uint32_t padding_frames,
+                                                int32_t padding_start_frame,
+                                                uint32_t total_mp3_frames);
+EXPORT void loudness_scanner_destroy(LoudnessScanner* scanner);
+EXPORT int32_t loudness_scanner_analyze_mp3(LoudnessScanner* scanner,
+                                            const uint8_t* src,
+                                            uint32_t src_length,
+                                            LoudnessAnalyzer* analyzer);
+EXPORT int loudness_scanner_get_audio_bounds(LoudnessScanner* scanner, uint32_t* audio_start, uint32_t* audio_end);
+
+#endif //LOUDNESS_SCANNER_H
@@ -4,12 +4,15 @@
 #undef ENABLE_SINC_BEST_CONVERTER
 #undef ENABLE_SINC_FAST_CONVERTER
 #undef ENABLE_SINC_MEDIUM_CONVERTER
+// For the impulse responses of the convolver in effects.c.
+#define ENABLE_LINEAR_CONVERTER 1
 
 #include "wasm.h"
 
 #define PACKAGE "ok"
 #define VERSION "1.0"
 #include <libsamplerate/src_zoh.c>
+#include <libsamplerate/src_linear.c>
 #include <libsamplerate/samplerate.c>
 #undef PACKAGE
 #undef VERSION
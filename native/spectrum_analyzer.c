@@ -0,0 +1,234 @@
+#include "spectrum_analyzer.h"
+
+// Frequency followed by the weight used from that frequency on. Above the last frequency
+// log power is used as is.
+static const float SPECTRUM_ANALYZER_WEIGHTS[] = {
+    0,     0,
+    10,    0.0003019951720402013,
+    12.5,  0.0006760829753919819,
+    16,    0.0014621771744567184,
+    20,    0.0029853826189179603,
+    25,    0.10351421666793437,
+    31.5,  0.19054607179632474,
+    40,    0.481131121482591,
+    50,    0.5095408738576246,
+    63,    0.515408738576246,
+    80,    0.525408738576246,
+    100,   0.5395408738576246,
+    125,   0.5595408738576246,
+    160,   0.4195408738576246,
+    200,   0.4395408738576246,
+    250,   0.4495408738576246,
+    315,   0.4595408738576246,
+    400,   0.4754399373371569,
+    500,   0.5918309709189364,
+    630,   0.6035261221856173,
+    800,   0.6220108393559098,
+    1000,  0.690108393559098,
+    1250,  0.680108393559098,
+    1600,  0.67108393559098,
+    2000,  0.660108393559098,
+    2500,  0.650108393559098,
+    3150,  0.64108393559098,
+    4000,  0.630108393559098,
+    5000,  0.620108393559098,
+    6300,  0.930108393559098,
+    8000,  1.05108393559098,
+    10000, 1.08498942093324559,
+    12500, 1.126095368972401691,
+    16000, 1.3946773514128719823,
+    20000, 0.34276778654645035,
+};
+
+static float spectrum_analyzer_weight_for(uint32_t frequency) {
+    const uint32_t length = sizeof(SPECTRUM_ANALYZER_WEIGHTS) / sizeof(SPECTRUM_ANALYZER_WEIGHTS[0]);
+    for (uint32_t i = 2; i < length; i += 2) {
+        if ((float)frequency < SPECTRUM_ANALYZER_WEIGHTS[i]) {
+            return SPECTRUM_ANALYZER_WEIGHTS[i - 1];
+        }
+    }
+    return 1.0f;
+}
+
+EXPORT SpectrumAnalyzer* spectrum_analyzer_create(uint32_t frame_count,
+                                                  uint32_t sample_rate,
+                                                  double max_frequency,
+                                                  double base_smoothing_constant) {
+    if (sample_rate == 0) {
+        return NULL;
+    }
+    SpectrumAnalyzer* analyzer = malloc(sizeof(SpectrumAnalyzer));
+    if (!analyzer) {
+        return NULL;
+    }
+    memset(analyzer, 0, sizeof(SpectrumAnalyzer));
+    analyzer->plan = float_fft_plan_create(frame_count);
+    if (!analyzer->plan) {
+        free(analyzer);
+        return NULL;
+    }
+
+    const uint32_t half_size = frame_count / 2;
+    float* buffers = malloc(sizeof(float) * (frame_count * 3 + half_size * 2));
+    if (!buffers) {
+        float_fft_plan_destroy(analyzer->plan);
+        free(analyzer);
+        return NULL;
+    }
+    analyzer->frame_count = frame_count;
+    analyzer->sample_rate = sample_rate;
+    analyzer->window = buffers;
+    analyzer->samples = analyzer->window + frame_count;
+    analyzer->spectrum = analyzer->samples + frame_count;
+    analyzer->power = analyzer->spectrum + frame_count;
+    analyzer->bin_weights = analyzer->power + half_size;
+
+    const double bin_hz = (double)sample_rate / (double)frame_count;
+    analyzer->max_bin = MIN(half_size - 1, (uint32_t)ceil(max_frequency / bin_hz));
+    analyzer->smoothing = pow(base_smoothing_constant, (double)frame_count / (double)sample_rate);
+
+    // Hamming window.
+    const double scale = 2.0 * M_PI / (double)(frame_count - 1);
+    for (uint32_t n = 0; n < frame_count; ++n) {
+        analyzer->window[n] = 0.53836 - 0.46164 * cos((double)n * scale);
+    }
+    for (uint32_t k = 0; k < half_size; ++k) {
+        analyzer->bin_weights[k] = spectrum_analyzer_weight_for((uint32_t)((double)k * bin_hz));
+    }
+    return analyzer;
+}
+
+EXPORT void spectrum_analyzer_destroy(SpectrumAnalyzer* analyzer) {
+    float_fft_plan_destroy(analyzer->plan);
+    free(analyzer->window);
+    free(analyzer->band_ends);
+    free(analyzer);
+}
+
+// Bands widen quadratically towards max_bin but are always at least one bin wide.
+EXPORT int spectrum_analyzer_set_band_count(SpectrumAnalyzer* analyzer, uint32_t band_count) {
+    if (band_count == 0 || band_count > SPECTRUM_ANALYZER_MAX_BANDS) {
+        return -1;
+    }
+    if (band_count != analyzer->band_count) {
+        uint32_t* band_ends = realloc(analyzer->band_ends, (sizeof(uint32_t) + sizeof(float)) * band_count);
+        if (!band_ends) {
+            return -1;
+        }
+        analyzer->band_ends = band_ends;
+        analyzer->bands = (float*)(band_ends + band_count);
+        memset(analyzer->bands, 0, sizeof(float) * band_count);
+        analyzer->band_count = band_count;
+    }
+
+    const uint32_t max_bin = analyzer->max_bin;
+    uint32_t previous_end = 0;
+    for (uint32_t i = 0; i < band_count; ++i) {
+        const double position = (double)(i + 1) / (double)band_count;
+        uint32_t end = (uint32_t)(position * position * (double)max_bin);
+        if (end <= previous_end) {
+            end = previous_end + 1;
+        }
+        previous_end = end;
+        analyzer->band_ends[i] = MIN(max_bin, end) + 1;
+    }
+    return 0;
+}
+
+EXPORT float* spectrum_analyzer_reset(SpectrumAnalyzer* analyzer) {
+    if (analyzer->bands) {
+        memset(analyzer->bands, 0, sizeof(float) * analyzer->band_count);
+    }
+    return analyzer->bands;
+}
+
+// Analyzes frame_count interleaved frames.
+EXPORT float* spectrum_analyzer_analyze(SpectrumAnalyzer* analyzer, const float* samples, uint32_t channel_count) {
+    if (!analyzer->bands || channel_count == 0 || channel_count > SPECTRUM_ANALYZER_MAX_CHANNELS) {
+        return NULL;
+    }
+    const uint32_t frame_count = analyzer->frame_count;
+    const float* window = analyzer->window;
+    float* mono = analyzer->samples;
+
+    if (channel_count == 2) {
+        const f32x4 half = f32x4_splat(0.5f);
+        for (uint32_t i = 0; i < frame_count; i += 4) {
+            f32x4 left, right;
+            f32x4_deinterleave2(f32x4_load(samples + i * 2), f32x4_load(samples + i * 2 + 4), &left, &right);
+            f32x4_store(mono + i, (left + right) * half * f32x4_load(window + i));
+        }
+    } else {
+        const float scale = 1.0f / (float)channel_count;
+        for (uint32_t i = 0; i < frame_count; ++i) {
+            float sum = 0.0f;
+            for (uint32_t ch = 0; ch < channel_count; ++ch) {
+                sum += samples[i * channel_count + ch];
+            }
+            mono[i] = sum * scale * window[i];
+        }
+    }
+    return spectrum_analyzer_update_bands(analyzer);
+}
+
+// Analyzes frame_count frames of planar input, planes are plane_stride floats apart.
+EXPORT float* spectrum_analyzer_analyze_planar(SpectrumAnalyzer* analyzer,
+                                               const float* planes,
+                                               uint32_t plane_stride,
+                                               uint32_t channel_count) {
+    if (!analyzer->bands || channel_count == 0 || channel_count > SPECTRUM_ANALYZER_MAX_CHANNELS) {
+        return NULL;
+    }
+    const uint32_t frame_count = analyzer->frame_count;
+    const float* window = analyzer->window;
+    float* mono = analyzer->samples;
+    const f32x4 scale = f32x4_splat(1.0f / (float)channel_count);
+
+    for (uint32_t i = 0; i < frame_count; i += 4) {
+        f32x4 sum = f32x4_load(planes + i);
+        for (uint32_t ch = 1; ch < channel_count; ++ch) {
+            sum += f32x4_load(planes + ch * plane_stride + i);
+        }
+        f32x4_store(mono + i, sum * scale * f32x4_load(window + i));
+    }
+    return spectrum_analyzer_update_bands(analyzer);
+}
+
+static float* spectrum_analyzer_update_bands(SpectrumAnalyzer* analyzer) {
+    const uint32_t half_size = analyzer->frame_count / 2;
+    const uint32_t max_bin = analyzer->max_bin;
+    const float* re = analyzer->spectrum;
+    const float* im = analyzer->spectrum + half_size;
+    float* power = analyzer->power;
+
+    float_fft_forward(analyzer->plan, analyzer->samples, analyzer->spectrum);
+    // Bin 0 is never used, its imaginary slot holds the Nyquist bin.
+    for (uint32_t k = 0; k <= max_bin; k += 4) {
+        const f32x4 r = f32x4_load(re + k);
+        const f32x4 i = f32x4_load(im + k);
+        f32x4_store(power + k, r * r + i * i);
+    }
+
+    const float smoothing = analyzer->smoothing;
+    const float inverse_smoothing = 1.0f - smoothing;
+    float* bands = analyzer->bands;
+    uint32_t start = 1;
+    for (uint32_t i = 0; i < analyzer->band_count; ++i) {
+        const uint32_t first = MIN(start, max_bin);
+        const uint32_t end = MAX(first + 1, analyzer->band_ends[i]);
+        float max_power = 0.0f;
+        uint32_t max_power_bin = 0;
+        for (uint32_t k = first; k < end; ++k) {
+            if (power[k] > max_power) {
+                max_power = power[k];
+                max_power_bin = k;
+            }
+        }
+
+        float value = max_power > 1.0f ? logf(max_power) * analyzer->bin_weights[max_power_bin] : 0.0f;
+        value = bands[i] * smoothing + inverse_smoothing * value * SPECTRUM_ANALYZER_BAND_SCALE;
+        bands[i] = MIN(SPECTRUM_ANALYZER_MAX_BAND_VALUE, value);
+        start = analyzer->band_ends[i];
+    }
+    return bands;
+}
@@ -0,0 +1,53 @@
+#ifndef SPECTRUM_ANALYZER_H
+#define SPECTRUM_ANALYZER_H
+
+#include <simd.h>
+#include <math.h>
+#include <fft/float_fft.c>
+
+// Turns a block of audio into the bar heights of the visualizer: the block is downmixed and
+// windowed, transformed, and the spectrum is reduced to bands that are spaced quadratically
+// in frequency. Each band takes the loudest bin in it, on a weighted log scale, and is
+// smoothed over time.
+#define SPECTRUM_ANALYZER_MAX_CHANNELS 8
+#define SPECTRUM_ANALYZER_MAX_BANDS 1024
+#define SPECTRUM_ANALYZER_MAX_BAND_VALUE 0.97f
+#define SPECTRUM_ANALYZER_BAND_SCALE 0.24f
+
+typedef struct {
+    uint32_t frame_count;
+    uint32_t sample_rate;
+    // Highest bin that goes into a band.
+    uint32_t max_bin;
+    float smoothing;
+    uint32_t band_count;
+
+    FloatFftPlan* plan;
+    float* window;
+    float* samples;
+    float* spectrum;
+    float* power;
+    // Weight of the log power of each bin, by its frequency.
+    float* bin_weights;
+    // Band i covers bins band_ends[i - 1] .. band_ends[i] - 1, the first band starts from bin 1.
+    // The band values follow band_ends in the same allocation.
+    uint32_t* band_ends;
+    float* bands;
+} SpectrumAnalyzer;
+
+EXPORT SpectrumAnalyzer* spectrum_analyzer_create(uint32_t frame_count,
+                                                  uint32_t sample_rate,
+                                                  double max_frequency,
+                                                  double base_smoothing_constant);
+EXPORT void spectrum_analyzer_destroy(SpectrumAnalyzer* analyzer);
+EXPORT int spectrum_analyzer_set_band_count(SpectrumAnalyzer* analyzer, uint32_t band_count);
+EXPORT float* spectrum_analyzer_reset(SpectrumAnalyzer* analyzer);
+EXPORT float* spectrum_analyzer_analyze(SpectrumAnalyzer* analyzer, const float* samples, uint32_t channel_count);
+EXPORT float* spectrum_analyzer_analyze_planar(SpectrumAnalyzer* analyzer,
+                                               const float* planes,
+                                               uint32_t plane_stride,
+                                               uint32_t channel_count);
+
+static float* spectrum_analyzer_update_bands(SpectrumAnalyzer* analyzer);
+
+#endif //SPECTRUM_ANALYZER_H
@@ -39,12 +39,13 @@ static void chromaprint_initialize() {
 
 EXPORT Chromaprint* chromaprint_create() {
     chromaprint_initialize();
-    if (instance_in_use) {
-        return NULL;
-    }
-    instance_in_use = 1;
     Chromaprint* this = malloc(sizeof(Chromaprint));
     if (!this) return NULL;
+    this->fft_plan = float_fft_plan_create(CP_FRAMES);
+    if (!this->fft_plan) {
+        free(this);
+        return NULL;
+    }
     this->frames_processed = 0;
     this->coeff = 1;
     this->note_buffer_index = 0;
@@ -55,7 +56,7 @@ EXPORT Chromaprint* chromaprint_create() {
 }
 
 EXPORT void chromaprint_destroy(Chromaprint* this) {
-    instance_in_use = 0;
+    float_fft_plan_destroy(this->fft_plan);
     free(this);
 }
 
@@ -70,13 +71,13 @@ EXPORT ChromaprintError chromaprint_add_samples(Chromaprint* this, float* src, u
     if (this->tmp_length > 0) {
         int32_t tmp_offset = 0;
         assert(this->tmp_length < CP_FRAMES);
-        memmove((void*)(&TMP2[this->tmp_length]), (void*)src, 2 * CP_OVERLAP * sizeof(float));
+        memmove((void*)(&this->tmp2[this->tmp_length]), (void*)src, 2 * CP_OVERLAP * sizeof(float));
 
         while (this->tmp_length > 0) {
             if (this->frames_processed + CP_FRAMES - 1 >= CP_FRAMES_NEEDED_TOTAL) {
                 return CHROMAPRINT_SUCCESS;
             }
-            chromaprint_process_frames(this, &TMP2[tmp_offset]);
+            chromaprint_process_frames(this, &this->tmp2[tmp_offset]);
             this->tmp_length -= CP_OVERLAP;
             tmp_offset += CP_OVERLAP;
             assert_lt(tmp_offset, CP_FRAMES + CP_OVERLAP);
@@ -98,7 +99,7 @@ EXPORT ChromaprintError chromaprint_add_samples(Chromaprint* this, float* src, u
             len -= CP_OVERLAP;
             src_offset += CP_OVERLAP;
         } else {
-            memmove((void*)TMP2, (void*)&src[src_offset], len * sizeof(float));
+            memmove((void*)this->tmp2, (void*)&src[src_offset], len * sizeof(float));
             this->tmp_length = len;
             len = 0;
         }
@@ -120,13 +121,13 @@ EXPORT ChromaprintError chromaprint_calculate_fingerprint(Chromaprint* this, cha
     if (err) return err;
     err = chromaprint_compressed(this);
     if (err) return err;
-    *base64_string_result = (char*) BITS;
+    *base64_string_result = (char*) this->bits;
     return CHROMAPRINT_SUCCESS;
 }
 
 static void chromaprint_process_frames(Chromaprint* this, float* src) {
-    hanning_window(src, CP_FRAMES, BUFFER);
-    real_fft_forward(BUFFER, CP_FRAMES);
+    hanning_window(src, CP_FRAMES, this->buffer);
+    float_fft_forward(this->fft_plan, this->buffer, this->buffer);
     chromaprint_chroma(this);
     this->frames_processed += CP_OVERLAP;
 }
@@ -135,21 +136,21 @@ static void chromaprint_transform_image(Chromaprint* this) {
     uint32_t rows = this->row;
     uint32_t current = 1;
     for (uint32_t i = 1; i < 12; ++i) {
-        IMAGE[i] = IMAGE[i] + IMAGE[i - 1];
+        this->image[i] = this->image[i] + this->image[i - 1];
         current++;
     }
 
     uint32_t previous = 0;
     for (uint32_t i = 1; i < rows; ++i) {
-        IMAGE[current] = IMAGE[current] + IMAGE[previous];
+        this->image[current] = this->image[current] + this->image[previous];
         current++;
         previous++;
 
         for (uint32_t j = 1; j < 12; ++j) {
-            IMAGE[current] = IMAGE[current] +
-                             IMAGE[current - 1] +
-                             IMAGE[previous] -
-                             IMAGE[previous - 1];
+            this->image[current] = this->image[current] +
+                                   this->image[current - 1] +
+                                   this->image[previous] -
+                                   this->image[previous - 1];
             current++;
             previous++;
         }
@@ -167,27 +168,27 @@ static ChromaprintError chromaprint_get_fingerprint(Chromaprint* this) {
     if (length < 2) {
         return CHROMAPRINT_ERROR_INSUFFICIENT_LENGTH;
     }
-    uint32_t* fingerprint = (uint32_t*)BUFFER;
+    uint32_t* fingerprint = (uint32_t*)this->buffer;
     assert_lt(length * sizeof(int32_t), sizeof(float) * CP_FRAMES);
 
     for (uint32_t i = 0; i < length; ++i) {
         uint32_t value = 0;
-        value = (value << 2) | classify0(i, 4, 3, 15, 1.98215, 2.35817, 2.63523);
-        value = (value << 2) | classify4(i, 4, 6, 15, -1.03809, -0.651211, -0.282167);
-        value = (value << 2) | classify1(i, 0, 4, 16, -0.298702, 0.119262, 0.558497);
-        value = (value << 2) | classify3(i, 8, 2, 12, -0.105439, 0.0153946, 0.135898);
-        value = (value << 2) | classify3(i, 4, 4, 8, -0.142891, 0.0258736, 0.200632);
-        value = (value << 2) | classify4(i, 0, 3, 5, -0.826319, -0.590612, -0.368214);
-        value = (value << 2) | classify1(i, 2, 2, 9, -0.557409, -0.233035, 0.0534525);
-        value = (value << 2) | classify2(i, 7, 3, 4, -0.0646826, 0.00620476, 0.0784847);
-        value = (value << 2) | classify2(i, 6, 2, 16, -0.192387, -0.029699, 0.215855);
-        value = (value << 2) | classify2(i, 1, 3, 2, -0.0397818, -0.00568076, 0.0292026);
-        value = (value << 2) | classify5(i, 10, 1, 15, -0.53823, -0.369934, -0.190235);
-        value = (value << 2) | classify3(i, 6, 2, 10, -0.124877, 0.0296483, 0.139239);
-        value = (value << 2) | classify2(i, 1, 1, 14, -0.101475, 0.0225617, 0.231971);
-        value = (value << 2) | classify3(i, 5, 6, 4, -0.0799915, -0.00729616, 0.063262);
-        value = (value << 2) | classify1(i, 9, 2, 12, -0.272556, 0.019424, 0.302559);
-        value = (value << 2) | classify3(i, 4, 2, 14, -0.164292, -0.0321188, 0.08463);
+        value = (value << 2) | classify0(this->image, i, 4, 3, 15, 1.98215, 2.35817, 2.63523);
+        value = (value << 2) | classify4(this->image, i, 4, 6, 15, -1.03809, -0.651211, -0.282167);
+        value = (value << 2) | classify1(this->image, i, 0, 4, 16, -0.298702, 0.119262, 0.558497);
+        value = (value << 2) | classify3(this->image, i, 8, 2, 12, -0.105439, 0.0153946, 0.135898);
+        value = (value << 2) | classify3(this->image, i, 4, 4, 8, -0.142891, 0.0258736, 0.200632);
+        value = (value << 2) | classify4(this->image, i, 0, 3, 5, -0.826319, -0.590612, -0.368214);
+        value = (value << 2) | classify1(this->image, i, 2, 2, 9, -0.557409, -0.233035, 0.0534525);
+        value = (value << 2) | classify2(this->image, i, 7, 3, 4, -0.0646826, 0.00620476, 0.0784847);
+        value = (value << 2) | classify2(this->image, i, 6, 2, 16, -0.192387, -0.029699, 0.215855);
+        value = (value << 2) | classify2(this->image, i, 1, 3, 2, -0.0397818, -0.00568076, 0.0292026);
+        value = (value << 2) | classify5(this->image, i, 10, 1, 15, -0.53823, -0.369934, -0.190235);
+        value = (value << 2) | classify3(this->image, i, 6, 2, 10, -0.124877, 0.0296483, 0.139239);
+        value = (value << 2) | classify2(this->image, i, 1, 1, 14, -0.101475, 0.0225617, 0.231971);
+        value = (value << 2) | classify3(this->image, i, 5, 6, 4, -0.0799915, -0.00729616, 0.063262);
+        value = (value << 2) | classify1(this->image, i, 9, 2, 12, -0.272556, 0.019424, 0.302559);
+        value = (value << 2) | classify3(this->image, i, 4, 2, 14, -0.164292, -0.0321188, 0.08463);
         fingerprint[i] = value;
     }
     return CHROMAPRINT_SUCCESS;
@@ -198,7 +199,7 @@ static uint32_t chromaprint_bits_1(Chromaprint* this, uint8_t* ret, uint32_t off
     int32_t holder_size = 0;
 
     for (uint32_t i = 0; i < this->bits_index; ++i) {
-        int32_t value = MIN(BITS[i], 7);
+        int32_t value = MIN(this->bits[i], 7);
 
         holder |= (value << holder_size);
         holder_size += 3;
@@ -223,7 +224,7 @@ static uint32_t chromaprint_bits_2(Chromaprint* this, uint8_t* ret, uint32_t off
     int32_t holder_size = 0;
 
     for (uint32_t i = 0; i < this->bits_index; ++i) {
-        int32_t value = BITS[i];
+        int32_t value = this->bits[i];
 
         if (value < 7) continue;
         value -= 7;
@@ -252,19 +253,19 @@ static void chromaprint_compress_sub_fingerprint(Chromaprint* this, uint32_t x)
 
     while (x != 0) {
         if ((x & 1) != 0) {
-            BITS[this->bits_index++] = bit - last_bit;
+            this->bits[this->bits_index++] = bit - last_bit;
             last_bit = bit;
         }
         x >>= 1;
         bit++;
     }
 
-    BITS[this->bits_index++] = 0;
+    this->bits[this->bits_index++] = 0;
 }
 
 static ChromaprintError chromaprint_compressed(Chromaprint* this) {
     this->bits_index = 0;
-    uint32_t* fingerprint = (uint32_t*)BUFFER;
+    uint32_t* fingerprint = (uint32_t*)this->buffer;
     int32_t length = chromaprint_get_fingerprint_length(this);
     if (length < 2) {
         return CHROMAPRINT_ERROR_INSUFFICIENT_LENGTH;
@@ -286,13 +287,13 @@ static ChromaprintError chromaprint_compressed(Chromaprint* this) {
     uint32_t offset = 4;
     offset = chromaprint_bits_1(this, ret, offset);
     offset = chromaprint_bits_2(this, ret, offset);
-    chromaprint_base64_encode_fingerprint(ret, offset);
+    chromaprint_base64_encode_fingerprint(this, ret, offset);
     return CHROMAPRINT_SUCCESS;
 }
 
-static char* chromaprint_base64_encode_fingerprint(uint8_t* bytes, uint32_t length) {
+static char* chromaprint_base64_encode_fingerprint(Chromaprint* this, uint8_t* bytes, uint32_t length) {
     uint32_t new_length = ((length * 4 + 2) / 3);
-    char* ret = (char*)BITS;
+    char* ret = (char*)this->bits;
     assert_not_equals((uintptr_t)ret, (uintptr_t)bytes);
     assert_lt(new_length, CP_BITS_SIZE);
 
@@ -326,15 +327,15 @@ static char* chromaprint_base64_encode_fingerprint(uint8_t* bytes, uint32_t leng
 static void chromaprint_chroma(Chromaprint* this) {
     uint32_t note_buffer_offset = this->note_buffer_index * CP_NOTES;
     for (uint32_t i = 0; i < CP_NOTES; ++i) {
-        NOTE_BUFFER[note_buffer_offset + i] = 0.0;
+        this->note_buffer[note_buffer_offset + i] = 0.0;
     }
 
     for (uint32_t i = CP_NOTE_FREQUENCY_START; i < CP_NOTE_FREQUENCY_END; ++i) {
         uint32_t note = BINS_TO_NOTES[i];
-        double re = BUFFER[i];
-        double im = BUFFER[i + CP_IM_OFFSET];
+        double re = this->buffer[i];
+        double im = this->buffer[i + CP_IM_OFFSET];
         double energy = re * re + im * im;
-        NOTE_BUFFER[note_buffer_offset + note] += energy;
+        this->note_buffer[note_buffer_offset + note] += energy;
     }
 
     this->note_buffer_index = (this->note_buffer_index + 1) & 7;
@@ -349,7 +350,7 @@ static void chromaprint_chroma(Chromaprint* this) {
 
             for (uint32_t j = 0; j < 5; ++j) {
                 uint32_t note_index = (((offset + j) & 7) * CP_NOTES) + i;
-                double value = NOTE_BUFFER[note_index] * COEFFS[j];
+                double value = this->note_buffer[note_index] * COEFFS[j];
                 TMP[i] += value;
             }
 
@@ -362,11 +363,11 @@ static void chromaprint_chroma(Chromaprint* this) {
         uint32_t j = row * CP_NOTES;
         if (sum < 0.01) {
             for (uint32_t i = 0; i < CP_NOTES; ++i) {
-                IMAGE[j++] = 0.0;
+                this->image[j++] = 0.0;
             }
         } else {
             for (uint32_t i = 0; i < CP_NOTES; ++i) {
-                IMAGE[j] = TMP[i] / sum;
+                this->image[j] = TMP[i] / sum;
                 j++;
             }
         }
@@ -380,22 +381,22 @@ static double cmp(double a, double b) {
     return log(1.0 + a) - log(1.0 + b);
 }
 
-static double area(int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+static double area(const double* image, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
     if (x2 < x1 || y2 < y1) {
         return 0.0;
     }
 
-    double area = IMAGE[x2 * 12 + y2];
+    double area = image[x2 * 12 + y2];
 
     if (x1 > 0) {
-        area -= IMAGE[(x1 - 1) * 12 + y2];
+        area -= image[(x1 - 1) * 12 + y2];
         if (y1 > 0) {
-            area += IMAGE[(x1 - 1) * 12 + (y1 - 1)];
+            area += image[(x1 - 1) * 12 + (y1 - 1)];
         }
     }
 
     if (y1 > 0) {
-        area -= IMAGE[x2 * 12 + (y1 - 1)];
+        area -= image[x2 * 12 + (y1 - 1)];
     }
 
     return area;
@@ -416,62 +417,68 @@ static uint32_t quantize(double value, double t0, double t1, double t2) {
     }
 }
 
-static uint32_t classify0(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
-    return quantize(cmp(area(x, y, x + w - 1, y + h - 1), 0), t0, t1, t2);
+static uint32_t classify0(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
+    return quantize(cmp(area(image, x, y, x + w - 1, y + h - 1), 0), t0, t1, t2);
 }
 
-static uint32_t classify1(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
+static uint32_t classify1(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
     int32_t h_2 = h / 2;
 
-    return quantize(cmp(area(x, y + h_2, x + w - 1, y + h - 1),
-               area(x, y, x + w - 1, y + h_2 - 1)), t0, t1, t2);
+    return quantize(cmp(area(image, x, y + h_2, x + w - 1, y + h - 1),
+               area(image, x, y, x + w - 1, y + h_2 - 1)), t0, t1, t2);
 }
 
-static uint32_t classify2(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
+static uint32_t classify2(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
     int32_t w_2 = w / 2;
 
-    return quantize(cmp(area(x + w_2, y, x + w - 1, y + h - 1),
-               area(x, y, x + w_2 - 1, y + h - 1)), t0, t1, t2);
+    return quantize(cmp(area(image, x + w_2, y, x + w - 1, y + h - 1),
+               area(image, x, y, x + w_2 - 1, y + h - 1)), t0, t1, t2);
 }
 
-static uint32_t classify3(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
+static uint32_t classify3(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
     int32_t h_2 = h / 2;
     int32_t w_2 = w / 2;
 
-    double a = area(x, y + h_2, x + w_2 - 1, y + h - 1) +
-            area(x + w_2, y, x + w - 1, y + h_2 - 1);
+    double a = area(image, x, y + h_2, x + w_2 - 1, y + h - 1) +
+            area(image, x + w_2, y, x + w - 1, y + h_2 - 1);
 
-    double b = area(x, y, x + w_2 - 1, y + h_2 - 1) +
-            area(x + w_2, y + h_2, x + w - 1, y + h - 1);
+    double b = area(image, x, y, x + w_2 - 1, y + h_2 - 1) +
+            area(image, x + w_2, y + h_2, x + w - 1, y + h - 1);
 
     return quantize(cmp(a, b), t0, t1, t2);
 }
 
-static uint32_t classify4(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
+static uint32_t classify4(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
     int32_t h_3 = h / 3;
 
-    double a = area(x, y + h_3, x + w - 1, y + 2 * h_3 - 1);
+    double a = area(image, x, y + h_3, x + w - 1, y + 2 * h_3 - 1);
 
-    double b = area(x, y, x + w - 1, y + h_3 - 1) +
-            area(x, y + 2 * h_3, x + w - 1, y + h - 1);
+    double b = area(image, x, y, x + w - 1, y + h_3 - 1) +
+            area(image, x, y + 2 * h_3, x + w - 1, y + h - 1);
 
     return quantize(cmp(a, b), t0, t1, t2);
 }
 
-static uint32_t classify5(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
+static uint32_t classify5(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2) {
     int32_t w_3 = w / 3;
 
-    double a = area(x + w_3, y, x + 2 * w_3 - 1, y + h - 1);
+    double a = area(image, x + w_3, y, x + 2 * w_3 - 1, y + h - 1);
 
-    double b = area(x, y, x + w_3 - 1, y + h - 1) +
-            area(x + 2 * w_3, y, x + w - 1, y + h - 1);
+    double b = area(image, x, y, x + w_3 - 1, y + h - 1) +
+            area(image, x + 2 * w_3, y, x + w - 1, y + h - 1);
 
     return quantize(cmp(a, b), t0, t1, t2);
 }
 
 static const double a = 0.0000011765482980900709;
 static const double b = -0.0015339801862847655;
-static void hanning_window(float* frames, uint32_t length, double* dst) {
+static void hanning_window(float* frames, uint32_t length, float* dst) {
     assert_equals(length, 4096);
     double tmp;
     double cos_value = 1.0;
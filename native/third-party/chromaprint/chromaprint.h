@@ -2,7 +2,7 @@
 #define CHROMAPRINT_H
 
 #include <math.h>
-#include <fft/real_fft.c>
+#include <fft/float_fft.c>
 
 typedef enum {
     CHROMAPRINT_SUCCESS = 0,
@@ -12,7 +12,6 @@ typedef enum {
 } ChromaprintError;
 
 static bool initialized = false;
-static uint32_t instance_in_use = 0;
 #define CP_LN2 0.6931471805599453
 #define CP_DURATION 120
 #define CP_SAMPLE_RATE 11025
@@ -34,12 +33,7 @@ static const double COEFFS[] = {0.25, 0.75, 1.0, 0.75, 0.25};
 #define CP_BITS_SIZE (CP_ROWS * 33)
 
 static const char* BASE64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
-static bool critical = false;
-static float TMP2[CP_TMP_SIZE];
-static double BUFFER[CP_FRAMES];
-static double IMAGE[CP_ROWS * CP_NOTES];
-static double NOTE_BUFFER[8 * CP_NOTES];
-static uint8_t BITS[CP_BITS_SIZE];
+// Filled once by chromaprint_initialize and only read after, shared by all instances.
 static uint32_t BINS_TO_NOTES[CP_NOTE_FREQUENCY_END];
 
 typedef struct {
@@ -49,6 +43,14 @@ typedef struct {
     uint32_t row;
     uint32_t bits_index;
     int32_t tmp_length;
+    FloatFftPlan* fft_plan;
+    // Working state of an instance, instances don't share any so they can be used interleaved.
+    float tmp2[CP_TMP_SIZE];
+    // The windowed frames, transformed in place into a spectrum of the float_fft layout.
+    float buffer[CP_FRAMES];
+    double image[CP_ROWS * CP_NOTES];
+    double note_buffer[8 * CP_NOTES];
+    uint8_t bits[CP_BITS_SIZE];
 } Chromaprint;
 
 EXPORT Chromaprint* chromaprint_create();
@@ -65,20 +67,26 @@ static int32_t chromaprint_get_fingerprint_length(Chromaprint* this);
 static ChromaprintError chromaprint_get_fingerprint(Chromaprint* this);
 static void chromaprint_compress_sub_fingerprint(Chromaprint* this, uint32_t x);
 static ChromaprintError chromaprint_compressed(Chromaprint* this);
-static char* chromaprint_base64_encode_fingerprint(uint8_t* bytes, uint32_t length);
+static char* chromaprint_base64_encode_fingerprint(Chromaprint* this, uint8_t* bytes, uint32_t length);
 static uint32_t chromaprint_bits_1(Chromaprint* this, uint8_t* ret, uint32_t offset);
 static uint32_t chromaprint_bits_2(Chromaprint* this, uint8_t* ret, uint32_t offset);
 static void chromaprint_initialize();
 
 static double cmp(double a, double b);
-static double area(int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+static double area(const double* image, int32_t x1, int32_t y1, int32_t x2, int32_t y2);
 static uint32_t quantize(double value, double t0, double t1, double t2);
-static uint32_t classify0(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
-static uint32_t classify1(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
-static uint32_t classify2(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
-static uint32_t classify3(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
-static uint32_t classify4(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
-static uint32_t classify5(int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
-static void hanning_window(float*, uint32_t, double*);
+static uint32_t classify0(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
+static uint32_t classify1(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
+static uint32_t classify2(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
+static uint32_t classify3(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
+static uint32_t classify4(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
+static uint32_t classify5(const double* image,
+                          int32_t x, int32_t y, int32_t h, int32_t w, double t0, double t1, double t2);
+static void hanning_window(float*, uint32_t, float*);
 
 #endif
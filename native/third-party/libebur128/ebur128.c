@@ -7,7 +7,9 @@
 #include <math.h> /* You may have to define _USE_MATH_DEFINES if you use MSVC */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <queue.c>
+#include <simd.h>
 
 
 #define CHECK_ERROR(condition, errorcode, goto_point)                          \
@@ -17,6 +19,9 @@
   }
 
 #define ALMOST_ZERO 0.000001
+/* 100ms block energies kept in EBUR128_MODE_BLOCK_ENERGY, enough for 3s. */
+#define BLOCK_ENERGY_HISTORY 30
+#define BLOCK_ENERGY_MAX_CHANNELS 5
 
 typedef struct {              /* Data structure for polyphase FIR interpolator */
   unsigned int factor;        /* Interpolation factor of the interpolator */
@@ -28,8 +33,12 @@ typedef struct {              /* Data structure for polyphase FIR interpolator *
     unsigned int* index;      /* Delay index of corresponding filter coeff */
     double* coeff;            /* List of subfilter coefficients */
   }* filter;                  /* List of subfilters (one for each factor) */
-  float** z;                  /* List of delay buffers (one for each channel) */
+  float** z;                  /* List of delay buffers (one for each channel),
+                                 mirrored so that the last delay samples are
+                                 contiguous behind zi + delay */
   unsigned int zi;            /* Current delay buffer index */
+  float* phase_coeffs;        /* Coefficients by delay index, oldest sample
+                                 first, one vector lane per subfilter */
 } interpolator;
 
 struct ebur128_state_internal {
@@ -73,12 +82,18 @@ struct ebur128_state_internal {
   interpolator* interp;
   float* resampler_buffer_input;
   size_t resampler_buffer_input_frames;
-  float* resampler_buffer_output;
-  size_t resampler_buffer_output_frames;
   /** The maximum window duration in ms. */
   unsigned long window;
   unsigned long history;
   double last_block_sum;
+  /** EBUR128_MODE_BLOCK_ENERGY: channel weighted energy sums of the last
+   *  BLOCK_ENERGY_HISTORY 100ms blocks (used as ring buffer) and of the block
+   *  being filled. */
+  double block_energies[BLOCK_ENERGY_HISTORY];
+  size_t block_energy_index;
+  size_t completed_blocks;
+  double partial_block_energy;
+  size_t partial_block_frames;
 };
 
 static double relative_gate = -10.0;
@@ -89,10 +104,18 @@ static double minus_twenty_decibels;
 static double histogram_energies[1000];
 static double histogram_energy_boundaries[1001];
 
+/* Interpolation factors up to 4 are supported, one subfilter per f32x4 lane. */
+#define INTERP_MAX_FACTOR 4
+
 static interpolator* interp_create(unsigned int taps, unsigned int factor, unsigned int channels) {
-  interpolator* interp = calloc(1, sizeof(interpolator));
+  interpolator* interp;
   unsigned int j = 0;
 
+  if (factor > INTERP_MAX_FACTOR) {
+    return NULL;
+  }
+  interp = calloc(1, sizeof(interpolator));
+
   interp->taps = taps;
   interp->factor = factor;
   interp->channels = channels;
@@ -108,8 +131,9 @@ static interpolator* interp_create(unsigned int taps, unsigned int factor, unsig
   /* One delay buffer per channel. */
   interp->z = calloc(interp->channels, sizeof(float*));
   for (j = 0; j < interp->channels; j++) {
-    interp->z[j] = calloc( interp->delay, sizeof(float) );
+    interp->z[j] = calloc( interp->delay * 2, sizeof(float) );
   }
+  interp->phase_coeffs = calloc(interp->delay * INTERP_MAX_FACTOR, sizeof(float));
 
   /* Calculate the filter coefficients */
   for (j = 0; j < interp->taps; j++) {
@@ -128,6 +152,8 @@ static interpolator* interp_create(unsigned int taps, unsigned int factor, unsig
       unsigned int t = interp->filter[f].count++;
       interp->filter[f].coeff[t] = c;
       interp->filter[f].index[t] = j / interp->factor;
+      interp->phase_coeffs[(interp->delay - 1 - j / interp->factor) *
+                           INTERP_MAX_FACTOR + f] = (float) c;
     }
   }
   return interp;
@@ -147,9 +173,18 @@ static void interp_destroy(interpolator* interp) {
     free(interp->z[j]);
   }
   free(interp->z);
+  free(interp->phase_coeffs);
   free(interp);
 }
 
+static void interp_reset(interpolator* interp) {
+  unsigned int j = 0;
+  for (j = 0; j < interp->channels; j++) {
+    memset(interp->z[j], 0, interp->delay * 2 * sizeof(float));
+  }
+  interp->zi = 0;
+}
+
 static void interp_process(interpolator* interp, size_t frames, float* in, float* out) {
   size_t frame = 0;
   unsigned int chan = 0;
@@ -162,7 +197,8 @@ static void interp_process(interpolator* interp, size_t frames, float* in, float
   for (frame = 0; frame < frames; frame++) {
     for (chan = 0; chan < interp->channels; chan++) {
       /* Add sample to delay buffer */
-      interp->z[chan][interp->zi] = *in++;
+      interp->z[chan][interp->zi] = *in;
+      interp->z[chan][interp->zi + interp->delay] = *in++;
       /* Apply coefficients */
       outp = out + chan;
       for (f = 0; f < interp->factor; f++) {
@@ -187,6 +223,41 @@ static void interp_process(interpolator* interp, size_t frames, float* in, float
   }
 }
 
+/* Raises peaks[chan] to the largest magnitude of the interpolated samples of
+ * each channel without producing them. All subfilters are evaluated at once,
+ * a lane each, over the contiguous history of the mirrored delay buffer. */
+static void interp_process_peaks(interpolator* interp, size_t frames,
+                                 const float* in, double* peaks) {
+  const unsigned int delay = interp->delay;
+  const unsigned int channels = interp->channels;
+  const float* coeffs = interp->phase_coeffs;
+  unsigned int chan = 0;
+  for (chan = 0; chan < channels; chan++) {
+    float* z = interp->z[chan];
+    unsigned int zi = interp->zi;
+    f32x4 max = f32x4_splat(0.0f);
+    float peak;
+    size_t frame = 0;
+    for (frame = 0; frame < frames; frame++) {
+      const float* history = z + zi + 1;
+      f32x4 acc = f32x4_splat(0.0f);
+      unsigned int t = 0;
+      z[zi] = in[frame * channels + chan];
+      z[zi + delay] = z[zi];
+      for (t = 0; t < delay; t++) {
+        acc += f32x4_splat(history[t]) * f32x4_load(coeffs + t * INTERP_MAX_FACTOR);
+      }
+      max = f32x4_max(max, f32x4_abs(acc));
+      zi = zi + 1 == delay ? 0 : zi + 1;
+    }
+    peak = f32x4_horizontal_max(max);
+    if (peak > peaks[chan]) {
+      peaks[chan] = peak;
+    }
+  }
+  interp->zi = (unsigned int) ((interp->zi + frames) % delay);
+}
+
 static void ebur128_init_filter(ebur128_state* st) {
   int i, j;
 
@@ -285,7 +356,6 @@ static int ebur128_init_resampler(ebur128_state* st) {
     CHECK_ERROR(!st->d->interp, EBUR128_ERROR_NOMEM, exit)
   } else {
     st->d->resampler_buffer_input = NULL;
-    st->d->resampler_buffer_output = NULL;
     st->d->interp = NULL;
     goto exit;
   }
@@ -296,23 +366,11 @@ static int ebur128_init_resampler(ebur128_state* st) {
                                       sizeof(float));
   CHECK_ERROR(!st->d->resampler_buffer_input, EBUR128_ERROR_NOMEM, free_interp)
 
-  st->d->resampler_buffer_output_frames =
-                                    st->d->resampler_buffer_input_frames *
-                                    st->d->interp->factor;
-  st->d->resampler_buffer_output = malloc
-                                      (st->d->resampler_buffer_output_frames *
-                                       st->channels *
-                                       sizeof(float));
-  CHECK_ERROR(!st->d->resampler_buffer_output, EBUR128_ERROR_NOMEM, free_input)
-
   return errcode;
 
 free_interp:
   interp_destroy(st->d->interp);
   st->d->interp = NULL;
-free_input:
-  free(st->d->resampler_buffer_input);
-  st->d->resampler_buffer_input = NULL;
 exit:
   return errcode;
 }
@@ -320,8 +378,6 @@ exit:
 static void ebur128_destroy_resampler(ebur128_state* st) {
   free(st->d->resampler_buffer_input);
   st->d->resampler_buffer_input = NULL;
-  free(st->d->resampler_buffer_output);
-  st->d->resampler_buffer_output = NULL;
   interp_destroy(st->d->interp);
   st->d->interp = NULL;
 }
@@ -332,6 +388,17 @@ void ebur128_get_version(int* major, int* minor, int* patch) {
   *patch = EBUR128_VERSION_PATCH;
 }
 
+static void ebur128_reset_block_energies(ebur128_state* st) {
+  size_t i;
+  for (i = 0; i < BLOCK_ENERGY_HISTORY; ++i) {
+    st->d->block_energies[i] = 0.0;
+  }
+  st->d->block_energy_index = 0;
+  st->d->completed_blocks = 0;
+  st->d->partial_block_energy = 0.0;
+  st->d->partial_block_frames = 0;
+}
+
 ebur128_state* ebur128_init(unsigned int channels,
                             unsigned long samplerate,
                             int mode) {
@@ -433,6 +500,7 @@ ebur128_state* ebur128_init(unsigned int channels,
   st->d->needed_frames = st->d->samples_in_100ms * 4;
   /* start at the beginning of the buffer */
   st->d->audio_data_index = 0;
+  ebur128_reset_block_energies(st);
 
   /* initialize static constants */
   relative_gate_factor = pow(10.0, relative_gate / 10.0);
@@ -496,24 +564,9 @@ void ebur128_destroy(ebur128_state** st) {
   *st = NULL;
 }
 
-static void ebur128_check_true_peak(ebur128_state* st, size_t frames) {
-  size_t c, i;
-  interp_process(st->d->interp, frames,
-                 st->d->resampler_buffer_input,
-                 st->d->resampler_buffer_output);
-  for (c = 0; c < st->channels; ++c) {
-    for (i = 0; i < st->d->resampler_buffer_output_frames; ++i) {
-      if (st->d->resampler_buffer_output[i * st->channels + c] >
-                                                         st->d->prev_true_peak[c]) {
-        st->d->prev_true_peak[c] =
-            st->d->resampler_buffer_output[i * st->channels + c];
-      } else if (-st->d->resampler_buffer_output[i * st->channels + c] >
-                                                         st->d->prev_true_peak[c]) {
-        st->d->prev_true_peak[c] =
-           -st->d->resampler_buffer_output[i * st->channels + c];
-      }
-    }
-  }
+static void ebur128_check_true_peak(ebur128_state* st, const float* in,
+                                    size_t frames) {
+  interp_process_peaks(st->d->interp, frames, in, st->d->prev_true_peak);
 }
 
 #ifdef __SSE2_MATH__
@@ -566,7 +619,7 @@ static void ebur128_filter_##type(ebur128_state* st, const type* src,          \
                       (float) (src[i * st->channels + c] / scaling_factor);    \
       }                                                                        \
     }                                                                          \
-    ebur128_check_true_peak(st, frames);                                       \
+    ebur128_check_true_peak(st, st->d->resampler_buffer_input, frames);        \
   }                                                                            \
   for (c = 0; c < st->channels; ++c) {                                         \
     int ci = st->d->channel_map[c] - 1;                                        \
@@ -619,6 +672,41 @@ static size_t find_histogram_index(double energy) {
   return index_min;
 }
 
+static int ebur128_push_block_energy(ebur128_state* st, double sum) {
+  st->d->last_block_sum = sum;
+  if (sum < histogram_energy_boundaries[0]) {
+    return EBUR128_SUCCESS;
+  }
+  if (st->d->use_histogram) {
+    ++st->d->block_energy_histogram[find_histogram_index(sum)];
+  } else {
+    if (st->d->block_list->length == st->d->block_list_max) {
+      queue_shift(st->d->block_list, NULL);
+    }
+    if (queue_push(st->d->block_list, sum)) {
+      return EBUR128_ERROR_NOMEM;
+    }
+  }
+  return EBUR128_SUCCESS;
+}
+
+static int ebur128_push_short_term_energy(ebur128_state* st, double st_energy) {
+  if (st_energy < histogram_energy_boundaries[0]) {
+    return EBUR128_SUCCESS;
+  }
+  if (st->d->use_histogram) {
+    ++st->d->short_term_block_energy_histogram[find_histogram_index(st_energy)];
+  } else {
+    if (st->d->st_block_list->length == st->d->st_block_list_max) {
+      queue_shift(st->d->st_block_list, NULL);
+    }
+    if (queue_push(st->d->st_block_list, st_energy)) {
+      return EBUR128_ERROR_NOMEM;
+    }
+  }
+  return EBUR128_SUCCESS;
+}
+
 static int ebur128_calc_gating_block(ebur128_state* st, size_t frames_per_block,
                                      double* optional_output) {
   size_t i, c;
@@ -665,24 +753,8 @@ static int ebur128_calc_gating_block(ebur128_state* st, size_t frames_per_block,
   if (optional_output) {
     *optional_output = sum;
     return EBUR128_SUCCESS;
-  } else if (sum >= histogram_energy_boundaries[0]) {
-    st->d->last_block_sum = sum;
-    if (st->d->use_histogram) {
-      ++st->d->block_energy_histogram[find_histogram_index(sum)];
-    } else {
-      if (st->d->block_list->length == st->d->block_list_max) {
-        queue_shift(st->d->block_list, NULL);
-      }
-      if (queue_push(st->d->block_list, sum)) {
-        return EBUR128_ERROR_NOMEM;
-      }
-
-    }
-    return EBUR128_SUCCESS;
-  } else {
-    st->d->last_block_sum = sum;
-    return EBUR128_SUCCESS;
   }
+  return ebur128_push_block_energy(st, sum);
 }
 
 int ebur128_set_channel(ebur128_state* st,
@@ -774,6 +846,7 @@ int ebur128_change_parameters(ebur128_state* st,
   st->d->needed_frames = st->d->samples_in_100ms * 4;
   /* start at the beginning of the buffer */
   st->d->audio_data_index = 0;
+  ebur128_reset_block_energies(st);
   /* reset short term frame counter */
   st->d->short_term_frame_counter = 0;
 
@@ -817,6 +890,7 @@ int ebur128_set_max_window(ebur128_state* st, unsigned long window)
   st->d->needed_frames = st->d->samples_in_100ms * 4;
   /* start at the beginning of the buffer */
   st->d->audio_data_index = 0;
+  ebur128_reset_block_energies(st);
   /* reset short term frame counter */
   st->d->short_term_frame_counter = 0;
 
@@ -846,12 +920,239 @@ int ebur128_set_max_history(ebur128_state* st, unsigned long history)
   return EBUR128_SUCCESS;
 }
 
+/* EBUR128_MODE_BLOCK_ENERGY only applies up to BLOCK_ENERGY_MAX_CHANNELS. */
+#define BLOCK_ENERGY_ACTIVE(st)                                                \
+  (((st)->mode & EBUR128_MODE_BLOCK_ENERGY) &&                                 \
+   (st)->channels <= BLOCK_ENERGY_MAX_CHANNELS)
+
+static double ebur128_channel_weight(ebur128_state* st, unsigned int c) {
+  switch (st->d->channel_map[c]) {
+    case EBUR128_UNUSED:
+      return 0.0;
+    case EBUR128_Mp110:
+    case EBUR128_Mm110:
+    case EBUR128_Mp060:
+    case EBUR128_Mm060:
+    case EBUR128_Mp090:
+    case EBUR128_Mm090:
+      return 1.41;
+    case EBUR128_DUAL_MONO:
+      return 2.0;
+    default:
+      return 1.0;
+  }
+}
+
+/* K-weights channels c and c + 1 (lanes == 2) or c alone (lanes == 1) of
+ * interleaved float input and returns the sums of squared filtered samples.
+ * In block energy mode the filter state is indexed by channel. Inlined with
+ * constant stride and lanes the loads are specialized for mono and stereo. */
+static inline f64x2 ebur128_filter_energy_lanes(ebur128_state* st,
+                                                const float* src,
+                                                size_t frames,
+                                                unsigned int stride,
+                                                unsigned int c,
+                                                unsigned int lanes,
+                                                f64x2* peak) {
+  const f64x2 zero = f64x2_splat(0.0);
+  const f64x2 a1 = f64x2_splat(st->d->a[1]);
+  const f64x2 a2 = f64x2_splat(st->d->a[2]);
+  const f64x2 a3 = f64x2_splat(st->d->a[3]);
+  const f64x2 a4 = f64x2_splat(st->d->a[4]);
+  const f64x2 b0 = f64x2_splat(st->d->b[0]);
+  const f64x2 b1 = f64x2_splat(st->d->b[1]);
+  const f64x2 b2 = f64x2_splat(st->d->b[2]);
+  const f64x2 b3 = f64x2_splat(st->d->b[3]);
+  const f64x2 b4 = f64x2_splat(st->d->b[4]);
+  double* v0 = st->d->v[c];
+  double* w0 = lanes == 2 ? st->d->v[c + 1] : st->d->v[c];
+  f64x2 v1 = { v0[1], lanes == 2 ? w0[1] : 0.0 };
+  f64x2 v2 = { v0[2], lanes == 2 ? w0[2] : 0.0 };
+  f64x2 v3 = { v0[3], lanes == 2 ? w0[3] : 0.0 };
+  f64x2 v4 = { v0[4], lanes == 2 ? w0[4] : 0.0 };
+  f64x2 energy = zero;
+  f64x2 max = *peak;
+  size_t i;
+
+  for (i = 0; i < frames; ++i) {
+    const float* frame = src + i * stride + c;
+    f64x2 x = { (double) frame[0], lanes == 2 ? (double) frame[1] : 0.0 };
+    f64x2 v, y;
+    max = f64x2_max(max, f64x2_abs(x));
+    v = x - a1 * v1 - a2 * v2 - a3 * v3 - a4 * v4;
+    y = b0 * v + b1 * v1 + b2 * v2 + b3 * v3 + b4 * v4;
+    energy += y * y;
+    v4 = v3;
+    v3 = v2;
+    v2 = v1;
+    v1 = v;
+  }
+
+  {
+    const f64x2 min = f64x2_splat(DBL_MIN);
+    v1 = f64x2_select(f64x2_abs(v1) < min, zero, v1);
+    v2 = f64x2_select(f64x2_abs(v2) < min, zero, v2);
+    v3 = f64x2_select(f64x2_abs(v3) < min, zero, v3);
+    v4 = f64x2_select(f64x2_abs(v4) < min, zero, v4);
+  }
+  v0[1] = v1[0]; v0[2] = v2[0]; v0[3] = v3[0]; v0[4] = v4[0];
+  if (lanes == 2) {
+    w0[1] = v1[1]; w0[2] = v2[1]; w0[3] = v3[1]; w0[4] = v4[1];
+  }
+  *peak = max;
+  return energy;
+}
+
+/* Filters frames that all belong to the current 100ms block into its energy
+ * and tracks peaks. */
+static void ebur128_filter_block_energy(ebur128_state* st,
+                                        const float* src,
+                                        size_t frames) {
+  double peaks[BLOCK_ENERGY_MAX_CHANNELS + 1];
+  double energy = 0.0;
+  unsigned int c;
+
+  if (st->channels == 1) {
+    f64x2 peak = f64x2_splat(0.0);
+    f64x2 e = ebur128_filter_energy_lanes(st, src, frames, 1, 0, 1, &peak);
+    energy = e[0] * ebur128_channel_weight(st, 0);
+    peaks[0] = peak[0];
+  } else if (st->channels == 2) {
+    f64x2 peak = f64x2_splat(0.0);
+    f64x2 e = ebur128_filter_energy_lanes(st, src, frames, 2, 0, 2, &peak);
+    energy = e[0] * ebur128_channel_weight(st, 0) +
+             e[1] * ebur128_channel_weight(st, 1);
+    peaks[0] = peak[0];
+    peaks[1] = peak[1];
+  } else {
+    for (c = 0; c < st->channels; c += 2) {
+      f64x2 peak = f64x2_splat(0.0);
+      f64x2 e;
+      if (c + 1 < st->channels) {
+        e = ebur128_filter_energy_lanes(st, src, frames, st->channels, c, 2,
+                                        &peak);
+        energy += e[1] * ebur128_channel_weight(st, c + 1);
+      } else {
+        e = ebur128_filter_energy_lanes(st, src, frames, st->channels, c, 1,
+                                        &peak);
+      }
+      energy += e[0] * ebur128_channel_weight(st, c);
+      peaks[c] = peak[0];
+      peaks[c + 1] = peak[1];
+    }
+  }
+  st->d->partial_block_energy += energy;
+
+  if ((st->mode & EBUR128_MODE_SAMPLE_PEAK) == EBUR128_MODE_SAMPLE_PEAK) {
+    for (c = 0; c < st->channels; ++c) {
+      if (peaks[c] > st->d->prev_sample_peak[c]) {
+        st->d->prev_sample_peak[c] = peaks[c];
+      }
+    }
+  }
+  if ((st->mode & EBUR128_MODE_TRUE_PEAK) == EBUR128_MODE_TRUE_PEAK &&
+      st->d->interp) {
+    ebur128_check_true_peak(st, src, frames);
+  }
+}
+
+/* Mean energy of the last blocks completed 100ms blocks. */
+static double ebur128_block_energy_mean(ebur128_state* st, size_t blocks) {
+  double sum = 0.0;
+  size_t index = st->d->block_energy_index;
+  size_t i;
+  for (i = 0; i < blocks; ++i) {
+    index = index == 0 ? BLOCK_ENERGY_HISTORY - 1 : index - 1;
+    sum += st->d->block_energies[index];
+  }
+  return sum / (double) (blocks * st->d->samples_in_100ms);
+}
+
+static int ebur128_complete_block_energy(ebur128_state* st) {
+  st->d->block_energies[st->d->block_energy_index] =
+      st->d->partial_block_energy;
+  st->d->block_energy_index =
+      (st->d->block_energy_index + 1) % BLOCK_ENERGY_HISTORY;
+  ++st->d->completed_blocks;
+  st->d->partial_block_energy = 0.0;
+  st->d->partial_block_frames = 0;
+
+  /* gating blocks are 400ms long and overlap by 75% */
+  if ((st->mode & EBUR128_MODE_I) == EBUR128_MODE_I &&
+      st->d->completed_blocks >= 4) {
+    if (ebur128_push_block_energy(st, ebur128_block_energy_mean(st, 4))) {
+      return EBUR128_ERROR_NOMEM;
+    }
+  }
+  /* 3s short term blocks overlap by 2s */
+  if ((st->mode & EBUR128_MODE_LRA) == EBUR128_MODE_LRA &&
+      st->d->completed_blocks >= 30 &&
+      (st->d->completed_blocks - 30) % 10 == 0) {
+    if (ebur128_push_short_term_energy(st,
+                                       ebur128_block_energy_mean(st, 30))) {
+      return EBUR128_ERROR_NOMEM;
+    }
+  }
+  return EBUR128_SUCCESS;
+}
+
+static int ebur128_add_frames_block_energy_float(ebur128_state* st,
+                                                 const float* src,
+                                                 size_t frames) {
+  unsigned int c;
+  for (c = 0; c < st->channels; c++) {
+    st->d->prev_sample_peak[c] = 0.0;
+    st->d->prev_true_peak[c] = 0.0;
+  }
+  while (frames > 0) {
+    size_t block_frames =
+        st->d->samples_in_100ms - st->d->partial_block_frames;
+    if (block_frames > frames) {
+      block_frames = frames;
+    }
+    ebur128_filter_block_energy(st, src, block_frames);
+    src += block_frames * st->channels;
+    frames -= block_frames;
+    st->d->partial_block_frames += block_frames;
+    if (st->d->partial_block_frames == st->d->samples_in_100ms &&
+        ebur128_complete_block_energy(st)) {
+      return EBUR128_ERROR_NOMEM;
+    }
+  }
+  for (c = 0; c < st->channels; c++) {
+    if (st->d->prev_sample_peak[c] > st->d->sample_peak[c]) {
+      st->d->sample_peak[c] = st->d->prev_sample_peak[c];
+    }
+    if (st->d->prev_true_peak[c] > st->d->true_peak[c]) {
+      st->d->true_peak[c] = st->d->prev_true_peak[c];
+    }
+  }
+  return EBUR128_SUCCESS;
+}
+
+/* Block energy mode takes float input only. */
+#define EBUR128_ADD_FRAMES_BLOCK_ENERGY_UNSUPPORTED(type)                      \
+static int ebur128_add_frames_block_energy_##type(ebur128_state* st,           \
+                                                  const type* src,             \
+                                                  size_t frames) {             \
+  (void) st;                                                                   \
+  (void) src;                                                                  \
+  (void) frames;                                                               \
+  return EBUR128_ERROR_INVALID_MODE;                                           \
+}
+EBUR128_ADD_FRAMES_BLOCK_ENERGY_UNSUPPORTED(short)
+EBUR128_ADD_FRAMES_BLOCK_ENERGY_UNSUPPORTED(int)
+EBUR128_ADD_FRAMES_BLOCK_ENERGY_UNSUPPORTED(double)
+
 static int ebur128_energy_shortterm(ebur128_state* st, double* out);
 #define EBUR128_ADD_FRAMES(type)                                               \
 int ebur128_add_frames_##type(ebur128_state* st,                               \
                               const type* src, size_t frames) {                \
   size_t src_index = 0;                                                        \
   unsigned int c = 0;                                                          \
+  if (BLOCK_ENERGY_ACTIVE(st)) {                                               \
+    return ebur128_add_frames_block_energy_##type(st, src, frames);            \
+  }                                                                            \
   for (c = 0; c < st->channels; c++) {                                         \
     st->d->prev_sample_peak[c] = 0.0;                                          \
     st->d->prev_true_peak[c] = 0.0;                                            \
@@ -873,19 +1174,8 @@ int ebur128_add_frames_##type(ebur128_state* st,                               \
         if (st->d->short_term_frame_counter == st->d->samples_in_100ms * 30) { \
           double st_energy;                                                    \
           if (ebur128_energy_shortterm(st, &st_energy) == EBUR128_SUCCESS &&   \
-                  st_energy >= histogram_energy_boundaries[0]) {               \
-            if (st->d->use_histogram) {                                        \
-              ++st->d->short_term_block_energy_histogram[                      \
-                                              find_histogram_index(st_energy)];\
-            } else {                                                           \
-              if (st->d->st_block_list->length == st->d->st_block_list_max) {  \
-                queue_shift(st->d->st_block_list, NULL);                       \
-              }                                                                \
-                                                                               \
-              if (queue_push(st->d->st_block_list, st_energy)) {               \
-                return EBUR128_ERROR_NOMEM;                                    \
-              }                                                                \
-            }                                                                  \
+              ebur128_push_short_term_energy(st, st_energy)) {                 \
+            return EBUR128_ERROR_NOMEM;                                        \
           }                                                                    \
           st->d->short_term_frame_counter = st->d->samples_in_100ms * 20;      \
         }                                                                      \
@@ -921,12 +1211,12 @@ EBUR128_ADD_FRAMES(int)
 EBUR128_ADD_FRAMES(float)
 EBUR128_ADD_FRAMES(double)
 
+/* Adds the block energies of st to relative_threshold and their count to
+ * above_thresh_counter, callers turn the sum into the threshold. */
 static int ebur128_calc_relative_threshold(ebur128_state* st,
                                            size_t* above_thresh_counter,
                                            double* relative_threshold) {
   size_t i;
-  *relative_threshold = 0.0;
-  *above_thresh_counter = 0;
 
   if (st->d->use_histogram) {
     for (i = 0; i < 1000; ++i) {
@@ -946,11 +1236,6 @@ static int ebur128_calc_relative_threshold(ebur128_state* st,
     }
   }
 
-  if (*above_thresh_counter != 0) {
-    *relative_threshold /= (double) *above_thresh_counter;
-    *relative_threshold *= relative_gate_factor;
-  }
-
   return EBUR128_SUCCESS;
 }
 
@@ -977,6 +1262,8 @@ static int ebur128_gated_loudness(ebur128_state** sts, size_t size,
     *out = -HUGE_VAL;
     return EBUR128_SUCCESS;
   }
+  relative_threshold /= (double) above_thresh_counter;
+  relative_threshold *= relative_gate_factor;
 
   above_thresh_counter = 0;
   if (relative_threshold < histogram_energy_boundaries[0]) {
@@ -1021,8 +1308,8 @@ static int ebur128_gated_loudness(ebur128_state** sts, size_t size,
 }
 
 int ebur128_relative_threshold(ebur128_state* st, double* out) {
-  double relative_threshold;
-  size_t above_thresh_counter;
+  double relative_threshold = 0.0;
+  size_t above_thresh_counter = 0;
 
   if ((st->mode & EBUR128_MODE_I) != EBUR128_MODE_I) {
     return EBUR128_ERROR_INVALID_MODE;
@@ -1034,6 +1321,8 @@ int ebur128_relative_threshold(ebur128_state* st, double* out) {
       *out = -70.0;
       return EBUR128_SUCCESS;
   }
+  relative_threshold /= (double) above_thresh_counter;
+  relative_threshold *= relative_gate_factor;
 
   *out = ebur128_energy_to_loudness(relative_threshold);
   return EBUR128_SUCCESS;
@@ -1051,6 +1340,15 @@ int ebur128_loudness_global_multiple(ebur128_state** sts, size_t size,
 static int ebur128_energy_in_interval(ebur128_state* st,
                                       size_t interval_frames,
                                       double* out) {
+  if (BLOCK_ENERGY_ACTIVE(st)) {
+    size_t blocks = (interval_frames + st->d->samples_in_100ms / 2) /
+                    st->d->samples_in_100ms;
+    if (blocks == 0 || blocks > BLOCK_ENERGY_HISTORY) {
+      return EBUR128_ERROR_INVALID_MODE;
+    }
+    *out = ebur128_block_energy_mean(st, blocks);
+    return EBUR128_SUCCESS;
+  }
   if (interval_frames > st->d->audio_data_frames) {
     return EBUR128_ERROR_INVALID_MODE;
   }
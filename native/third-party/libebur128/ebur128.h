@@ -92,7 +92,12 @@ enum mode {
   EBUR128_MODE_TRUE_PEAK   = (1 << 5) | EBUR128_MODE_M
                                       | EBUR128_MODE_SAMPLE_PEAK,
   /** uses histogram algorithm to calculate loudness */
-  EBUR128_MODE_HISTOGRAM   = (1 << 6)
+  EBUR128_MODE_HISTOGRAM   = (1 << 6),
+  /** float input of up to 5 channels is K-weighted in vector lanes and summed
+   *  into 100ms block energies directly, without keeping the filtered audio.
+   *  Momentary, short-term and window loudness then cover whole 100ms blocks
+   *  and windows are limited to 3000ms. */
+  EBUR128_MODE_BLOCK_ENERGY = (1 << 7)
 };
 
 /** forward declaration of ebur128_state_internal */
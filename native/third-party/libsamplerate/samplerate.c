@@ -516,6 +516,11 @@ psrc_set_converter (int converter_type, int channels, int *error)
 	case SRC_ZERO_ORDER_HOLD :
 		state = zoh_state_new (channels, &temp_error) ;
 		break ;
+#ifdef ENABLE_LINEAR_CONVERTER
+	case SRC_LINEAR :
+		state = linear_state_new (channels, &temp_error) ;
+		break ;
+#endif
 	default :
 		temp_error = SRC_ERR_BAD_CONVERTER ;
 		state = NULL ;
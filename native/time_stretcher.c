@@ -0,0 +1,513 @@
+// Ported from Chromium
+// (https://chromium.googlesource.com/chromium/chromium/+/51ed77e3f37a9a9b80d6d0a8259e84a8ca635259/media/filters/audio_renderer_algorithm.cc)
+//
+// Copyright 2021 The Chromium Authors. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//    * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//    * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "time_stretcher.h"
+
+static void time_stretcher_fill_window(float* window, uint32_t length) {
+    const double scale = 2.0 * M_PI / (double)length;
+    for (uint32_t n = 0; n < length; ++n) {
+        window[n] = 0.5 * (1.0 - cos((double)n * scale));
+    }
+}
+
+EXPORT TimeStretcher* time_stretcher_create(uint32_t channel_count, uint32_t sample_rate) {
+    if (channel_count == 0 || channel_count > TIME_STRETCHER_MAX_CHANNELS || sample_rate == 0) {
+        return NULL;
+    }
+    TimeStretcher* stretcher = malloc(sizeof(TimeStretcher));
+    if (!stretcher) {
+        return NULL;
+    }
+    memset(stretcher, 0, sizeof(TimeStretcher));
+
+    uint32_t window_frames = (uint32_t)round(TIME_STRETCHER_WINDOW_SIZE_SECONDS * sample_rate);
+    if (window_frames % 2 != 0) {
+        window_frames++;
+    }
+    const uint32_t candidate_frames = (uint32_t)round(TIME_STRETCHER_SEARCH_INTERVAL_SECONDS * sample_rate);
+    stretcher->channel_count = channel_count;
+    stretcher->playback_rate = 1.0;
+    stretcher->window_frames = window_frames;
+    stretcher->hop_frames = window_frames / 2;
+    stretcher->candidate_frames = candidate_frames;
+    stretcher->search_frames = candidate_frames + window_frames - 1;
+    stretcher->search_center_offset = candidate_frames / 2 + (window_frames / 2 - 1);
+    stretcher->input_capacity = stretcher->search_frames * TIME_STRETCHER_INPUT_SEARCH_REGIONS;
+
+    stretcher->input = malloc(sizeof(float) * stretcher->input_capacity * channel_count);
+    stretcher->output = malloc(sizeof(float) * (window_frames + stretcher->hop_frames) * channel_count);
+    stretcher->window = malloc(sizeof(float) * window_frames);
+    stretcher->transition_window = malloc(sizeof(float) * window_frames * 2);
+    stretcher->search = malloc(sizeof(float) * stretcher->search_frames * channel_count);
+    stretcher->target = malloc(sizeof(float) * window_frames * channel_count);
+    stretcher->optimal = malloc(sizeof(float) * window_frames * channel_count);
+    stretcher->candidate_energies = malloc(sizeof(float) * candidate_frames * channel_count);
+    if (!stretcher->input || !stretcher->output || !stretcher->window || !stretcher->transition_window ||
+        !stretcher->search || !stretcher->target || !stretcher->optimal || !stretcher->candidate_energies) {
+        time_stretcher_destroy(stretcher);
+        return NULL;
+    }
+
+    time_stretcher_fill_window(stretcher->window, window_frames);
+    time_stretcher_fill_window(stretcher->transition_window, window_frames * 2);
+    time_stretcher_reset(stretcher);
+    return stretcher;
+}
+
+EXPORT void time_stretcher_destroy(TimeStretcher* stretcher) {
+    free(stretcher->input);
+    free(stretcher->output);
+    free(stretcher->window);
+    free(stretcher->transition_window);
+    free(stretcher->search);
+    free(stretcher->target);
+    free(stretcher->optimal);
+    free(stretcher->candidate_energies);
+    free(stretcher);
+}
+
+// Restarts overlap-add from the current input position, keeping buffered input.
+static void time_stretcher_reset_position(TimeStretcher* stretcher) {
+    stretcher->output_time = 0.0;
+    stretcher->target_index = 0;
+    stretcher->search_index = 0;
+    stretcher->complete_frames = 0;
+    memset(stretcher->output,
+           0,
+           sizeof(float) * (stretcher->window_frames + stretcher->hop_frames) * stretcher->channel_count);
+}
+
+EXPORT void time_stretcher_reset(TimeStretcher* stretcher) {
+    stretcher->input_start = 0;
+    stretcher->input_length = 0;
+    stretcher->flushing = 0;
+    time_stretcher_reset_position(stretcher);
+}
+
+EXPORT void time_stretcher_set_playback_rate(TimeStretcher* stretcher, double playback_rate) {
+    stretcher->playback_rate =
+        MIN(TIME_STRETCHER_MAX_PLAYBACK_RATE, MAX(TIME_STRETCHER_MIN_PLAYBACK_RATE, playback_rate));
+}
+
+EXPORT uint32_t time_stretcher_get_writable_frames(TimeStretcher* stretcher) {
+    return stretcher->input_capacity - stretcher->input_length;
+}
+
+EXPORT uint32_t time_stretcher_get_buffered_frames(TimeStretcher* stretcher) {
+    return stretcher->input_length;
+}
+
+// Renders the input that is still buffered without waiting for more. Reads return what is
+// left, after which the stretcher is reset.
+EXPORT void time_stretcher_flush(TimeStretcher* stretcher) {
+    stretcher->flushing = 1;
+}
+
+// Takes frame_count frames of planar input, planes are plane_stride floats apart. Returns
+// the number of frames that fit.
+EXPORT uint32_t time_stretcher_write(TimeStretcher* stretcher,
+                                     const float* planes,
+                                     uint32_t plane_stride,
+                                     uint32_t frame_count) {
+    const uint32_t channel_count = stretcher->channel_count;
+    frame_count = MIN(frame_count, stretcher->input_capacity - stretcher->input_length);
+    if (stretcher->input_start + stretcher->input_length + frame_count > stretcher->input_capacity) {
+        memmove(stretcher->input,
+                stretcher->input + stretcher->input_start * channel_count,
+                sizeof(float) * stretcher->input_length * channel_count);
+        stretcher->input_start = 0;
+    }
+
+    float* input = stretcher->input + (stretcher->input_start + stretcher->input_length) * channel_count;
+    for (uint32_t ch = 0; ch < channel_count; ++ch) {
+        const float* plane = planes + ch * plane_stride;
+        for (uint32_t i = 0; i < frame_count; ++i) {
+            input[i * channel_count + ch] = plane[i];
+        }
+    }
+    stretcher->input_length += frame_count;
+    return frame_count;
+}
+
+static void time_stretcher_consume_input(TimeStretcher* stretcher, uint32_t frame_count) {
+    stretcher->input_start += frame_count;
+    stretcher->input_length -= frame_count;
+}
+
+// Copies frame_count frames starting from index, frames outside of the buffered ones are silence.
+static void time_stretcher_peek(const TimeStretcher* stretcher, int32_t index, uint32_t frame_count, float* output) {
+    const uint32_t channel_count = stretcher->channel_count;
+    uint32_t silent_frames = 0;
+    if (index < 0) {
+        silent_frames = MIN(frame_count, (uint32_t)-index);
+        memset(output, 0, sizeof(float) * silent_frames * channel_count);
+        index = 0;
+    }
+    const uint32_t available_frames =
+        (uint32_t)index < stretcher->input_length ? stretcher->input_length - (uint32_t)index : 0;
+    const uint32_t copied_frames = MIN(frame_count - silent_frames, available_frames);
+    memcpy(output + silent_frames * channel_count,
+           stretcher->input + (stretcher->input_start + index) * channel_count,
+           sizeof(float) * copied_frames * channel_count);
+    memset(output + (silent_frames + copied_frames) * channel_count,
+           0,
+           sizeof(float) * (frame_count - silent_frames - copied_frames) * channel_count);
+}
+
+// Dot products of frame_count frames of a and b, one per channel.
+static void time_stretcher_dot_products(const float* a,
+                                        const float* b,
+                                        uint32_t frame_count,
+                                        uint32_t channel_count,
+                                        float* dot_products) {
+    if (channel_count == 1) {
+        f32x4 sum = f32x4_splat(0.0f);
+        uint32_t i = 0;
+        for (; i + 4 <= frame_count; i += 4) {
+            sum += f32x4_load(a + i) * f32x4_load(b + i);
+        }
+        float result = f32x4_horizontal_sum(sum);
+        for (; i < frame_count; ++i) {
+            result += a[i] * b[i];
+        }
+        dot_products[0] = result;
+    } else if (channel_count == 2) {
+        // Two frames per vector, lanes 0 and 2 are the left channel.
+        const uint32_t length = frame_count * 2;
+        f32x4 sum = f32x4_splat(0.0f);
+        uint32_t i = 0;
+        for (; i + 4 <= length; i += 4) {
+            sum += f32x4_load(a + i) * f32x4_load(b + i);
+        }
+        float left = sum[0] + sum[2];
+        float right = sum[1] + sum[3];
+        for (; i < length; i += 2) {
+            left += a[i] * b[i];
+            right += a[i + 1] * b[i + 1];
+        }
+        dot_products[0] = left;
+        dot_products[1] = right;
+    } else {
+        for (uint32_t ch = 0; ch < channel_count; ++ch) {
+            dot_products[ch] = 0.0f;
+        }
+        for (uint32_t i = 0; i < frame_count; ++i) {
+            for (uint32_t ch = 0; ch < channel_count; ++ch) {
+                dot_products[ch] += a[i * channel_count + ch] * b[i * channel_count + ch];
+            }
+        }
+    }
+}
+
+// Energy of every block_frames long block of input, blocks starting at each frame.
+static void time_stretcher_moving_block_energies(const float* input,
+                                                 uint32_t input_frames,
+                                                 uint32_t block_frames,
+                                                 uint32_t channel_count,
+                                                 float* energies) {
+    const uint32_t blocks = input_frames - (block_frames - 1);
+    time_stretcher_dot_products(input, input, block_frames, channel_count, energies);
+    for (uint32_t ch = 0; ch < channel_count; ++ch) {
+        for (uint32_t n = 1; n < blocks; ++n) {
+            const float slide_out = input[(n - 1) * channel_count + ch];
+            const float slide_in = input[(n - 1 + block_frames) * channel_count + ch];
+            energies[n * channel_count + ch] =
+                energies[(n - 1) * channel_count + ch] - slide_out * slide_out + slide_in * slide_in;
+        }
+    }
+}
+
+typedef struct {
+    const TimeStretcher* stretcher;
+    float target_energies[TIME_STRETCHER_MAX_CHANNELS];
+    int32_t exclude_start;
+    int32_t exclude_end;
+} TimeStretcherSearch;
+
+// Normalized cross-correlation of the target and the candidate starting at index.
+static float time_stretcher_similarity(const TimeStretcherSearch* search, uint32_t index) {
+    const TimeStretcher* stretcher = search->stretcher;
+    const uint32_t channel_count = stretcher->channel_count;
+    const float* candidate_energies = stretcher->candidate_energies + index * channel_count;
+    float dot_products[TIME_STRETCHER_MAX_CHANNELS];
+    time_stretcher_dot_products(stretcher->target,
+                                stretcher->search + index * channel_count,
+                                stretcher->window_frames,
+                                channel_count,
+                                dot_products);
+    float similarity = 0.0f;
+    for (uint32_t ch = 0; ch < channel_count; ++ch) {
+        const float energy = search->target_energies[ch] * candidate_energies[ch];
+        similarity += dot_products[ch] / sqrtf(MAX(0.0f, energy) + 1e-12f);
+    }
+    return similarity;
+}
+
+static int time_stretcher_is_excluded(const TimeStretcherSearch* search, int32_t index) {
+    return index >= search->exclude_start && index <= search->exclude_end;
+}
+
+// Compares every decimationth candidate and refines local maxima with a parabola through
+// three neighbouring similarities.
+static uint32_t time_stretcher_decimated_search(const TimeStretcherSearch* search, uint32_t decimation) {
+    const uint32_t candidate_frames = search->stretcher->candidate_frames;
+    float similarity[3];
+    uint32_t n = 0;
+    similarity[0] = time_stretcher_similarity(search, n);
+    float best_similarity = similarity[0];
+    uint32_t optimal_index = 0;
+
+    n += decimation;
+    if (n >= candidate_frames) {
+        return 0;
+    }
+    similarity[1] = time_stretcher_similarity(search, n);
+    n += decimation;
+    if (n >= candidate_frames) {
+        return similarity[1] > similarity[0] ? decimation : 0;
+    }
+
+    for (; n < candidate_frames; n += decimation) {
+        similarity[2] = time_stretcher_similarity(search, n);
+        if ((similarity[1] > similarity[0] && similarity[1] >= similarity[2]) ||
+            (similarity[1] >= similarity[0] && similarity[1] > similarity[2])) {
+            const float a = 0.5f * (similarity[2] + similarity[0]) - similarity[1];
+            const float b = 0.5f * (similarity[2] - similarity[0]);
+            float normalized_index = 0.0f;
+            float candidate_similarity = similarity[1];
+            if (a != 0.0f) {
+                normalized_index = -b / (2.0f * a);
+                candidate_similarity = a * normalized_index * normalized_index + b * normalized_index + similarity[1];
+            }
+            const int32_t candidate_index = (int32_t)(n - decimation) + (int32_t)(normalized_index * decimation + 0.5f);
+            if (candidate_similarity > best_similarity && !time_stretcher_is_excluded(search, candidate_index)) {
+                optimal_index = candidate_index;
+                best_similarity = candidate_similarity;
+            }
+        } else if (n + decimation >= candidate_frames && similarity[2] > best_similarity &&
+                   !time_stretcher_is_excluded(search, n)) {
+            optimal_index = n;
+            best_similarity = similarity[2];
+        }
+        similarity[0] = similarity[1];
+        similarity[1] = similarity[2];
+    }
+    return optimal_index;
+}
+
+static uint32_t time_stretcher_full_search(const TimeStretcherSearch* search, uint32_t low, uint32_t high) {
+    float best_similarity = FLT_MIN;
+    uint32_t optimal_index = 0;
+    for (uint32_t n = low; n <= high; ++n) {
+        if (time_stretcher_is_excluded(search, n)) {
+            continue;
+        }
+        const float similarity = time_stretcher_similarity(search, n);
+        if (similarity > best_similarity) {
+            best_similarity = similarity;
+            optimal_index = n;
+        }
+    }
+    return optimal_index;
+}
+
+static uint32_t time_stretcher_optimal_index(const TimeStretcher* stretcher,
+                                             int32_t exclude_start,
+                                             int32_t exclude_end) {
+    const uint32_t channel_count = stretcher->channel_count;
+    TimeStretcherSearch search;
+    search.stretcher = stretcher;
+    search.exclude_start = exclude_start;
+    search.exclude_end = exclude_end;
+    time_stretcher_moving_block_energies(stretcher->search,
+                                         stretcher->search_frames,
+                                         stretcher->window_frames,
+                                         channel_count,
+                                         stretcher->candidate_energies);
+    time_stretcher_dot_products(
+        stretcher->target, stretcher->target, stretcher->window_frames, channel_count, search.target_energies);
+
+    const uint32_t decimation = TIME_STRETCHER_SEARCH_DECIMATION;
+    const uint32_t coarse_index = time_stretcher_decimated_search(&search, decimation);
+    const uint32_t low = coarse_index > decimation ? coarse_index - decimation : 0;
+    const uint32_t high = MIN(stretcher->candidate_frames - 1, coarse_index + decimation);
+    return time_stretcher_full_search(&search, low, high);
+}
+
+static void time_stretcher_update_output_time(TimeStretcher* stretcher, double time_change) {
+    stretcher->output_time += time_change;
+    const int32_t search_center_index = (int32_t)(stretcher->output_time * stretcher->playback_rate + 0.5);
+    stretcher->search_index = search_center_index - stretcher->search_center_offset;
+}
+
+static int time_stretcher_can_iterate(const TimeStretcher* stretcher) {
+    const int64_t input_length = stretcher->input_length;
+    if (stretcher->flushing) {
+        // Until the output has caught up with the last input frame.
+        return (int64_t)stretcher->search_index + stretcher->search_center_offset < input_length;
+    }
+    return (int64_t)stretcher->target_index + stretcher->window_frames <= input_length &&
+           (int64_t)stretcher->search_index + stretcher->search_frames <= input_length;
+}
+
+// Picks the block that continues the previous output best, crossfaded with the natural
+// continuation so that the transition stays smooth.
+static void time_stretcher_get_optimal_block(TimeStretcher* stretcher) {
+    const uint32_t channel_count = stretcher->channel_count;
+    const uint32_t window_frames = stretcher->window_frames;
+    int32_t optimal_index;
+
+    if (stretcher->target_index >= stretcher->search_index &&
+        stretcher->target_index + window_frames <= stretcher->search_index + stretcher->search_frames) {
+        optimal_index = stretcher->target_index;
+        time_stretcher_peek(stretcher, optimal_index, window_frames, stretcher->optimal);
+    } else {
+        time_stretcher_peek(stretcher, stretcher->target_index, window_frames, stretcher->target);
+        time_stretcher_peek(stretcher, stretcher->search_index, stretcher->search_frames, stretcher->search);
+        const int32_t last_optimal_index =
+            stretcher->target_index - (int32_t)stretcher->hop_frames - stretcher->search_index;
+        optimal_index = stretcher->search_index +
+                        (int32_t)time_stretcher_optimal_index(stretcher,
+                                                              last_optimal_index - TIME_STRETCHER_EXCLUDE_FRAMES / 2,
+                                                              last_optimal_index + TIME_STRETCHER_EXCLUDE_FRAMES / 2);
+        time_stretcher_peek(stretcher, optimal_index, window_frames, stretcher->optimal);
+
+        const float* fade_in = stretcher->transition_window;
+        const float* fade_out = stretcher->transition_window + window_frames;
+        for (uint32_t n = 0; n < window_frames; ++n) {
+            for (uint32_t ch = 0; ch < channel_count; ++ch) {
+                const uint32_t i = n * channel_count + ch;
+                stretcher->optimal[i] = stretcher->optimal[i] * fade_in[n] + stretcher->target[i] * fade_out[n];
+            }
+        }
+    }
+    stretcher->target_index = optimal_index + stretcher->hop_frames;
+}
+
+static void time_stretcher_iterate(TimeStretcher* stretcher) {
+    const uint32_t channel_count = stretcher->channel_count;
+    const uint32_t hop_frames = stretcher->hop_frames;
+    const float* window = stretcher->window;
+    time_stretcher_get_optimal_block(stretcher);
+
+    float* output = stretcher->output + stretcher->complete_frames * channel_count;
+    const float* optimal = stretcher->optimal;
+    for (uint32_t n = 0; n < hop_frames; ++n) {
+        for (uint32_t ch = 0; ch < channel_count; ++ch) {
+            const uint32_t i = n * channel_count + ch;
+            const uint32_t j = (n + hop_frames) * channel_count + ch;
+            output[i] = output[i] * window[hop_frames + n] + optimal[i] * window[n];
+            output[j] = optimal[j];
+        }
+    }
+    stretcher->complete_frames += hop_frames;
+    time_stretcher_update_output_time(stretcher, hop_frames);
+
+    // Drops input that no longer can be a target or a search candidate.
+    // While flushing the search can run past the end of the input.
+    const int32_t earliest_used_index =
+        MIN(MIN(stretcher->target_index, stretcher->search_index), (int32_t)stretcher->input_length);
+    if (earliest_used_index > 0) {
+        time_stretcher_consume_input(stretcher, earliest_used_index);
+        stretcher->target_index -= earliest_used_index;
+        time_stretcher_update_output_time(stretcher, -(double)earliest_used_index / stretcher->playback_rate);
+    }
+}
+
+static uint32_t time_stretcher_read_complete_frames(TimeStretcher* stretcher,
+                                                    float* planes,
+                                                    uint32_t plane_stride,
+                                                    uint32_t frame_count) {
+    const uint32_t channel_count = stretcher->channel_count;
+    const uint32_t frames = MIN(frame_count, stretcher->complete_frames);
+    if (frames == 0) {
+        return 0;
+    }
+    for (uint32_t ch = 0; ch < channel_count; ++ch) {
+        float* plane = planes + ch * plane_stride;
+        for (uint32_t i = 0; i < frames; ++i) {
+            plane[i] = stretcher->output[i * channel_count + ch];
+        }
+    }
+    const uint32_t output_frames = stretcher->window_frames + stretcher->hop_frames;
+    memmove(stretcher->output,
+            stretcher->output + frames * channel_count,
+            sizeof(float) * (output_frames - frames) * channel_count);
+    stretcher->complete_frames -= frames;
+    return frames;
+}
+
+// Renders up to frame_count frames of planar output, planes are plane_stride floats apart.
+// Returns fewer frames when more input is needed.
+EXPORT uint32_t time_stretcher_read(TimeStretcher* stretcher,
+                                    float* planes,
+                                    uint32_t plane_stride,
+                                    uint32_t frame_count) {
+    const uint32_t channel_count = stretcher->channel_count;
+    uint32_t rendered = 0;
+
+    while (rendered < frame_count) {
+        rendered +=
+            time_stretcher_read_complete_frames(stretcher, planes + rendered, plane_stride, frame_count - rendered);
+        if (rendered == frame_count) {
+            break;
+        }
+
+        if (stretcher->playback_rate == 1.0) {
+            // Input is passed through as is, overlap-add starts over when the rate changes again.
+            const uint32_t frames = MIN(frame_count - rendered, stretcher->input_length);
+            const float* input = stretcher->input + stretcher->input_start * channel_count;
+            for (uint32_t ch = 0; ch < channel_count; ++ch) {
+                float* plane = planes + ch * plane_stride + rendered;
+                for (uint32_t i = 0; i < frames; ++i) {
+                    plane[i] = input[i * channel_count + ch];
+                }
+            }
+            time_stretcher_consume_input(stretcher, frames);
+            time_stretcher_reset_position(stretcher);
+            rendered += frames;
+            if (stretcher->flushing && stretcher->input_length == 0) {
+                stretcher->flushing = 0;
+            }
+            break;
+        }
+
+        if (!time_stretcher_can_iterate(stretcher)) {
+            if (stretcher->flushing) {
+                // Everything has been rendered, the rest of the overlap is past the end.
+                time_stretcher_reset(stretcher);
+            }
+            break;
+        }
+        time_stretcher_iterate(stretcher);
+    }
+    return rendered;
+}
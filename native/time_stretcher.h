@@ -0,0 +1,79 @@
+#ifndef TIME_STRETCHER_H
+#define TIME_STRETCHER_H
+
+#include <simd.h>
+#include <math.h>
+
+// Waveform similarity overlap-add (WSOLA), after Chromium's audio_renderer_algorithm.
+// Output is built from windows of input, each picked from around where the playback rate
+// says it should come from so that it continues the previous window most similarly.
+#define TIME_STRETCHER_MAX_CHANNELS 8
+// Only a guard for the buffer sizes, JS clamps the rate to MIN_PLAYBACK_RATE and
+// MAX_PLAYBACK_RATE of shared/src/audio.ts.
+#define TIME_STRETCHER_MIN_PLAYBACK_RATE 0.5
+#define TIME_STRETCHER_MAX_PLAYBACK_RATE 4.0
+#define TIME_STRETCHER_SEARCH_INTERVAL_SECONDS 0.03
+#define TIME_STRETCHER_WINDOW_SIZE_SECONDS 0.02
+// Every SEARCH_DECIMATIONth candidate is compared first, then every candidate around the best one.
+#define TIME_STRETCHER_SEARCH_DECIMATION 5
+// Candidates this close to the continuation of the previous block are skipped so that it
+// isn't repeated.
+#define TIME_STRETCHER_EXCLUDE_FRAMES 160
+// Input buffer size in search regions, enough for an iteration at the maximum playback rate.
+#define TIME_STRETCHER_INPUT_SEARCH_REGIONS 4
+
+typedef struct {
+    uint32_t channel_count;
+    double playback_rate;
+    uint32_t window_frames;
+    uint32_t hop_frames;
+    uint32_t candidate_frames;
+    uint32_t search_frames;
+    int32_t search_center_offset;
+
+    double output_time;
+    // Relative to the start of the buffered input, negative before the first input frame.
+    int32_t target_index;
+    int32_t search_index;
+
+    // Interleaved input, input_length frames starting from frame input_start.
+    float* input;
+    uint32_t input_capacity;
+    uint32_t input_start;
+    uint32_t input_length;
+    // No more input is coming, iterations read silence past the end of the input until it
+    // has all been rendered.
+    uint32_t flushing;
+
+    // Overlap-added output, complete_frames of it are ready to be read.
+    float* output;
+    uint32_t complete_frames;
+
+    float* window;
+    float* transition_window;
+    float* search;
+    float* target;
+    float* optimal;
+    float* candidate_energies;
+} TimeStretcher;
+
+EXPORT TimeStretcher* time_stretcher_create(uint32_t channel_count, uint32_t sample_rate);
+EXPORT void time_stretcher_destroy(TimeStretcher* stretcher);
+EXPORT void time_stretcher_reset(TimeStretcher* stretcher);
+EXPORT void time_stretcher_set_playback_rate(TimeStretcher* stretcher, double playback_rate);
+EXPORT uint32_t time_stretcher_get_writable_frames(TimeStretcher* stretcher);
+EXPORT uint32_t time_stretcher_get_buffered_frames(TimeStretcher* stretcher);
+EXPORT void time_stretcher_flush(TimeStretcher* stretcher);
+EXPORT uint32_t time_stretcher_write(TimeStretcher* stretcher,
+                                     const float* planes,
+                                     uint32_t plane_stride,
+                                     uint32_t frame_count);
+EXPORT uint32_t time_stretcher_read(TimeStretcher* stretcher,
+                                    float* planes,
+                                    uint32_t plane_stride,
+                                    uint32_t frame_count);
+
+static void time_stretcher_reset_position(TimeStretcher* stretcher);
+static void time_stretcher_update_output_time(TimeStretcher* stretcher, double time_change);
+
+#endif //TIME_STRETCHER_H
@@ -16,6 +16,8 @@ const exists = (path: string) => {
 const PAGE_SIZE = 65536;
 const argv = minimist(process.argv.slice(2), { string: "name" });
 const RELEASE = argv.release;
+// Pass --no-simd to build for engines without WebAssembly SIMD support.
+const SIMD = argv.simd !== false;
 const STACK_SIZE = +(argv.stackSize || argv.s) || 128 * 1024;
 const INITIAL_MEMORY = Math.ceil((+(argv.initialMemory || argv.i) || STACK_SIZE * 50) / PAGE_SIZE) * PAGE_SIZE;
 const ENTRY = argv._[0] || "native/main.c";
@@ -147,18 +149,19 @@ async function checkCMake() {
     }`;
     const oLevelClang = RELEASE ? `-Ofast` : `-O0`;
     const dDebug = RELEASE ? "0" : "1";
-    const clangFlags = `${RELEASE ? "" : ""}`;
+    const clangFlags = `${RELEASE ? "" : ""} ${SIMD ? "-msimd128" : ""}`;
+    const llcFlags = `${RELEASE ? "-O3" : ""} ${SIMD ? "-mattr=+simd128" : ""}`;
 
     await exec(
         `${clang} -std=c11 --no-standard-libraries -nostdlib++ -nostdinc -nostdlib ${clangFlags} -fvisibility=hidden -Wall -Inative/third-party -Inative/lib -Inative/lib/include -DDEBUG=${dDebug} -DSTACK_SIZE=${STACK_SIZE} -emit-llvm --target=wasm32 ${oLevelClang} "${source}" -c -o "${bcfile}"`
     );
-    await exec(`${llc} ${RELEASE ? "-O3" : ""} -filetype=obj -o "${ofile}" "${bcfile}"`);
+    await exec(`${llc} ${llcFlags} -filetype=obj -o "${ofile}" "${bcfile}"`);
     await exec(
         `${wasmld} --unresolved-symbols=import-functions -z stack-size=${STACK_SIZE} --export-dynamic --strip-all --initial-memory=${INITIAL_MEMORY} -o ${wasmfile} ${ofile}`
     );
 
     if (RELEASE) {
-        await exec(`${wasmOpt} -Oz -o ${wasmfile} ${wasmfile}`);
+        await exec(`${wasmOpt} -Oz ${SIMD ? "--enable-simd" : ""} -o ${wasmfile} ${wasmfile}`);
     }
 })().catch(e => {
     console.error(e.message);
@@ -17,6 +17,12 @@ export const MIN_SUSTAINED_AUDIO_SECONDS = 0.4;
 export const FADE_MINIMUM_VOLUME = 0.2;
 export const PRELOAD_THRESHOLD_SECONDS = 5;
 export const TIME_UPDATE_RESOLUTION = 0.1;
+export const MIN_PLAYBACK_RATE = 0.5;
+export const MAX_PLAYBACK_RATE = 4;
+
+export function normalizePlaybackRate(playbackRate: number) {
+    return Math.round(Math.min(MAX_PLAYBACK_RATE, Math.max(MIN_PLAYBACK_RATE, playbackRate)) * 20) / 20;
+}
 
 export const AudioWorkletMessage = io.type({
     type: io.literal("timeupdate"),
@@ -43,6 +49,7 @@ export interface AudioConfig {
     backgroundSab?: SharedArrayBuffer;
     sampleRate?: number;
     channelCount?: number;
+    playbackRate?: number;
 }
 
 export interface AudioBackendInitOpts extends Required<AudioConfig> {
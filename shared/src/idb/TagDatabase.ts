@@ -4,8 +4,10 @@ import { FileReference, TrackInfo } from "shared/metadata";
 import FileView from "shared/platform/FileView";
 import { typedKeys } from "shared/types/helpers";
 
-const VERSION = 28;
+const VERSION = 29;
 const DATA_WIPE_VERSION = 24;
+// Serialized loudness analyzer states written before this version can't be decoded.
+const LOUDNESS_STATE_WIPE_VERSION = 29;
 const NAME = `TagDatabase`;
 const TRACK_INFO_PRIMARY_KEY_NAME = `trackUid`;
 const TRACK_INFO_OBJECT_STORE_NAME = `trackInfo`;
@@ -23,6 +25,8 @@ const PAYLOAD_TYPE_INDEXED_DB_FILE = `indexedDBFile`;
 
 const LOUDNESS_ANALYZER_SERIALIZED_STATE_STORE_NAME = `loudnessInfo`;
 
+const LOUDNESS_HISTOGRAM_STORE_NAME = `loudnessHistogram`;
+
 interface PayloadEntry {
     payloadType: "indexedDBFile";
     file: File;
@@ -178,6 +182,9 @@ const objectStoreSpec = {
     [LOUDNESS_ANALYZER_SERIALIZED_STATE_STORE_NAME]: {
         keyPath: TRACK_INFO_PRIMARY_KEY_NAME,
     },
+    [LOUDNESS_HISTOGRAM_STORE_NAME]: {
+        keyPath: TRACK_INFO_PRIMARY_KEY_NAME,
+    },
 };
 
 export default class TagDatabase {
@@ -195,6 +202,18 @@ export default class TagDatabase {
                 for (const key of typedKeys(stores)) {
                     stores[key]!.clear();
                 }
+            } else if (event.oldVersion < LOUDNESS_STATE_WIPE_VERSION) {
+                stores[LOUDNESS_ANALYZER_SERIALIZED_STATE_STORE_NAME]!.clear();
+                stores[TRACK_INFO_OBJECT_STORE_NAME]!.openCursor().onsuccess = function () {
+                    const cursor = this.result;
+                    if (!cursor) {
+                        return;
+                    }
+                    if (cursor.value.hasInitialLoudnessInfo) {
+                        cursor.update({ ...cursor.value, hasInitialLoudnessInfo: false });
+                    }
+                    cursor.continue();
+                };
             }
         };
         void this._setHandlers();
@@ -494,6 +513,23 @@ export default class TagDatabase {
         return iDbPromisify(store.put({ trackUid, serializedState }));
     }
 
+    async getLoudnessHistogramsForTracks(trackUids: ArrayBuffer[]): Promise<Uint8Array[]> {
+        this._checkClosed();
+        const db = await this.db;
+        const tx = db.transaction(LOUDNESS_HISTOGRAM_STORE_NAME, READ_ONLY);
+        const store = tx.objectStore(LOUDNESS_HISTOGRAM_STORE_NAME);
+        const results = await Promise.all(trackUids.map(trackUid => iDbPromisify(store.get(trackUid))));
+        return results.filter(Boolean).map(result => result.histograms);
+    }
+
+    async setLoudnessHistogramsForTrack(trackUid: ArrayBuffer, histograms: Uint8Array) {
+        this._checkClosed();
+        const db = await this.db;
+        const tx = db.transaction(LOUDNESS_HISTOGRAM_STORE_NAME, READ_WRITE);
+        const store = tx.objectStore(LOUDNESS_HISTOGRAM_STORE_NAME);
+        return iDbPromisify(store.put({ trackUid, histograms }));
+    }
+
     async fileByFileReference(fileReference: FileReference) {
         this._checkClosed();
         if (fileReference instanceof File) {
@@ -614,6 +650,13 @@ export default class TagDatabase {
 
 export default interface TagDatabase {
     updateHasInitialLoudnessInfo: (trackUid: ArrayBuffer, hasInitialLoudnessInfo: boolean) => Promise<IDBValidKey>;
+    updateLoudnessStatistics: (
+        trackUid: ArrayBuffer,
+        integratedLoudness: number,
+        loudnessRange: number,
+        maxShortTermLoudness: number
+    ) => Promise<IDBValidKey>;
+    updateAudioBounds: (trackUid: ArrayBuffer, audioStart: number, audioEnd: number) => Promise<IDBValidKey>;
     updateHasBeenFingerprinted: (trackUid: ArrayBuffer, hasBeenFingerprinted: boolean) => Promise<IDBValidKey>;
     updateRating: (trackUid: ArrayBuffer, rating: number) => Promise<IDBValidKey>;
     updatePlaythroughCounter: (trackUid: ArrayBuffer, counter: number, lastPlayed: number) => Promise<IDBValidKey>;
@@ -643,6 +686,12 @@ const fieldUpdater = function (
 };
 
 TagDatabase.prototype.updateHasInitialLoudnessInfo = fieldUpdater(`hasInitialLoudnessInfo`).method;
+TagDatabase.prototype.updateLoudnessStatistics = fieldUpdater(
+    `integratedLoudness`,
+    `loudnessRange`,
+    `maxShortTermLoudness`
+).method;
+TagDatabase.prototype.updateAudioBounds = fieldUpdater(`audioStart`, `audioEnd`).method;
 TagDatabase.prototype.updateHasBeenFingerprinted = fieldUpdater(`hasBeenFingerprinted`).method;
 TagDatabase.prototype.updateRating = fieldUpdater(`rating`).method;
 TagDatabase.prototype.updatePlaythroughCounter = fieldUpdater(`playthroughCounter`, `lastPlayed`).method;
@@ -30,6 +30,14 @@ export interface AlbumArtResult extends BaseMetaDataResult {
     trackUid: ArrayBuffer;
 }
 
+export interface LoudnessOfTracksResult extends BaseMetaDataResult {
+    type: "loudnessOfTracks";
+    integratedLoudness: number;
+    loudnessRange: number;
+    requestReason: string;
+    trackUids: ArrayBuffer[];
+}
+
 export interface AcoustIdResult extends BaseMetaDataResult {
     type: "acoustId";
     trackInfo: TrackInfo;
@@ -81,6 +89,7 @@ export interface FileReferenceUnavailableResult extends BaseMetaDataResult {
 
 export type MetadataResult =
     | AlbumArtResult
+    | LoudnessOfTracksResult
     | AcoustIdResult
     | TrackMetadataResult
     | TrackInfoBatchResult
@@ -135,6 +144,7 @@ export interface MetadataManagerBackendActions<T> {
     setSkipCounter: (this: T, o: CounterOpts) => void;
     setPlaythroughCounter: (this: T, o: CounterOpts) => void;
     getAlbumArt: (this: T, o: AlbumArtOptions) => void;
+    getLoudnessOfTracks: (this: T, o: { trackUids: ArrayBuffer[]; requestReason: string }) => void;
     parseMetadata: (this: T, o: { fileReference: FileReference }) => void;
     getTrackInfoBatch: (this: T, o: { batch: ArrayBuffer[] }) => void;
     mapTrackUidsToFiles: (this: T, o: { trackUids: ArrayBuffer[] }) => void;
@@ -253,6 +263,12 @@ export interface TrackInfo extends TagData, CriticalDemuxData {
     skipCounter: number;
     hasBeenFingerprinted: boolean;
     hasInitialLoudnessInfo: boolean;
+    integratedLoudness?: number;
+    loudnessRange?: number;
+    maxShortTermLoudness?: number;
+    // Seconds from the start of the track to the first and past the last audible frame.
+    audioStart?: number;
+    audioEnd?: number;
     trackUid: ArrayBuffer;
     codecName: null | CodecName;
     autogenerated: boolean;
@@ -8,9 +8,9 @@ import ChannelMixer from "shared/worker/ChannelMixer";
 
 import { Decoder } from "./codec";
 import Crossfader from "./Crossfader";
-import Effects from "./Effects";
+import Effects, { EffectsContext } from "./Effects";
 import Fingerprinter from "./Fingerprinter";
-import LoudnessAnalyzer, { defaultLoudnessInfo, LoudnessInfo } from "./LoudnessAnalyzer";
+import LoudnessAnalyzer, { defaultLoudnessInfo, LoudnessInfo, LoudnessNormalizationGain } from "./LoudnessAnalyzer";
 import { allocChannelMixer, allocResampler, freeChannelMixer, freeResampler } from "./pool";
 import Resampler from "./Resampler";
 const dbg = debugFor("AudioProcessingPipeline");
@@ -65,15 +65,19 @@ export default class AudioProcessingPipeline {
     decoder: Decoder;
     channelMixer?: ChannelMixer;
     effects?: Effects;
+    effectsContext?: EffectsContext;
     resampler?: Resampler;
     loudnessAnalyzer?: LoudnessAnalyzer;
     loudnessNormalizer?: LoudnessAnalyzer;
     previousEndFrame: number = -1;
+    // Leading frames of effect chain output dropped so far to make up for its latency.
+    effectsLatencyCompensated: number = 0;
     fingerprinter?: Fingerprinter;
     bufferTime: number;
     targetDestinationBufferAudioFrameCount: number;
     totalDuration: number;
     crossfader?: Crossfader;
+    _normalizationGain: LoudnessNormalizationGain = { gain: 1, previousGain: -1 };
     constructor(
         wasm: WebAssemblyWrapper,
         {
@@ -101,6 +105,7 @@ export default class AudioProcessingPipeline {
         this.destinationChannelCount = destinationChannelCount;
         this.decoder = decoder;
         this.effects = effects;
+        this.effectsContext = effects ? effects.createContext() : undefined;
         this.loudnessAnalyzer = loudnessAnalyzer;
         this.loudnessNormalizer = loudnessNormalizer;
         this.fingerprinter = fingerprinter;
@@ -155,6 +160,10 @@ export default class AudioProcessingPipeline {
     }
 
     destroy() {
+        if (this.effectsContext) {
+            this.effectsContext.destroy();
+            this.effectsContext = undefined;
+        }
         if (this.resampler) {
             freeResampler(this.resampler);
             this.resampler = undefined;
@@ -167,6 +176,10 @@ export default class AudioProcessingPipeline {
 
     applySeek() {
         this.previousEndFrame = -1;
+        if (this.effectsContext) {
+            this.effectsContext.reset();
+            this.effectsLatencyCompensated = 0;
+        }
     }
 
     consumeFilledBuffer() {
@@ -248,6 +261,31 @@ export default class AudioProcessingPipeline {
         return totalBytesRead;
     }
 
+    /**
+     * Convolution and limiting delay the audio. The silence they output first is dropped
+     * so that the output stays aligned with the decoded frames, only the last frames of
+     * the track that are still in the chain when decoding ends are lost. startFrameOffset
+     * is where the remaining output starts relative to the first input frame.
+     */
+    _compensateEffectsLatency(samplePtr: number, byteLength: number) {
+        const latencyFrames = this.effectsContext!.latencyFrames;
+        let droppedFrames = 0;
+        if (latencyFrames <= this.effectsLatencyCompensated) {
+            // An effect that delays the audio was switched off and the audio skipped ahead.
+            this.effectsLatencyCompensated = latencyFrames;
+        } else {
+            const frameCount = byteLength / this.sourceChannelCount / FLOAT_BYTE_LENGTH;
+            droppedFrames = Math.min(latencyFrames - this.effectsLatencyCompensated, frameCount);
+            this.effectsLatencyCompensated += droppedFrames;
+        }
+        const droppedByteLength = droppedFrames * this.sourceChannelCount * FLOAT_BYTE_LENGTH;
+        return {
+            samplePtr: samplePtr + droppedByteLength,
+            byteLength: byteLength - droppedByteLength,
+            startFrameOffset: droppedFrames - latencyFrames,
+        };
+    }
+
     _processSamples(
         samplePtr: number,
         byteLength: number,
@@ -262,6 +300,7 @@ export default class AudioProcessingPipeline {
             destinationChannelCount,
             channelMixer,
             effects,
+            effectsContext,
             resampler,
             loudnessAnalyzer,
             loudnessNormalizer,
@@ -281,30 +320,67 @@ export default class AudioProcessingPipeline {
         }
 
         let loudnessInfo = defaultLoudnessInfo;
-        if (loudnessNormalizer) {
-            loudnessInfo = loudnessNormalizer.applyLoudnessNormalization(samplePtr, sourceFrameLength);
-        }
-
+        let outputStartFrameSourceSampleRate = startAudioFrameSourceSampleRate;
         if (effects) {
-            for (const effect of effects) {
-                ({ samplePtr, byteLength } = effect.apply(effects, samplePtr, byteLength, metadata));
+            const normalizationGain = this._normalizationGain;
+            if (loudnessNormalizer) {
+                loudnessInfo = loudnessNormalizer.analyzeLoudnessNormalization(
+                    samplePtr,
+                    sourceFrameLength,
+                    normalizationGain
+                );
+            } else {
+                normalizationGain.gain = 1;
+                normalizationGain.previousGain = -1;
+            }
+            ({ samplePtr, byteLength } = effectsContext!.process(
+                effects,
+                samplePtr,
+                byteLength,
+                metadata,
+                normalizationGain,
+                crossfader
+            ));
+            const compensated = this._compensateEffectsLatency(samplePtr, byteLength);
+            ({ samplePtr, byteLength } = compensated);
+            outputStartFrameSourceSampleRate += compensated.startFrameOffset;
+        } else {
+            if (loudnessNormalizer) {
+                loudnessInfo = loudnessNormalizer.applyLoudnessNormalization(samplePtr, sourceFrameLength);
+            }
+            if (crossfader) {
+                crossfader.apply(samplePtr, byteLength, metadata);
             }
         }
 
-        if (crossfader) {
-            crossfader.apply(samplePtr, byteLength, metadata);
-        }
-
-        let startAudioFrameDestinationSampleRate: number = startAudioFrameSourceSampleRate;
+        let startAudioFrameDestinationSampleRate: number = outputStartFrameSourceSampleRate;
+        // The decoder keeps undelivered frames right after the flushed ones, so only the
+        // resampler's output has room to upmix in place.
+        let capacityByteLength = 0;
         if (sourceSampleRate !== destinationSampleRate) {
-            ({ samplePtr, byteLength } = resampler!.resample(samplePtr, byteLength));
+            ({ samplePtr, byteLength, capacityByteLength } = resampler!.resample(
+                samplePtr,
+                byteLength,
+                destinationChannelCount
+            ));
             startAudioFrameDestinationSampleRate =
                 this.previousEndFrame === -1
-                    ? resampler!.convertInDestinationSampleRate(startAudioFrameSourceSampleRate)
+                    ? resampler!.convertInDestinationSampleRate(outputStartFrameSourceSampleRate)
                     : this.previousEndFrame;
         }
 
-        if (sourceChannelCount !== destinationChannelCount) {
+        if (
+            sourceChannelCount > destinationChannelCount ||
+            (sourceChannelCount < destinationChannelCount &&
+                capacityByteLength >= (byteLength / sourceChannelCount) * destinationChannelCount)
+        ) {
+            ({ samplePtr, byteLength } = channelMixer!.mixInPlace(
+                sourceChannelCount,
+                samplePtr,
+                byteLength,
+                Math.max(byteLength, capacityByteLength)
+            ));
+        } else if (sourceChannelCount !== destinationChannelCount) {
             ({ samplePtr, byteLength } = channelMixer!.mix(sourceChannelCount, samplePtr, byteLength));
         }
 
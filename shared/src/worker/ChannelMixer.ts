@@ -3,6 +3,7 @@ import BufferAllocator from "shared/wasm/BufferAllocator";
 import WebAssemblyWrapper, { moduleEvents } from "shared/wasm/WebAssemblyWrapper";
 
 const OUTPUT_PTR_OFFSET = 0;
+const FLOAT_BYTE_LENGTH = 4;
 
 const pointersToInstances = new Map();
 
@@ -22,7 +23,10 @@ export default class ChannelMixer extends BufferAllocator {
     }
 
     mix(inputChannelCount: ChannelCount, inputPtr: number, byteLength: number) {
-        this.channel_mixer_mix(this._ptr, inputChannelCount, inputPtr, byteLength);
+        const err = this.channel_mixer_mix(this._ptr, inputChannelCount, inputPtr, byteLength);
+        if (err) {
+            throw new Error(this.getError()!);
+        }
         const samplePtr = this._wasm.u32field(this._ptr, OUTPUT_PTR_OFFSET);
         return {
             samplePtr,
@@ -30,6 +34,62 @@ export default class ChannelMixer extends BufferAllocator {
         };
     }
 
+    /**
+     * Mixes over the input buffer itself. Downmixing always fits; upmixing needs
+     * capacityByteLength to hold the larger output.
+     */
+    mixInPlace(
+        inputChannelCount: ChannelCount,
+        samplePtr: number,
+        byteLength: number,
+        capacityByteLength: number = byteLength
+    ) {
+        const err = this.channel_mixer_mix_in_place(
+            this._ptr,
+            inputChannelCount,
+            samplePtr,
+            byteLength,
+            capacityByteLength
+        );
+        if (err) {
+            throw new Error(this.getError()!);
+        }
+        return {
+            samplePtr,
+            byteLength: Math.ceil((this.destinationChannelCount / inputChannelCount) * byteLength),
+        };
+    }
+
+    /**
+     * Replaces the built-in ITU-R BS.775 downmix with a custom matrix. Coefficients are
+     * row-major: one row of inputChannelCount gains for each destination channel.
+     */
+    setMatrix(inputChannelCount: ChannelCount, coefficients: ArrayLike<number>) {
+        const length = inputChannelCount * this.destinationChannelCount;
+        if (coefficients.length !== length) {
+            throw new Error(`expected ${length} coefficients but got ${coefficients.length}`);
+        }
+        const ptr = this._wasm.malloc(length * FLOAT_BYTE_LENGTH);
+        try {
+            this._wasm.f32view(ptr, length).set(coefficients);
+            const err = this.channel_mixer_set_matrix(this._ptr, inputChannelCount, ptr);
+            if (err) {
+                throw new Error(this.getError()!);
+            }
+        } finally {
+            this._wasm.free(ptr);
+        }
+    }
+
+    useDefaultMatrix() {
+        this.channel_mixer_use_default_matrix(this._ptr);
+    }
+
+    getError() {
+        const ptr = this.channel_mixer_get_error();
+        return ptr ? this._wasm.convertCharPToAsciiString(ptr) : null;
+    }
+
     getChannels() {
         return this.destinationChannelCount;
     }
@@ -65,9 +125,18 @@ export default interface ChannelMixer {
     channel_mixer_get_error: () => number;
     channel_mixer_get_length: (ptr: number, inputLength: number, inputChannels: ChannelCount) => number;
     channel_mixer_mix: (ptr: number, inputChannelCount: ChannelCount, inputPtr: number, byteLength: number) => number;
+    channel_mixer_mix_in_place: (
+        ptr: number,
+        inputChannelCount: ChannelCount,
+        samplePtr: number,
+        byteLength: number,
+        capacityByteLength: number
+    ) => number;
     channel_mixer_create: (inputChannelCount: ChannelCount) => number;
     channel_mixer_destroy: (ptr: number) => number;
     channel_mixer_set_output_channels: (ptr: number, channelCount: ChannelCount) => number;
+    channel_mixer_set_matrix: (ptr: number, inputChannelCount: ChannelCount, coefficientsPtr: number) => number;
+    channel_mixer_use_default_matrix: (ptr: number) => void;
 }
 
 function beforeModuleImport(_wasm: WebAssemblyWrapper, imports: WebAssembly.Imports) {
@@ -89,6 +158,13 @@ function afterInitialized(_wasm: WebAssemblyWrapper, exports: WebAssembly.Export
         inputPtr: number,
         byteLength: number
     ) => number;
+    ChannelMixer.prototype.channel_mixer_mix_in_place = exports.channel_mixer_mix_in_place as (
+        ptr: number,
+        inputChannelCount: ChannelCount,
+        samplePtr: number,
+        byteLength: number,
+        capacityByteLength: number
+    ) => number;
     ChannelMixer.prototype.channel_mixer_create = exports.channel_mixer_create as (
         inputChannelCount: ChannelCount
     ) => number;
@@ -97,6 +173,14 @@ function afterInitialized(_wasm: WebAssemblyWrapper, exports: WebAssembly.Export
         ptr: number,
         channelCount: ChannelCount
     ) => number;
+    ChannelMixer.prototype.channel_mixer_set_matrix = exports.channel_mixer_set_matrix as (
+        ptr: number,
+        inputChannelCount: ChannelCount,
+        coefficientsPtr: number
+    ) => number;
+    ChannelMixer.prototype.channel_mixer_use_default_matrix = exports.channel_mixer_use_default_matrix as (
+        ptr: number
+    ) => void;
 }
 
 moduleEvents.on(`general_beforeModuleImport`, beforeModuleImport);
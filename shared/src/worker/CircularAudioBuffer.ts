@@ -6,6 +6,8 @@ const FRAME_PTR = 4;
 const PAUSE_PTR = 5;
 const PAUSE_REQUESTED_PTR = 6;
 const IS_BACKGROUND_PTR = 7;
+const PLAYBACK_RATE_MARKER_WRITE_PTR = 8;
+const PLAYBACK_RATE_MARKER_READ_PTR = 9;
 const HEADER = [
     READ_PTR,
     WRITE_PTR,
@@ -15,8 +17,14 @@ const HEADER = [
     PAUSE_PTR,
     PAUSE_REQUESTED_PTR,
     IS_BACKGROUND_PTR,
+    PLAYBACK_RATE_MARKER_WRITE_PTR,
+    PLAYBACK_RATE_MARKER_READ_PTR,
 ];
-export const HEADER_BYTES = HEADER.length * 4;
+// Pairs of (data index, playback rate) marking where the rate of the written audio changes.
+const PLAYBACK_RATE_MARKERS = HEADER.length;
+const MAX_PLAYBACK_RATE_MARKERS = 16;
+const PLAYBACK_RATE_SCALE = 1000000;
+export const HEADER_BYTES = (HEADER.length + MAX_PLAYBACK_RATE_MARKERS * 2) * 4;
 
 export class CircularAudioBufferSignals {
     protected sab: SharedArrayBuffer;
@@ -85,10 +93,16 @@ export default class CircularAudioBuffer extends CircularAudioBufferSignals {
     protected writePtr: Int32Array;
     protected writerClearing: Int32Array;
     protected readerProcessingSamples: Int32Array;
+    protected playbackRateMarkerWritePtr: Int32Array;
+    protected playbackRateMarkerReadPtr: Int32Array;
+    protected playbackRateMarkers: Int32Array;
 
     protected data: Float32Array;
     protected capacity: number;
     private channels: number;
+    private writerPlaybackRate: number = 1;
+    private readerPlaybackRate: number = 1;
+    private sourceFramesRead: number = 0;
 
     constructor(sab: SharedArrayBuffer, channels: number) {
         super(sab);
@@ -99,6 +113,9 @@ export default class CircularAudioBuffer extends CircularAudioBufferSignals {
         this.writePtr = writePtr;
         this.readerProcessingSamples = readerProcessingSamples;
         this.writerClearing = writerClearing;
+        this.playbackRateMarkerWritePtr = new Int32Array(this.sab, PLAYBACK_RATE_MARKER_WRITE_PTR * 4, 1);
+        this.playbackRateMarkerReadPtr = new Int32Array(this.sab, PLAYBACK_RATE_MARKER_READ_PTR * 4, 1);
+        this.playbackRateMarkers = new Int32Array(this.sab, PLAYBACK_RATE_MARKERS * 4, MAX_PLAYBACK_RATE_MARKERS * 2);
         this.data = new Float32Array(this.sab, HEADER_BYTES);
         this.capacity = this.data.length;
         this.channels = channels;
@@ -159,10 +176,74 @@ export default class CircularAudioBuffer extends CircularAudioBufferSignals {
         Atomics.wait(this.readerProcessingSamples, 0, 1, 100);
         const readIndex = Atomics.load(this.readPtr, 0);
         Atomics.store(this.writePtr, 0, readIndex);
+        // Pending markers went with the cleared audio.
+        Atomics.store(this.playbackRateMarkerReadPtr, 0, Atomics.load(this.playbackRateMarkerWritePtr, 0));
+        this._markPlaybackRate(readIndex, this.writerPlaybackRate);
         Atomics.store(this.writerClearing, 0, 0);
         return 0;
     }
 
+    /**
+     * Frames written from now on play playbackRate times faster than the source audio they
+     * were stretched from. Frames that are already written keep their rate.
+     */
+    setPlaybackRate(playbackRate: number) {
+        if (playbackRate === this.writerPlaybackRate) {
+            return;
+        }
+        this.writerPlaybackRate = playbackRate;
+        this._markPlaybackRate(Atomics.load(this.writePtr, 0), playbackRate);
+    }
+
+    _markPlaybackRate(dataIndex: number, playbackRate: number) {
+        const markers = this.playbackRateMarkers;
+        const writeCount = Atomics.load(this.playbackRateMarkerWritePtr, 0);
+        const pendingCount = writeCount - Atomics.load(this.playbackRateMarkerReadPtr, 0);
+        const rate = Math.round(playbackRate * PLAYBACK_RATE_SCALE);
+        if (pendingCount > 0) {
+            const last = ((writeCount - 1) % MAX_PLAYBACK_RATE_MARKERS) * 2;
+            // Nothing was written at the previous rate, or the reader is so far behind that the
+            // audio since the last marker is counted at the new rate.
+            if (Atomics.load(markers, last) === dataIndex || pendingCount === MAX_PLAYBACK_RATE_MARKERS) {
+                Atomics.store(markers, last + 1, rate);
+                return;
+            }
+        }
+        const next = (writeCount % MAX_PLAYBACK_RATE_MARKERS) * 2;
+        Atomics.store(markers, next, dataIndex);
+        Atomics.store(markers, next + 1, rate);
+        Atomics.store(this.playbackRateMarkerWritePtr, 0, writeCount + 1);
+    }
+
+    /**
+     * Frames of source audio that the frames read since the previous call were stretched from.
+     */
+    takeSourceFramesRead() {
+        const frames = Math.floor(this.sourceFramesRead);
+        this.sourceFramesRead -= frames;
+        return frames;
+    }
+
+    _countSourceFramesRead(readIndex: number, readLength: number) {
+        const markers = this.playbackRateMarkers;
+        const writeCount = Atomics.load(this.playbackRateMarkerWritePtr, 0);
+        let readCount = Atomics.load(this.playbackRateMarkerReadPtr, 0);
+        let countedLength = 0;
+        while (readCount !== writeCount) {
+            const marker = (readCount % MAX_PLAYBACK_RATE_MARKERS) * 2;
+            const markerLength = (Atomics.load(markers, marker) - readIndex + this.capacity) % this.capacity;
+            if (markerLength >= readLength) {
+                break;
+            }
+            this.sourceFramesRead += ((markerLength - countedLength) / this.channels) * this.readerPlaybackRate;
+            countedLength = markerLength;
+            this.readerPlaybackRate = Atomics.load(markers, marker + 1) / PLAYBACK_RATE_SCALE;
+            readCount++;
+        }
+        Atomics.store(this.playbackRateMarkerReadPtr, 0, readCount);
+        this.sourceFramesRead += ((readLength - countedLength) / this.channels) * this.readerPlaybackRate;
+    }
+
     write(channels: Float32Array[], frames: number): number {
         if (channels.length !== this.channels) {
             throw new Error(`wrong channels, expected ${this.channels} got ${channels.length}`);
@@ -221,7 +302,14 @@ export default class CircularAudioBuffer extends CircularAudioBufferSignals {
         return (firstLength + secondLength) / channelCount;
     }
 
+    /**
+     * Returns -1 while the writer is clearing the buffer.
+     */
     read(channels: Float32Array[], frames: number): number {
+        if (Atomics.load(this.writerClearing, 0) === 1) {
+            return -1;
+        }
+        Atomics.store(this.readerProcessingSamples, 0, 1);
         const channelCount = channels.length;
         const readIndex = Atomics.load(this.readPtr, 0);
         const writeIndex = Atomics.load(this.writePtr, 0);
@@ -249,11 +337,14 @@ export default class CircularAudioBuffer extends CircularAudioBufferSignals {
                 }
             }
             Atomics.store(this.readPtr, 0, (readIndex + readableLength) % this.capacity);
+            this._countSourceFramesRead(readIndex, readableLength);
 
             ret = readableFrames;
         } else {
             ret = 0;
         }
+        Atomics.store(this.readerProcessingSamples, 0, 0);
+        Atomics.notify(this.readerProcessingSamples, 0, 1);
         return ret;
     }
 }
@@ -2,6 +2,11 @@ import { debugFor } from "shared/debug";
 import { ChannelCount } from "shared/metadata";
 import { CROSSFADE_MAX_DURATION } from "shared/preferences";
 import WebAssemblyWrapper, { moduleEvents } from "shared/wasm/WebAssemblyWrapper";
+import {
+    EFFECT_CHAIN_PARAM_FADE_DURATION,
+    EFFECT_CHAIN_PARAM_FADE_IN,
+    EFFECT_CHAIN_PARAM_FADE_OUT,
+} from "shared/worker/Effects";
 const dbg = debugFor("Crossfader");
 
 interface Params {
@@ -37,6 +42,12 @@ export default class Crossfader {
         this._shouldApplyFadeOut = enabled;
     }
 
+    writeChainParams(params: Float64Array) {
+        params[EFFECT_CHAIN_PARAM_FADE_DURATION] = this._duration;
+        params[EFFECT_CHAIN_PARAM_FADE_IN] = this._shouldApplyFadeIn ? 1 : 0;
+        params[EFFECT_CHAIN_PARAM_FADE_OUT] = this._shouldApplyFadeOut ? 1 : 0;
+    }
+
     apply(samplePtr: number, byteLength: number, { channelCount, duration, currentTime, sampleRate }: Params) {
         if (this._duration > 0) {
             const framesRequested = byteLength / channelCount / 4;
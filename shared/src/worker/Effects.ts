@@ -2,9 +2,45 @@ import { BandType, equalizerBands, EqualizerGains } from "shared/preferences";
 import { typedKeys } from "shared/types/helpers";
 import WebAssemblyWrapper, { moduleEvents } from "shared/wasm/WebAssemblyWrapper";
 import { ChannelCount } from "shared/worker/ChannelMixer";
+import type Crossfader from "shared/worker/Crossfader";
+import type { LoudnessNormalizationGain } from "shared/worker/LoudnessAnalyzer";
 
-const FILTER_COEFFS = 5;
-const DOUBLE_BYTE_SIZE = 8;
+// Effect chain stages and per-buffer parameter slots, see native/effects.h.
+const EFFECT_STAGE_GAIN = 0;
+const EFFECT_STAGE_NOISE_SHARPENING = 1;
+const EFFECT_STAGE_BASS_BOOST = 2;
+const EFFECT_STAGE_EQUALIZER = 3;
+const EFFECT_STAGE_CROSSFADE = 4;
+const EFFECT_STAGE_CONVOLVER = 5;
+const EFFECT_STAGE_LIMITER = 6;
+// The crossfade runs ahead of the stages that delay the audio, so that it is timed by the
+// input like every other stage and the whole output is delayed by the chain latency alike.
+const EFFECT_CHAIN_STAGES = [
+    EFFECT_STAGE_GAIN,
+    EFFECT_STAGE_NOISE_SHARPENING,
+    EFFECT_STAGE_BASS_BOOST,
+    EFFECT_STAGE_EQUALIZER,
+    EFFECT_STAGE_CROSSFADE,
+    EFFECT_STAGE_CONVOLVER,
+    EFFECT_STAGE_LIMITER,
+];
+const EFFECT_CHAIN_PARAM_CHANNEL_COUNT = 0;
+const EFFECT_CHAIN_PARAM_SAMPLE_RATE = 1;
+const EFFECT_CHAIN_PARAM_CURRENT_TIME = 2;
+const EFFECT_CHAIN_PARAM_TRACK_DURATION = 3;
+const EFFECT_CHAIN_PARAM_GAIN = 4;
+const EFFECT_CHAIN_PARAM_PREVIOUS_GAIN = 5;
+const EFFECT_CHAIN_PARAM_NOISE_SHARPENING = 6;
+const EFFECT_CHAIN_PARAM_BASS_BOOST = 7;
+export const EFFECT_CHAIN_PARAM_FADE_DURATION = 8;
+export const EFFECT_CHAIN_PARAM_FADE_IN = 9;
+export const EFFECT_CHAIN_PARAM_FADE_OUT = 10;
+const EFFECT_CHAIN_PARAM_LIMITER_CEILING = 11;
+const EFFECT_CHAIN_PARAM_LIMITER_TRUE_PEAK = 12;
+const EFFECT_CHAIN_PARAM_COUNT = 13;
+
+// Latency of the convolver, about 21 ms at 48 kHz.
+const CONVOLVER_PARTITION_FRAMES = 1024;
 
 const DEFAULT_EQUALIZER_GAINS: EqualizerGains = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
 export interface BaseEffectSpec {
@@ -24,20 +60,33 @@ export interface EqualizerEffectSpec extends BaseEffectSpec {
     name: "equalizer";
     gains: EqualizerGains;
 }
-export type EffectSpec = NoiseSharpeningEffectSpec | BassBoostEffectSpec | EqualizerEffectSpec;
-export type EffectSpecList = EffectSpec[];
 
-interface EffectApplicationResult {
-    samplePtr: number;
-    byteLength: number;
+export interface ConvolverEffectSpec extends BaseEffectSpec {
+    name: "convolver";
+    // Interleaved impulse response, or null to turn the effect off. It is resampled to the
+    // sample rate of each track, effects run before the track is resampled for output.
+    impulseResponse: Float32Array | null;
+    channelCount: 1 | 2;
+    sampleRate: number;
 }
+
+export interface LimiterEffectSpec extends BaseEffectSpec {
+    name: "limiter";
+    enabled: boolean;
+    // dBFS.
+    ceiling: number;
+    // Limits 4x oversampled peaks instead of sample peaks.
+    truePeak: boolean;
+}
+export type EffectSpec =
+    | NoiseSharpeningEffectSpec
+    | BassBoostEffectSpec
+    | EqualizerEffectSpec
+    | ConvolverEffectSpec
+    | LimiterEffectSpec;
+export type EffectSpecList = EffectSpec[];
+
 interface BaseEffectImplementation<T extends EffectSpec> {
-    apply: (
-        effects: any,
-        samplePtr: number,
-        byteLength: number,
-        audioInfo: { channelCount: ChannelCount; sampleRate: number }
-    ) => EffectApplicationResult;
     _applySpec: (spec: T | null) => void;
 }
 interface NoiseSharpeningEffectImplementation extends BaseEffectImplementation<NoiseSharpeningEffectSpec> {
@@ -47,197 +96,290 @@ interface BassBoostEffectImplementation extends BaseEffectImplementation<BassBoo
     effectSize: number;
 }
 interface EqualizerEffectImplementation extends BaseEffectImplementation<EqualizerEffectSpec> {
-    isEffective: boolean;
-    isDirty: boolean;
-    writtenForSampleRate: number;
+    version: number;
     gains: EqualizerGains;
+    _configure: (context: EffectsContext, sampleRate: number) => void;
+}
+interface ConvolverEffectImplementation extends BaseEffectImplementation<ConvolverEffectSpec> {
+    spec: ConvolverEffectSpec | null;
+    // Impulse responses created from spec by the sample rate they were resampled to.
+    impulseResponsePtrs: Map<number, number>;
+    version: number;
+    _getImpulseResponse: (sampleRate: number) => number;
+    _configure: (context: EffectsContext, sampleRate: number) => void;
+}
+interface LimiterEffectImplementation extends BaseEffectImplementation<LimiterEffectSpec> {
+    // Linear, 0 when off.
+    ceiling: number;
+    truePeak: boolean;
+}
+
+interface EffectChainAudioInfo {
+    channelCount: ChannelCount;
+    sampleRate: number;
+    currentTime: number;
+    duration: number;
 }
 
 interface EffectsMap {
     noiseSharpening: NoiseSharpeningEffectImplementation;
     bassBoost: BassBoostEffectImplementation;
     equalizer: EqualizerEffectImplementation;
+    convolver: ConvolverEffectImplementation;
+    limiter: LimiterEffectImplementation;
 }
 
-function writeBandParam(
-    type: BandType,
+const EQUALIZER_BAND_TYPES: Record<BandType, number> = {
+    lowshelf: 0,
+    highshelf: 1,
+    peaking: 2,
+};
+// Q of a shelf with slope 1, and of the peaking bands.
+const SHELF_Q = Math.SQRT1_2;
+const PEAKING_Q = Math.SQRT2;
+
+let effects_context_create: () => number;
+let effects_context_destroy: (contextPtr: number) => void;
+let effects_context_reset: (contextPtr: number) => void;
+let effects_chain_set_stages: (contextPtr: number, stagesPtr: number, stageCount: number) => number;
+let effects_chain_get_params: (contextPtr: number) => number;
+let effects_chain_process: (contextPtr: number, samplePtr: number, byteLength: number) => void;
+let effects_chain_get_latency: (contextPtr: number) => number;
+
+let effects_equalizer_set_sample_rate: (contextPtr: number, sampleRate: number) => void;
+let effects_equalizer_set_band: (
+    contextPtr: number,
+    bandIndex: number,
+    type: number,
     frequency: number,
-    gain: number,
+    q: number,
+    gain: number
+) => void;
+
+let effects_convolver_impulse_response_create: (
+    samplePtr: number,
+    frameCount: number,
+    channelCount: number,
+    impulseResponseSampleRate: number,
     sampleRate: number,
-    basePtr: number,
-    index: number,
-    wasm: WebAssemblyWrapper
-) {
-    let a0, a1, a2, b0, b1, b2;
-    const Q = Math.sqrt(2) * 1;
-    const A = Math.pow(10, gain / 40);
-    const w0 = (Math.PI * 2 * frequency) / sampleRate;
-    const S = 1;
-    const alphaS = 0.5 * Math.sin(w0) * Math.sqrt((A + 1 / A) * (1 / S - 1) + 2);
-    const alphaQ = Math.sin(w0) / (2 * Q);
-    const k = Math.cos(w0);
-    const k2 = 2 * Math.sqrt(A) * alphaS;
-    const aPlusOne = A + 1;
-    const aMinusOne = A - 1;
-    if (type === `lowshelf`) {
-        b0 = A * (aPlusOne - aMinusOne * k + k2);
-        b1 = 2 * A * (aMinusOne - aPlusOne * k);
-        b2 = A * (aPlusOne - aMinusOne * k - k2);
-        a0 = aPlusOne + aMinusOne * k + k2;
-        a1 = -2 * (aMinusOne + aPlusOne * k);
-        a2 = aPlusOne + aMinusOne * k - k2;
-    } else if (type === `highshelf`) {
-        b0 = A * (aPlusOne + aMinusOne * k + k2);
-        b1 = -2 * A * (aMinusOne + aPlusOne * k);
-        b2 = A * (aPlusOne + aMinusOne * k - k2);
-        a0 = aPlusOne - aMinusOne * k + k2;
-        a1 = 2 * (aMinusOne - aPlusOne * k);
-        a2 = aPlusOne - aMinusOne * k - k2;
-    } else {
-        b0 = 1 + alphaQ * A;
-        b1 = -2 * k;
-        b2 = 1 - alphaQ * A;
-        a0 = 1 + alphaQ / A;
-        a1 = -2 * k;
-        a2 = 1 - alphaQ / A;
-    }
+    partitionFrames: number
+) => number;
+let effects_convolver_impulse_response_release: (impulseResponsePtr: number) => void;
+let effects_convolver_set_impulse_response: (contextPtr: number, impulseResponsePtr: number) => void;
 
-    b0 /= a0;
-    b1 /= a0;
-    b2 /= a0;
-    a1 /= a0;
-    a2 /= a0;
+/**
+ * Filter memory and coefficients of one processing pipeline. Effect settings are shared
+ * through Effects, but every pipeline has its own context so that tracks processed at
+ * the same time don't disturb each other's filters.
+ */
+export class EffectsContext {
+    _wasm: WebAssemblyWrapper;
+    _ptr: number;
+    _chainParamsPtr: number;
+    equalizerVersion: number = -1;
+    equalizerSampleRate: number = 0;
+    convolverVersion: number = -1;
+    convolverSampleRate: number = 0;
+    constructor(wasm: WebAssemblyWrapper) {
+        this._wasm = wasm;
+        this._ptr = effects_context_create();
+        if (!this._ptr) {
+            throw new Error(`out of memory`);
+        }
+        this._chainParamsPtr = effects_chain_get_params(this._ptr);
+        const stagesPtr = wasm.malloc(EFFECT_CHAIN_STAGES.length);
+        wasm.u8view(stagesPtr, EFFECT_CHAIN_STAGES.length).set(EFFECT_CHAIN_STAGES);
+        const err = effects_chain_set_stages(this._ptr, stagesPtr, EFFECT_CHAIN_STAGES.length);
+        wasm.free(stagesPtr);
+        if (err) {
+            throw new Error(`invalid effect chain`);
+        }
+    }
 
-    const out = wasm.f64view(basePtr + index * FILTER_COEFFS * DOUBLE_BYTE_SIZE, FILTER_COEFFS);
-    out[0] = b0;
-    out[1] = b1;
-    out[2] = b2;
-    out[3] = a1;
-    out[4] = a2;
-}
+    /**
+     * Applies loudness normalization gain, every effect and the crossfade to the buffer
+     * in one native call, block by block.
+     */
+    process(
+        effects: Effects,
+        samplePtr: number,
+        byteLength: number,
+        audioInfo: EffectChainAudioInfo,
+        normalizationGain: LoudnessNormalizationGain,
+        crossfader?: Crossfader
+    ) {
+        const { channelCount, sampleRate, currentTime, duration } = audioInfo;
+        effects._effects.equalizer._configure(this, sampleRate);
+        effects._effects.convolver._configure(this, sampleRate);
+        const params = this._wasm.f64view(this._chainParamsPtr, EFFECT_CHAIN_PARAM_COUNT);
+        params[EFFECT_CHAIN_PARAM_CHANNEL_COUNT] = channelCount;
+        params[EFFECT_CHAIN_PARAM_SAMPLE_RATE] = sampleRate;
+        params[EFFECT_CHAIN_PARAM_CURRENT_TIME] = currentTime;
+        params[EFFECT_CHAIN_PARAM_TRACK_DURATION] = duration;
+        params[EFFECT_CHAIN_PARAM_GAIN] = normalizationGain.gain;
+        params[EFFECT_CHAIN_PARAM_PREVIOUS_GAIN] = normalizationGain.previousGain;
+        params[EFFECT_CHAIN_PARAM_NOISE_SHARPENING] = effects._effects.noiseSharpening.effectSize;
+        params[EFFECT_CHAIN_PARAM_BASS_BOOST] = effects._effects.bassBoost.effectSize;
+        params[EFFECT_CHAIN_PARAM_LIMITER_CEILING] = effects._effects.limiter.ceiling;
+        params[EFFECT_CHAIN_PARAM_LIMITER_TRUE_PEAK] = effects._effects.limiter.truePeak ? 1 : 0;
+        if (crossfader) {
+            crossfader.writeChainParams(params);
+        } else {
+            params[EFFECT_CHAIN_PARAM_FADE_DURATION] = 0;
+        }
+        effects_chain_process(this._ptr, samplePtr, byteLength);
+        return { samplePtr, byteLength };
+    }
 
-let effects_noise_sharpening: (
-    effectSize: number,
-    channelCount: ChannelCount,
-    samplePtr: number,
-    byteLength: number
-) => void;
+    /**
+     * Frames, at the sample rate of the processed audio, that the output of the last
+     * processed buffer lags its input by.
+     */
+    get latencyFrames() {
+        return effects_chain_get_latency(this._ptr);
+    }
 
-let effects_equalizer_reset: () => void;
-let effects_equalizer_apply: (
-    samplePtr: number,
-    byteLength: number,
-    channelCount: ChannelCount,
-    paramPtr: number
-) => void;
+    /**
+     * Clears filter memory, the convolver overlap and the limiter delay line so that
+     * audio from before a seek doesn't bleed into the audio after it.
+     */
+    reset() {
+        effects_context_reset(this._ptr);
+    }
 
-let effects_bass_boost_reset: () => void;
-let effects_bass_boost_apply: (
-    effectSize: number,
-    channelCount: ChannelCount,
-    samplePtr: number,
-    byteLength: number
-) => void;
+    destroy() {
+        if (this._ptr === 0) {
+            throw new Error(`not allocated`);
+        }
+        effects_context_destroy(this._ptr);
+        this._ptr = 0;
+    }
+}
 
 export default class Effects {
     _effects: EffectsMap;
     _wasm: WebAssemblyWrapper;
-    _equalizerParamPtr: number;
     constructor(wasm: WebAssemblyWrapper) {
         this._wasm = wasm;
-        this._equalizerParamPtr = wasm.malloc(FILTER_COEFFS * equalizerBands.length * DOUBLE_BYTE_SIZE);
 
         this._effects = {
             noiseSharpening: {
                 effectSize: 0,
-                apply(_effects, samplePtr, byteLength, { channelCount }) {
-                    if (this.effectSize > 0) {
-                        effects_noise_sharpening(this.effectSize, channelCount, samplePtr, byteLength);
-                    }
-                    return { samplePtr, byteLength };
-                },
-
                 _applySpec(spec: NoiseSharpeningEffectSpec | null = null) {
                     this.effectSize = spec ? spec.effectSize : 0;
                 },
             },
             bassBoost: {
                 effectSize: 0,
-                apply(_effects, samplePtr, byteLength, { channelCount }) {
-                    if (this.effectSize > 0) {
-                        effects_bass_boost_apply(this.effectSize, channelCount, samplePtr, byteLength);
-                    }
-                    return { samplePtr, byteLength };
-                },
-
                 _applySpec(spec: BassBoostEffectSpec | null = null) {
-                    effects_bass_boost_reset();
                     this.effectSize = spec ? spec.effectSize : 0;
                 },
             },
             equalizer: {
-                isEffective: false,
-                isDirty: true,
-                writtenForSampleRate: 0,
+                version: 0,
                 gains: DEFAULT_EQUALIZER_GAINS,
-                apply(
-                    this: EqualizerEffectImplementation,
-                    effects,
-                    samplePtr,
-                    byteLength,
-                    { channelCount, sampleRate }
-                ) {
-                    if (!this.isEffective) {
-                        return { samplePtr, byteLength };
+                _configure(this: EqualizerEffectImplementation, context, sampleRate) {
+                    if (context.equalizerVersion === this.version && context.equalizerSampleRate === sampleRate) {
+                        return;
+                    }
+                    effects_equalizer_set_sample_rate(context._ptr, sampleRate);
+                    const { gains } = this;
+                    for (let index = 0; index < gains.length; ++index) {
+                        const [frequency, type] = equalizerBands[index]!;
+                        effects_equalizer_set_band(
+                            context._ptr,
+                            index,
+                            EQUALIZER_BAND_TYPES[type],
+                            frequency,
+                            type === `peaking` ? PEAKING_Q : SHELF_Q,
+                            gains[index]!
+                        );
                     }
+                    context.equalizerVersion = this.version;
+                    context.equalizerSampleRate = sampleRate;
+                },
 
-                    if (this.isDirty || this.writtenForSampleRate !== sampleRate) {
-                        const { gains } = this;
-                        for (let index = 0; index < gains.length; ++index) {
-                            const gain = gains[index]!;
-                            const [frequency, type] = equalizerBands[index]!;
-                            writeBandParam(
-                                type,
-                                frequency,
-                                gain,
-                                sampleRate,
-                                effects._equalizerParamPtr,
-                                index,
-                                effects._wasm
-                            );
+                _applySpec(this: EqualizerEffectImplementation, spec: EqualizerEffectSpec | null = null) {
+                    this.gains = spec ? spec.gains : DEFAULT_EQUALIZER_GAINS;
+                    this.version++;
+                },
+            },
+            convolver: {
+                spec: null,
+                impulseResponsePtrs: new Map(),
+                version: 0,
+                _getImpulseResponse(this: ConvolverEffectImplementation, sampleRate) {
+                    const { spec } = this;
+                    if (!spec || !spec.impulseResponse || spec.impulseResponse.length === 0) {
+                        return 0;
+                    }
+                    let impulseResponsePtr = this.impulseResponsePtrs.get(sampleRate);
+                    if (impulseResponsePtr === undefined) {
+                        const { impulseResponse, channelCount } = spec;
+                        const samplePtr = wasm.malloc(impulseResponse.byteLength);
+                        wasm.f32view(samplePtr, impulseResponse.length).set(impulseResponse);
+                        impulseResponsePtr = effects_convolver_impulse_response_create(
+                            samplePtr,
+                            Math.floor(impulseResponse.length / channelCount),
+                            channelCount,
+                            spec.sampleRate,
+                            sampleRate,
+                            CONVOLVER_PARTITION_FRAMES
+                        );
+                        wasm.free(samplePtr);
+                        if (!impulseResponsePtr) {
+                            throw new Error(`invalid impulse response`);
                         }
-                        this.isDirty = false;
-                        this.writtenForSampleRate = sampleRate;
+                        this.impulseResponsePtrs.set(sampleRate, impulseResponsePtr);
                     }
+                    return impulseResponsePtr;
+                },
 
-                    effects_equalizer_apply(samplePtr, byteLength, channelCount, effects._equalizerParamPtr);
-                    return { samplePtr, byteLength };
+                _configure(this: ConvolverEffectImplementation, context, sampleRate) {
+                    if (context.convolverVersion === this.version && context.convolverSampleRate === sampleRate) {
+                        return;
+                    }
+                    // Contexts hold their own reference, so the previous impulse response is
+                    // freed once the last context has switched over.
+                    effects_convolver_set_impulse_response(context._ptr, this._getImpulseResponse(sampleRate));
+                    context.convolverVersion = this.version;
+                    context.convolverSampleRate = sampleRate;
                 },
 
-                _applySpec(this: EqualizerEffectImplementation, spec: EqualizerEffectSpec | null = null) {
+                _applySpec(this: ConvolverEffectImplementation, spec: ConvolverEffectSpec | null = null) {
+                    for (const impulseResponsePtr of this.impulseResponsePtrs.values()) {
+                        effects_convolver_impulse_response_release(impulseResponsePtr);
+                    }
+                    this.impulseResponsePtrs.clear();
+                    this.spec = spec;
+                    this.version++;
+                    if (spec) {
+                        // Fails early on an invalid impulse response.
+                        this._getImpulseResponse(spec.sampleRate);
+                    }
+                },
+            },
+            limiter: {
+                // Off until configured, the lookahead delays the output.
+                ceiling: 0,
+                truePeak: false,
+                _applySpec(spec: LimiterEffectSpec | null = null) {
                     if (!spec) {
-                        this.gains = DEFAULT_EQUALIZER_GAINS;
-                        this.isEffective = false;
+                        this.ceiling = 0;
+                        this.truePeak = false;
                     } else {
-                        const { gains } = spec;
-                        this.gains = gains;
-                    }
-                    const gains = this.gains;
-                    let isEffective = false;
-                    for (let i = 0; i < gains.length; ++i) {
-                        if (gains[i] !== 0) {
-                            isEffective = true;
-                            break;
-                        }
+                        this.ceiling = spec.enabled ? Math.pow(10, Math.min(0, spec.ceiling) / 20) : 0;
+                        this.truePeak = spec.truePeak;
                     }
-                    this.isEffective = isEffective;
-                    effects_equalizer_reset();
-                    this.isDirty = true;
                 },
             },
         };
     }
 
+    createContext() {
+        return new EffectsContext(this._wasm);
+    }
+
     *[Symbol.iterator]() {
         for (const key of typedKeys(this._effects)) {
             yield this._effects[key];
@@ -256,17 +398,30 @@ export default class Effects {
                 case "noise-sharpening":
                     this._effects.noiseSharpening._applySpec(specEffect);
                     break;
+                case "convolver":
+                    this._effects.convolver._applySpec(specEffect);
+                    break;
+                case "limiter":
+                    this._effects.limiter._applySpec(specEffect);
+                    break;
             }
         }
     }
 }
 
 function afterInitialized(_wasm: WebAssemblyWrapper, exports: WebAssembly.Exports) {
-    effects_noise_sharpening = exports.effects_noise_sharpening as any;
-    effects_equalizer_apply = exports.effects_equalizer_apply as any;
-    effects_equalizer_reset = exports.effects_equalizer_reset as any;
-    effects_bass_boost_reset = exports.effects_bass_boost_reset as any;
-    effects_bass_boost_apply = exports.effects_bass_boost_apply as any;
+    effects_context_create = exports.effects_context_create as any;
+    effects_context_destroy = exports.effects_context_destroy as any;
+    effects_context_reset = exports.effects_context_reset as any;
+    effects_chain_set_stages = exports.effects_chain_set_stages as any;
+    effects_chain_get_params = exports.effects_chain_get_params as any;
+    effects_chain_process = exports.effects_chain_process as any;
+    effects_chain_get_latency = exports.effects_chain_get_latency as any;
+    effects_equalizer_set_sample_rate = exports.effects_equalizer_set_sample_rate as any;
+    effects_equalizer_set_band = exports.effects_equalizer_set_band as any;
+    effects_convolver_impulse_response_create = exports.effects_convolver_impulse_response_create as any;
+    effects_convolver_impulse_response_release = exports.effects_convolver_impulse_response_release as any;
+    effects_convolver_set_impulse_response = exports.effects_convolver_set_impulse_response as any;
 }
 
 moduleEvents.on(`general_afterInitialized`, afterInitialized);
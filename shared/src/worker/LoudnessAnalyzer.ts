@@ -8,16 +8,41 @@ const MAX_HISTORY_MS = 30000;
 const FLOAT_BYTE_SIZE = 4;
 const SILENCE_THRESHOLD = -65;
 const MOMENTARY_WINDOW_MS = 400;
-const OVERLAP_MS = 100;
 const MAX_GAIN_OFFSET = 12;
 const REFERENCE_LUFS = -18.0;
 
-const MAX_HISTORY_OFFSET = 0;
-const SAMPLE_RATE_OFFSET = 1;
-const CHANNELS_OFFSET = 2;
-const FRAMES_ADDED_OFFSET = 3;
-const SAMPLE_PEAK_OFFSET = 3;
-const INTEGRATED_LOUDNESS_OFFSET = 4;
+// Byte offsets of the serialized state header, see loudness_analyzer.h.
+const STATE_VERSION = 2;
+const STATE_HEADER_SIZE = 24;
+const VERSION_OFFSET = 0;
+const CHANNELS_OFFSET = 1;
+const SAMPLE_RATE_OFFSET = 4;
+const MAX_HISTORY_OFFSET = 8;
+const FRAMES_ADDED_OFFSET = 12;
+const INTEGRATED_LOUDNESS_OFFSET = 16;
+const TRUE_PEAK_OFFSET = 18;
+const SERIALIZED_LOUDNESS_STEPS = 100;
+const SERIALIZED_LOUDNESS_SILENT = -32768;
+
+const deserializeLoudness = function (value: number) {
+    return value === SERIALIZED_LOUDNESS_SILENT ? -Infinity : value / SERIALIZED_LOUDNESS_STEPS;
+};
+
+export interface LoudnessNormalizationGain {
+    gain: number;
+    previousGain: number;
+}
+
+export interface LoudnessStatistics {
+    integratedLoudness: number;
+    loudnessRange: number;
+    maxShortTermLoudness: number;
+}
+
+export interface MergedLoudness {
+    integratedLoudness: number;
+    loudnessRange: number;
+}
 
 export const defaultLoudnessInfo: LoudnessInfo = Object.freeze({
     isEntirelySilent: false,
@@ -55,10 +80,6 @@ export default class LoudnessAnalyzer {
         return this._framesAdded >= this._sampleRate * 3;
     }
 
-    isHistoryStateFilled() {
-        return (this._framesAdded / this._sampleRate) * 1000 >= MAX_HISTORY_MS + MOMENTARY_WINDOW_MS - OVERLAP_MS;
-    }
-
     setLoudnessNormalizationEnabled(enabled: boolean) {
         this._loudnessNormalizationEnabled = enabled;
     }
@@ -71,18 +92,74 @@ export default class LoudnessAnalyzer {
         if (!this._ptr) {
             throw new Error(`not initialized`);
         }
-        const size = this.loudness_analyzer_get_serialized_state_size();
         if (this._serializedStateHolderPtr === 0) {
-            this._serializedStateHolderPtr = this._wasm.malloc(size);
+            this._serializedStateHolderPtr = this._wasm.malloc(this.loudness_analyzer_get_serialized_state_max_size());
         }
-        const err = this.loudness_analyzer_export_state(this._ptr, this._serializedStateHolderPtr);
+        const [err, size] = this.loudness_analyzer_export_state(this._ptr, this._serializedStateHolderPtr);
         if (err) {
             throw new Error(`ebur128 error ${err}`);
         }
-        const data = this._wasm.u8view(this._serializedStateHolderPtr, size);
-        const ret = new Uint8Array(size);
-        ret.set(data);
-        return ret;
+        return this._wasm.u8view(this._serializedStateHolderPtr, size).slice();
+    }
+
+    /**
+     * Integrated loudness, loudness range and the loudest short-term (3s) loudness of
+     * everything analyzed so far.
+     */
+    getLoudnessStatistics(): LoudnessStatistics {
+        if (!this._ptr) {
+            throw new Error(`not initialized`);
+        }
+        const [err, integratedLoudness, loudnessRange, maxShortTermLoudness] =
+            this.loudness_analyzer_get_loudness_statistics(this._ptr);
+        if (err) {
+            throw new Error(`ebur128 error ${err}`);
+        }
+        return { integratedLoudness, loudnessRange, maxShortTermLoudness };
+    }
+
+    /**
+     * Compact gating and short-term block histograms of everything analyzed so far, see
+     * mergeHistograms.
+     */
+    serializeHistograms() {
+        if (!this._ptr) {
+            throw new Error(`not initialized`);
+        }
+        const ptr = this._wasm.malloc(this.loudness_analyzer_get_histograms_max_size());
+        try {
+            const size = this.loudness_analyzer_export_histograms(this._ptr, ptr);
+            return this._wasm.u8view(ptr, size).slice();
+        } finally {
+            this._wasm.free(ptr);
+        }
+    }
+
+    /**
+     * Integrated loudness and loudness range of tracks played back to back, from their
+     * serialized histograms. Doesn't need the analyzer to be initialized.
+     */
+    mergeHistograms(histograms: Uint8Array[]): MergedLoudness {
+        let size = 0;
+        for (const histogram of histograms) {
+            size += histogram.byteLength;
+        }
+        const ptr = this._wasm.malloc(Math.max(4, size));
+        try {
+            const view = this._wasm.u8view(ptr, size);
+            let offset = 0;
+            for (const histogram of histograms) {
+                view.set(histogram, offset);
+                offset += histogram.byteLength;
+            }
+            const [err, integratedLoudness, loudnessRange] = this.loudness_analyzer_merge_histograms(ptr, size);
+            if (err) {
+                throw new Error(`ebur128 error ${err}`);
+            }
+            return { integratedLoudness, loudnessRange };
+        } finally {
+            this._wasm.free(ptr);
+        }
     }
 
     addFrames(samplePtr: number, audioFrameCount: number) {
@@ -97,7 +174,28 @@ export default class LoudnessAnalyzer {
     }
 
     applyLoudnessNormalization(samplePtr: number, audioFrameCount: number): LoudnessInfo {
+        const normalizationGain = { gain: 1, previousGain: -1 };
+        const ret = this.analyzeLoudnessNormalization(samplePtr, audioFrameCount, normalizationGain);
+        const { gain, previousGain } = normalizationGain;
+        if (gain !== 1 || previousGain !== -1) {
+            this.loudness_analyzer_apply_gain(this._ptr, gain, previousGain, samplePtr, audioFrameCount);
+        }
+        return ret;
+    }
+
+    /**
+     * Feeds the frames to the analyzer and writes the gain that normalizes them into
+     * normalizationGain without applying it, for callers that apply it as part of an
+     * effect chain.
+     */
+    analyzeLoudnessNormalization(
+        samplePtr: number,
+        audioFrameCount: number,
+        normalizationGain: LoudnessNormalizationGain
+    ): LoudnessInfo {
         let err;
+        normalizationGain.gain = 1;
+        normalizationGain.previousGain = -1;
         if (!this._ptr) {
             throw new Error(`not initialized`);
         }
@@ -108,7 +206,7 @@ export default class LoudnessAnalyzer {
             return ret;
         }
 
-        let integratedLoudness: number, samplePeak: number;
+        let integratedLoudness: number, truePeak: number;
         const momentaryLoudnessValues = [];
         const momentaryWindowFrameCount = ((MOMENTARY_WINDOW_MS / 1000) * this._sampleRate) | 0;
         let framesAdded = 0;
@@ -142,7 +240,7 @@ export default class LoudnessAnalyzer {
         }
 
         if (_loudnessNormalizationEnabled) {
-            [err, integratedLoudness, samplePeak] = this.loudness_analyzer_get_loudness_and_peak(this._ptr);
+            [err, integratedLoudness, truePeak] = this.loudness_analyzer_get_loudness_and_peak(this._ptr);
             if (err) {
                 throw new Error(`ebur128 error ${err} ${samplePtr} ${audioFrameCount}`);
             }
@@ -163,14 +261,9 @@ export default class LoudnessAnalyzer {
             const loudnessValue = this._haveEnoughLoudnessData() ? integratedLoudness! : this._momentaryLoudnessAvg;
             if (loudnessValue > SILENCE_THRESHOLD) {
                 const gainOffset = Math.min(REFERENCE_LUFS - loudnessValue, MAX_GAIN_OFFSET);
-                const gain = Math.min(1 / samplePeak!, Math.pow(10, gainOffset / 20));
-                this.loudness_analyzer_apply_gain(
-                    this._ptr,
-                    gain,
-                    this._previouslyAppliedGain,
-                    samplePtr,
-                    audioFrameCount
-                );
+                const gain = Math.min(1 / truePeak!, Math.pow(10, gainOffset / 20));
+                normalizationGain.gain = gain;
+                normalizationGain.previousGain = this._previouslyAppliedGain;
                 this._previouslyAppliedGain = gain;
             }
         }
@@ -192,18 +285,25 @@ export default class LoudnessAnalyzer {
         }
     }
 
+    /**
+     * Returns false without initializing when the state was serialized by an incompatible
+     * version.
+     */
     initializeFromSerializedState(serializedState: Uint8Array) {
         if (this._ptr) {
             throw new Error(`already initialized`);
         }
-        const view = new DataView(serializedState.buffer, serializedState.byteOffset, 10 * 8);
+        if (serializedState.byteLength < STATE_HEADER_SIZE || serializedState[VERSION_OFFSET] !== STATE_VERSION) {
+            return false;
+        }
+        const view = new DataView(serializedState.buffer, serializedState.byteOffset, STATE_HEADER_SIZE);
 
-        const sampleRate = view.getUint32(SAMPLE_RATE_OFFSET * 4, true);
-        const channelCount = view.getUint32(CHANNELS_OFFSET * 4, true);
-        const framesAdded = view.getUint32(FRAMES_ADDED_OFFSET * 4, true);
-        const maxHistoryMs = view.getUint32(MAX_HISTORY_OFFSET * 4, true);
-        const integratedLoudness = view.getFloat64(INTEGRATED_LOUDNESS_OFFSET * 8, true);
-        const samplePeak = view.getFloat64(SAMPLE_PEAK_OFFSET * 8, true);
+        const channelCount = view.getUint8(CHANNELS_OFFSET);
+        const sampleRate = view.getUint32(SAMPLE_RATE_OFFSET, true);
+        const framesAdded = view.getUint32(FRAMES_ADDED_OFFSET, true);
+        const maxHistoryMs = view.getUint32(MAX_HISTORY_OFFSET, true);
+        const integratedLoudness = deserializeLoudness(view.getInt16(INTEGRATED_LOUDNESS_OFFSET, true));
+        const truePeak = Math.pow(10, deserializeLoudness(view.getInt16(TRUE_PEAK_OFFSET, true)) / 20);
 
         this._channelCount = channelCount;
         this._sampleRate = sampleRate;
@@ -213,7 +313,7 @@ export default class LoudnessAnalyzer {
         this._momentaryLoudnessAvg = integratedLoudness;
 
         const gainOffset = Math.min(REFERENCE_LUFS - integratedLoudness, MAX_GAIN_OFFSET);
-        const gain = Math.min(1 / samplePeak, Math.pow(10, gainOffset / 20));
+        const gain = Math.min(1 / truePeak, Math.pow(10, gainOffset / 20));
         this._previouslyAppliedGain = gain;
 
         {
@@ -224,18 +324,18 @@ export default class LoudnessAnalyzer {
             this._ptr = ptr;
         }
 
-        const size = this.loudness_analyzer_get_serialized_state_size();
-        if (!this._serializedStateHolderPtr) {
-            this._serializedStateHolderPtr = this._wasm.malloc(size);
-        }
-
-        this._wasm.u8view(this._serializedStateHolderPtr, size).set(serializedState);
-        {
-            const err = this.loudness_analyzer_init_from_serialized_state(this._ptr, this._serializedStateHolderPtr);
+        const size = serializedState.byteLength;
+        const statePtr = this._wasm.malloc(size);
+        try {
+            this._wasm.u8view(statePtr, size).set(serializedState);
+            const err = this.loudness_analyzer_init_from_serialized_state(this._ptr, statePtr, size);
             if (err) {
                 throw new Error(`ebur128 error ${err} ${channelCount} ${sampleRate} ${this._maxHistoryMs}`);
             }
+        } finally {
+            this._wasm.free(statePtr);
         }
+        return true;
     }
 
     initialize(channelCount: number, sampleRate: number) {
@@ -260,7 +360,8 @@ export default interface LoudnessAnalyzer {
     loudness_analyzer_destroy: (ptr: number) => void;
     loudness_analyzer_get_loudness_and_peak: (ptr: number) => [number, number, number];
     loudness_analyzer_get_momentary_loudness: (ptr: number) => [number, number];
-    loudness_analyzer_init_from_serialized_state: (ptr: number, statePtr: number) => number;
+    loudness_analyzer_get_loudness_statistics: (ptr: number) => [number, number, number, number];
+    loudness_analyzer_init_from_serialized_state: (ptr: number, statePtr: number, size: number) => number;
     loudness_analyzer_add_frames: (ptr: number, samplePtr: number, audioFrameCount: number) => number;
     loudness_analyzer_apply_gain: (
         ptr: number,
@@ -269,8 +370,11 @@ export default interface LoudnessAnalyzer {
         samplePtr: number,
         audioFrameCount: number
     ) => void;
-    loudness_analyzer_get_serialized_state_size: () => number;
-    loudness_analyzer_export_state: (ptr: number, statePtr: number) => number;
+    loudness_analyzer_get_serialized_state_max_size: () => number;
+    loudness_analyzer_export_state: (ptr: number, statePtr: number) => [number, number];
+    loudness_analyzer_get_histograms_max_size: () => number;
+    loudness_analyzer_export_histograms: (ptr: number, histogramsPtr: number) => number;
+    loudness_analyzer_merge_histograms: (histogramsPtr: number, size: number) => [number, number, number];
 }
 
 function afterInitialized(wasm: WebAssemblyWrapper, exports: WebAssembly.Exports) {
@@ -301,12 +405,42 @@ function afterInitialized(wasm: WebAssemblyWrapper, exports: WebAssembly.Exports
         `pointer`,
         `double-retval`
     );
+    LoudnessAnalyzer.prototype.loudness_analyzer_get_loudness_statistics = wasm.createFunctionWrapper(
+        {
+            name: `loudness_analyzer_get_loudness_statistics`,
+            unsafeJsStack: true,
+        },
+        `pointer`,
+        `double-retval`,
+        `double-retval`,
+        `double-retval`
+    );
+    LoudnessAnalyzer.prototype.loudness_analyzer_merge_histograms = wasm.createFunctionWrapper(
+        {
+            name: `loudness_analyzer_merge_histograms`,
+            unsafeJsStack: true,
+        },
+        `pointer`,
+        `integeru`,
+        `double-retval`,
+        `double-retval`
+    );
     LoudnessAnalyzer.prototype.loudness_analyzer_destroy = exports.loudness_analyzer_destroy as any;
     LoudnessAnalyzer.prototype.loudness_analyzer_init_from_serialized_state = exports.loudness_analyzer_init_from_serialized_state as any;
     LoudnessAnalyzer.prototype.loudness_analyzer_add_frames = exports.loudness_analyzer_add_frames as any;
     LoudnessAnalyzer.prototype.loudness_analyzer_apply_gain = exports.loudness_analyzer_apply_gain as any;
-    LoudnessAnalyzer.prototype.loudness_analyzer_get_serialized_state_size = exports.loudness_analyzer_get_serialized_state_size as any;
-    LoudnessAnalyzer.prototype.loudness_analyzer_export_state = exports.loudness_analyzer_export_state as any;
+    LoudnessAnalyzer.prototype.loudness_analyzer_get_serialized_state_max_size = exports.loudness_analyzer_get_serialized_state_max_size as any;
+    LoudnessAnalyzer.prototype.loudness_analyzer_export_state = wasm.createFunctionWrapper(
+        {
+            name: `loudness_analyzer_export_state`,
+            unsafeJsStack: true,
+        },
+        `pointer`,
+        `pointer`,
+        `integeru-retval`
+    );
+    LoudnessAnalyzer.prototype.loudness_analyzer_get_histograms_max_size = exports.loudness_analyzer_get_histograms_max_size as any;
+    LoudnessAnalyzer.prototype.loudness_analyzer_export_histograms = exports.loudness_analyzer_export_histograms as any;
 }
 
 moduleEvents.on(`general_afterInitialized`, afterInitialized);
@@ -0,0 +1,99 @@
+import { TrackMetadata } from "shared/metadata";
+import BufferAllocator from "shared/wasm/BufferAllocator";
+import WebAssemblyWrapper, { moduleEvents } from "shared/wasm/WebAssemblyWrapper";
+import LoudnessAnalyzer from "shared/worker/LoudnessAnalyzer";
+
+const ERROR_INVALID_FRAMES = -100;
+const ERROR_CHANNEL_COUNT = -101;
+
+/**
+ * Decodes an mp3 track and adds it to a LoudnessAnalyzer in one call into wasm per chunk
+ * of the file, the decoded audio never leaves wasm memory.
+ */
+export default class LoudnessScanner extends BufferAllocator {
+    _ptr: number;
+    constructor(wasm: WebAssemblyWrapper, demuxData: TrackMetadata) {
+        super(wasm);
+        const { encoderDelay, encoderPadding, paddingStartFrame, samplesPerFrame, frames } = demuxData;
+        this._ptr = this.loudness_scanner_create(
+            encoderDelay,
+            encoderPadding % samplesPerFrame,
+            paddingStartFrame,
+            frames
+        );
+        if (!this._ptr) {
+            throw new Error(`out of memory`);
+        }
+    }
+
+    /**
+     * Returns the number of bytes of src that were consumed. The rest has to be passed again
+     * followed by more of the file.
+     */
+    analyzeMp3(src: Uint8Array, loudnessAnalyzer: LoudnessAnalyzer) {
+        let srcPtr: number;
+        if (this._wasm.pointsToMemory(src)) {
+            srcPtr = src.byteOffset;
+        } else {
+            srcPtr = this.getBuffer(src.length);
+            this._wasm.u8view(srcPtr, src.length).set(src);
+        }
+        const result = this.loudness_scanner_analyze_mp3(this._ptr, srcPtr, src.length, loudnessAnalyzer._ptr);
+        if (result < 0) {
+            if (result === ERROR_INVALID_FRAMES) {
+                throw new Error(`too many invalid frames`);
+            } else if (result === ERROR_CHANNEL_COUNT) {
+                throw new Error(`channel count changed`);
+            }
+            throw new Error(`ebur128 error ${-result}`);
+        }
+        return result;
+    }
+
+    /**
+     * Frames of the track from the first audible frame up to but not including the frame after
+     * the last one, both are 0 when the whole track is silent. Only valid after the whole track
+     * has been analyzed.
+     */
+    getAudioBounds() {
+        const [, audioStart, audioEnd] = this.loudness_scanner_get_audio_bounds(this._ptr);
+        return { audioStart, audioEnd };
+    }
+
+    destroy() {
+        super.destroy();
+        if (this._ptr !== 0) {
+            this.loudness_scanner_destroy(this._ptr);
+            this._ptr = 0;
+        }
+    }
+}
+
+export default interface LoudnessScanner {
+    loudness_scanner_create: (
+        encoderDelay: number,
+        paddingFrames: number,
+        paddingStartFrame: number,
+        totalMp3Frames: number
+    ) => number;
+    loudness_scanner_destroy: (ptr: number) => void;
+    loudness_scanner_analyze_mp3: (ptr: number, srcPtr: number, srcLength: number, analyzerPtr: number) => number;
+    loudness_scanner_get_audio_bounds: (ptr: number) => [number, number, number];
+}
+
+function afterInitialized(wasm: WebAssemblyWrapper, exports: WebAssembly.Exports) {
+    LoudnessScanner.prototype.loudness_scanner_create = exports.loudness_scanner_create as any;
+    LoudnessScanner.prototype.loudness_scanner_destroy = exports.loudness_scanner_destroy as any;
+    LoudnessScanner.prototype.loudness_scanner_analyze_mp3 = exports.loudness_scanner_analyze_mp3 as any;
+    LoudnessScanner.prototype.loudness_scanner_get_audio_bounds = wasm.createFunctionWrapper(
+        {
+            name: `loudness_scanner_get_audio_bounds`,
+            unsafeJsStack: true,
+        },
+        `pointer`,
+        `integeru-retval`,
+        `integeru-retval`
+    );
+}
+
+moduleEvents.on(`general_afterInitialized`, afterInitialized);
@@ -22,6 +22,7 @@ export default class Resampler extends BufferAllocator {
     readonly quality: 3;
     _id: number;
     _ptr: number;
+    _outputChannelCount: number;
     constructor(wasm: WebAssemblyWrapper, { channels, sourceSampleRate, destinationSampleRate }: ResamplerOpts) {
         super(wasm);
         this.channelCount = channels;
@@ -30,6 +31,7 @@ export default class Resampler extends BufferAllocator {
         this.quality = 3;
         this._id = id++;
         this._ptr = 0;
+        this._outputChannelCount = channels;
     }
 
     static CacheKey(channelCount: number, sourceSampleRate: number, destinationSampleRate: number) {
@@ -51,11 +53,16 @@ export default class Resampler extends BufferAllocator {
         return Math.floor((this.destinationSampleRate / this.sourceSampleRate) * frames);
     }
 
-    resample(samplesPtr: number, byteLength: number) {
+    /**
+     * The output buffer is sized for outputChannelCount channels so that a following
+     * upmix can run in place; capacityByteLength reports the room available.
+     */
+    resample(samplesPtr: number, byteLength: number, outputChannelCount: number = this.channelCount) {
         const label = "resample";
         if (this._ptr === 0) {
             throw new Error(`start() not called`);
         }
+        this._outputChannelCount = Math.max(this.channelCount, outputChannelCount);
         const inputFramesCount = this._byteLengthToAudioFrameCount(byteLength);
         const [, outputSamplesPtr, inputFramesRead, outputAudioFramesWritten] = this.resampler_resample(
             this._ptr,
@@ -86,9 +93,14 @@ export default class Resampler extends BufferAllocator {
         return {
             samplePtr: outputSamplesPtr,
             byteLength: this._audioFrameCountToByteLength(outputAudioFramesWritten),
+            capacityByteLength: this._bufferSize,
         };
     }
 
+    _getOutputBuffer(byteLength: number) {
+        return this.getBuffer((byteLength / this.channelCount) * this._outputChannelCount);
+    }
+
     reset() {
         if (this._ptr === 0) {
             this.start();
@@ -149,7 +161,7 @@ export default interface Resampler {
 
 function beforeModuleImport(_wasm: WebAssemblyWrapper, imports: WebAssembly.Imports) {
     imports!.env!.resamplerGetBuffer = function (ptr: number, byteLength: number) {
-        return pointersToInstances.get(ptr)!.getBuffer(byteLength);
+        return pointersToInstances.get(ptr)!._getOutputBuffer(byteLength);
     };
 }
 
@@ -0,0 +1,118 @@
+import BufferAllocator from "shared/wasm/BufferAllocator";
+import WebAssemblyWrapper, { moduleEvents } from "shared/wasm/WebAssemblyWrapper";
+
+const FLOAT_BYTE_LENGTH = 4;
+
+export interface SpectrumAnalyzerOpts {
+    frameCount: number;
+    sampleRate: number;
+    maxFrequency: number;
+    baseSmoothingConstant: number;
+}
+
+/**
+ * Computes the smoothed band values of the visualizer from blocks of frameCount frames.
+ * The returned bands view wasm memory and are only valid until the next call into the module.
+ */
+export default class SpectrumAnalyzer extends BufferAllocator {
+    readonly frameCount: number;
+    _ptr: number;
+    _bandCount: number;
+    constructor(
+        wasm: WebAssemblyWrapper,
+        { frameCount, sampleRate, maxFrequency, baseSmoothingConstant }: SpectrumAnalyzerOpts
+    ) {
+        super(wasm);
+        this.frameCount = frameCount;
+        this._bandCount = 0;
+        this._ptr = this.spectrum_analyzer_create(frameCount, sampleRate, maxFrequency, baseSmoothingConstant);
+        if (!this._ptr) {
+            throw new Error(`out of memory`);
+        }
+    }
+
+    setBandCount(bandCount: number) {
+        if (bandCount === this._bandCount) {
+            return;
+        }
+        if (this.spectrum_analyzer_set_band_count(this._ptr, bandCount) !== 0) {
+            throw new Error(`invalid band count ${bandCount}`);
+        }
+        this._bandCount = bandCount;
+    }
+
+    /**
+     * Analyzes frameCount interleaved frames.
+     */
+    analyze(samples: Float32Array, channelCount: number) {
+        const length = this.frameCount * channelCount;
+        const samplesPtr = this.getBuffer(length * FLOAT_BYTE_LENGTH);
+        this._wasm.f32view(samplesPtr, length).set(samples.subarray(0, length));
+        return this._bands(this.spectrum_analyzer_analyze(this._ptr, samplesPtr, channelCount));
+    }
+
+    /**
+     * Analyzes the first frameCount frames of each channel.
+     */
+    analyzePlanar(channels: Float32Array[]) {
+        const { frameCount } = this;
+        const planesPtr = this.getBuffer(channels.length * frameCount * FLOAT_BYTE_LENGTH);
+        const planes = this._wasm.f32view(planesPtr, channels.length * frameCount);
+        for (let c = 0; c < channels.length; ++c) {
+            planes.set(channels[c]!.subarray(0, frameCount), c * frameCount);
+        }
+        return this._bands(this.spectrum_analyzer_analyze_planar(this._ptr, planesPtr, frameCount, channels.length));
+    }
+
+    /**
+     * Returns silent bands and restarts smoothing from them.
+     */
+    reset() {
+        return this._bands(this.spectrum_analyzer_reset(this._ptr));
+    }
+
+    destroy() {
+        super.destroy();
+        if (this._ptr !== 0) {
+            this.spectrum_analyzer_destroy(this._ptr);
+            this._ptr = 0;
+        }
+    }
+
+    _bands(bandsPtr: number) {
+        if (!bandsPtr) {
+            throw new Error(`band count not set or unsupported channel count`);
+        }
+        return this._wasm.f32view(bandsPtr, this._bandCount);
+    }
+}
+
+export default interface SpectrumAnalyzer {
+    spectrum_analyzer_create: (
+        frameCount: number,
+        sampleRate: number,
+        maxFrequency: number,
+        baseSmoothingConstant: number
+    ) => number;
+    spectrum_analyzer_destroy: (ptr: number) => void;
+    spectrum_analyzer_set_band_count: (ptr: number, bandCount: number) => number;
+    spectrum_analyzer_reset: (ptr: number) => number;
+    spectrum_analyzer_analyze: (ptr: number, samplesPtr: number, channelCount: number) => number;
+    spectrum_analyzer_analyze_planar: (
+        ptr: number,
+        planesPtr: number,
+        planeStride: number,
+        channelCount: number
+    ) => number;
+}
+
+function afterInitialized(_wasm: WebAssemblyWrapper, exports: WebAssembly.Exports) {
+    SpectrumAnalyzer.prototype.spectrum_analyzer_create = exports.spectrum_analyzer_create as any;
+    SpectrumAnalyzer.prototype.spectrum_analyzer_destroy = exports.spectrum_analyzer_destroy as any;
+    SpectrumAnalyzer.prototype.spectrum_analyzer_set_band_count = exports.spectrum_analyzer_set_band_count as any;
+    SpectrumAnalyzer.prototype.spectrum_analyzer_reset = exports.spectrum_analyzer_reset as any;
+    SpectrumAnalyzer.prototype.spectrum_analyzer_analyze = exports.spectrum_analyzer_analyze as any;
+    SpectrumAnalyzer.prototype.spectrum_analyzer_analyze_planar = exports.spectrum_analyzer_analyze_planar as any;
+}
+
+moduleEvents.on(`visualizer_afterInitialized`, afterInitialized);
@@ -1,482 +1,134 @@
-// Ported from Chromium
-// (https://chromium.googlesource.com/chromium/chromium/+/51ed77e3f37a9a9b80d6d0a8259e84a8ca635259/media/filters/audio_renderer_algorithm.cc)
-//
-// Copyright 2021 The Chromium Authors. All rights reserved.
-//
-// Redistribution and use in source and binary forms, with or without
-// modification, are permitted provided that the following conditions are
-// met:
-//
-//    * Redistributions of source code must retain the above copyright
-// notice, this list of conditions and the following disclaimer.
-//    * Redistributions in binary form must reproduce the above
-// copyright notice, this list of conditions and the following disclaimer
-// in the documentation and/or other materials provided with the
-// distribution.
-//    * Neither the name of Google Inc. nor the names of its
-// contributors may be used to endorse or promote products derived from
-// this software without specific prior written permission.
-//
-// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+import { normalizePlaybackRate } from "shared/audio";
+import BufferAllocator from "shared/wasm/BufferAllocator";
+import WebAssemblyWrapper, { moduleEvents } from "shared/wasm/WebAssemblyWrapper";
 
-import CircularAudioBuffer from "./CircularAudioBuffer";
-
-const SEARCH_INTERVAL_SECONDS = 0.03;
-const WINDOW_SIZE_SECONDS = 0.02;
-
-const alloced: Record<number, Float32Array> = {};
-
-function allocF32(size: number) {
-    if (!alloced[size]) {
-        alloced[size] = new Float32Array(size);
-        return alloced[size];
-    }
-    return alloced[size];
-}
+const FLOAT_BYTE_LENGTH = 4;
+export const TIME_STRETCHER_CHUNK_FRAMES = 2048;
 
 export interface TimeStretcherOpts {
     channelCount: number;
     sampleRate: number;
-    playbackRate: number;
 }
 
-export default class TimeStretcher extends CircularAudioBuffer {
-    private outputTime: number = 0;
-    private playbackRate: number;
-    private candidateFrames: number;
-    private windowSize: number;
-    private window: Float32Array;
-    private transitionWindow: Float32Array;
-    private output: Float32Array;
-    private search: Float32Array;
-    private target: Float32Array;
-    private optimal: Float32Array;
-    private targetIndexFrames: number = 0;
-    private searchIndexFrames: number = 0;
-    private hopSize: number;
-    private completeFrames: number;
-    private searchCenterOffset: number;
-    private searchSizeFrames: number;
-
-    constructor(sab: SharedArrayBuffer, { channelCount, sampleRate, playbackRate }: TimeStretcherOpts) {
-        super(sab, channelCount);
-        this.playbackRate = playbackRate;
-        this.candidateFrames = Math.round(SEARCH_INTERVAL_SECONDS * sampleRate);
-        this.windowSize = Math.round(WINDOW_SIZE_SECONDS * sampleRate);
-        if (this.windowSize % 2 !== 0) {
-            this.windowSize++;
-        }
-        this.completeFrames = 0;
-        this.hopSize = this.windowSize / 2;
-        this.output = new Float32Array((this.windowSize + this.hopSize) * channelCount);
-        this.searchCenterOffset = this.candidateFrames / 2 + (this.windowSize / 2 - 1);
-        this.searchSizeFrames = this.candidateFrames + (this.windowSize - 1);
-        this.search = new Float32Array(this.searchSizeFrames * channelCount);
-        this.target = new Float32Array(this.windowSize * channelCount);
-        this.window = new Float32Array(this.windowSize);
-        this.transitionWindow = new Float32Array(this.windowSize * 2);
-        this.optimal = new Float32Array(this.windowSize * channelCount);
-        this._fillWindow(this.window);
-        this._fillWindow(this.transitionWindow);
-    }
-
-    get readableAudioBufferFrames() {
-        const readIndex = Atomics.load(this.readPtr, 0);
-        const writeIndex = Atomics.load(this.writePtr, 0);
-        const { capacity } = this;
-        return (
-            (writeIndex >= readIndex ? writeIndex - readIndex : capacity - readIndex + writeIndex) / this.channelCount
-        );
-    }
-
-    reset() {
-        this.completeFrames = 0;
-        this.targetIndexFrames = 0;
-        this.searchIndexFrames = 0;
-        this.outputTime = 0;
-        this.output.fill(0);
-    }
-
-    read(channels: Float32Array[], frames: number): number {
-        if (Atomics.load(this.writerClearing, 0) === 1) {
-            return -1;
-        }
-        Atomics.store(this.readerProcessingSamples, 0, 1);
-
-        let renderedFrames: number = 0;
-        if (this.playbackRate === 1) {
-            renderedFrames = super.read(channels, frames);
-        } else {
-            do {
-                renderedFrames += this.writeCompletedFramesTo(frames - renderedFrames, renderedFrames, channels);
-            } while (renderedFrames < frames && this.iterate(this.playbackRate));
+/**
+ * Tempo change without pitch change (WSOLA). Input is written and output is read as
+ * planar chunks of at most TIME_STRETCHER_CHUNK_FRAMES frames that are staged in wasm
+ * memory: one plane per channel for the input followed by one plane per channel for the
+ * output.
+ */
+export default class TimeStretcher extends BufferAllocator {
+    readonly channelCount: number;
+    readonly sampleRate: number;
+    _ptr: number;
+    _playbackRate: number;
+    constructor(wasm: WebAssemblyWrapper, { channelCount, sampleRate }: TimeStretcherOpts) {
+        super(wasm);
+        this.channelCount = channelCount;
+        this.sampleRate = sampleRate;
+        this._playbackRate = 1;
+        this._ptr = this.time_stretcher_create(channelCount, sampleRate);
+        if (!this._ptr) {
+            throw new Error(`out of memory`);
         }
-
-        Atomics.store(this.readerProcessingSamples, 0, 0);
-        Atomics.notify(this.readerProcessingSamples, 0, 1);
-        return renderedFrames;
-    }
-
-    canIterate() {
-        const { readableAudioBufferFrames, windowSize, targetIndexFrames, searchIndexFrames, searchSizeFrames } = this;
-        return (
-            targetIndexFrames + windowSize <= readableAudioBufferFrames &&
-            searchIndexFrames + searchSizeFrames <= readableAudioBufferFrames
-        );
-    }
-
-    iterate(playbackRate: number): boolean {
-        if (!this.canIterate()) {
-            return false;
-        }
-        this.getOptimalBlock();
-        const { channelCount, completeFrames, hopSize, output, window, optimal } = this;
-
-        for (let c = 0; c < channelCount; ++c) {
-            for (let n = 0; n < hopSize; ++n) {
-                output[(n + completeFrames) * channelCount + c] =
-                    output[(n + completeFrames) * channelCount + c] * window[hopSize + n] +
-                    optimal[n * channelCount + c] * window[n];
-                output[(n + completeFrames + hopSize) * channelCount + c] = optimal[(n + hopSize) * channelCount + c];
-            }
-        }
-        this.completeFrames += hopSize;
-        this.updateOutputTime(playbackRate, this.hopSize);
-        this.removeOldInputFrames(playbackRate);
-        return true;
-    }
-
-    updateOutputTime(playbackRate: number, timeChange: number) {
-        this.outputTime += timeChange;
-        const searchCenterIndex = (this.outputTime * playbackRate + 0.5) | 0;
-        this.searchIndexFrames = searchCenterIndex - this.searchCenterOffset;
     }
 
-    removeOldInputFrames(playbackRate: number) {
-        const earliestUsedIndex = Math.min(this.targetIndexFrames, this.searchIndexFrames);
-        if (earliestUsedIndex <= 0) {
-            return;
-        }
-        const readIndex = Atomics.load(this.readPtr, 0);
-        Atomics.store(this.readPtr, 0, (readIndex + earliestUsedIndex * this.channelCount) % this.capacity);
-        this.targetIndexFrames -= earliestUsedIndex;
-        const outputTimeChange = earliestUsedIndex / playbackRate;
-        this.updateOutputTime(playbackRate, -outputTimeChange);
+    get playbackRate() {
+        return this._playbackRate;
     }
 
-    getOptimalBlock() {
-        const { channelCount, target, optimal, windowSize, transitionWindow } = this;
-        let optimalIndexFrames = 0;
-        const excludeFrames = 160;
-        if (this.targetIsWithinSearchRegion()) {
-            optimalIndexFrames = this.targetIndexFrames;
-            this.peekAudioWithZeroPrepend(optimalIndexFrames, this.optimal);
-        } else {
-            this.peekAudioWithZeroPrepend(this.targetIndexFrames, this.target);
-            this.peekAudioWithZeroPrepend(this.searchIndexFrames, this.search);
-            const lastOptimalFrame = this.targetIndexFrames - this.hopSize - this.searchIndexFrames;
-            const excludeInterval: [number, number] = [
-                lastOptimalFrame - excludeFrames / 2,
-                lastOptimalFrame + excludeFrames / 2,
-            ];
-            optimalIndexFrames = getOptimalIndex(this.search, this.target, excludeInterval, channelCount);
-            optimalIndexFrames += this.searchIndexFrames;
-
-            this.peekAudioWithZeroPrepend(optimalIndexFrames, this.optimal);
-
-            for (let c = 0; c < channelCount; ++c) {
-                for (let n = 0; n < windowSize; ++n) {
-                    optimal[n * channelCount + c] =
-                        optimal[n * channelCount + c] * transitionWindow[n] +
-                        target[n * channelCount + c] * transitionWindow[n + windowSize];
-                }
-            }
-        }
-        this.targetIndexFrames = optimalIndexFrames + this.hopSize;
+    setPlaybackRate(playbackRate: number) {
+        this._playbackRate = normalizePlaybackRate(playbackRate);
+        this.time_stretcher_set_playback_rate(this._ptr, this._playbackRate);
     }
 
-    peekAudioWithZeroPrepend(readOffsetFrames: number, data: Float32Array) {
-        let writeOffset = 0;
-        let framesToRead = data.length / this.channelCount;
-        if (readOffsetFrames < 0) {
-            const zeroFramesAppended = Math.min(-readOffsetFrames, framesToRead);
-            readOffsetFrames = 0;
-            framesToRead -= zeroFramesAppended;
-            writeOffset = zeroFramesAppended;
-            data.fill(0, 0, zeroFramesAppended * this.channelCount);
-        }
-        this.peekFrames(framesToRead, readOffsetFrames, writeOffset, data);
+    /**
+     * Input frames the stretcher can take before output has to be read from it.
+     */
+    getWritableFrames() {
+        return Math.min(TIME_STRETCHER_CHUNK_FRAMES, this.time_stretcher_get_writable_frames(this._ptr));
     }
 
-    targetIsWithinSearchRegion() {
-        return (
-            this.targetIndexFrames >= this.searchIndexFrames &&
-            this.targetIndexFrames + this.windowSize <= this.searchIndexFrames + this.searchSizeFrames
-        );
+    getBufferedFrames() {
+        return this.time_stretcher_get_buffered_frames(this._ptr);
     }
 
-    writeCompletedFramesTo(frames: number, dstOffset: number, input: Float32Array[]) {
-        const { channelCount, completeFrames, output } = this;
-        const renderedFrames = Math.min(completeFrames, frames);
-        if (renderedFrames === 0) {
-            return 0;
-        }
-        for (let c = 0; c < channelCount; ++c) {
-            const inputChannel = input[c];
-            for (let i = 0; i < renderedFrames; ++i) {
-                inputChannel[i + dstOffset] = output[i * channelCount + c];
-            }
-        }
-        const framesToMove = output.length / channelCount - renderedFrames;
-        for (let c = 0; c < channelCount; ++c) {
-            for (let i = 0; i < framesToMove; ++i) {
-                output[i * channelCount + c] = output[(renderedFrames + i) * channelCount + c];
-            }
+    /**
+     * Returns the number of frames accepted, which may be less than frameCount.
+     */
+    write(channels: Float32Array[], frameCount: number) {
+        const planesPtr = this._getPlanes();
+        const frames = Math.min(frameCount, TIME_STRETCHER_CHUNK_FRAMES);
+        const planes = this._wasm.f32view(planesPtr, this.channelCount * TIME_STRETCHER_CHUNK_FRAMES);
+        for (let c = 0; c < this.channelCount; ++c) {
+            planes.set(channels[c]!.subarray(0, frames), c * TIME_STRETCHER_CHUNK_FRAMES);
         }
-        this.completeFrames -= renderedFrames;
-        return renderedFrames;
+        return this.time_stretcher_write(this._ptr, planesPtr, TIME_STRETCHER_CHUNK_FRAMES, frames);
     }
 
-    _fillWindow(window: Float32Array) {
-        const N = window.length;
-        const scale = (Math.PI * 2) / N;
-        for (let n = 0; n < N; ++n) {
-            // Hamming window.
-            window[n] = Math.fround(0.5 * Math.fround(1 - Math.fround(Math.cos(n * scale))));
+    /**
+     * Renders up to frameCount frames. The returned channels view wasm memory and are only
+     * valid until the next call into the module.
+     */
+    read(frameCount: number) {
+        const outputPtr = this._getPlanes() + this.channelCount * TIME_STRETCHER_CHUNK_FRAMES * FLOAT_BYTE_LENGTH;
+        const frames = Math.min(frameCount, TIME_STRETCHER_CHUNK_FRAMES);
+        const renderedFrames = this.time_stretcher_read(this._ptr, outputPtr, TIME_STRETCHER_CHUNK_FRAMES, frames);
+        const planes = this._wasm.f32view(outputPtr, this.channelCount * TIME_STRETCHER_CHUNK_FRAMES);
+        const channels: Float32Array[] = [];
+        for (let c = 0; c < this.channelCount; ++c) {
+            const start = c * TIME_STRETCHER_CHUNK_FRAMES;
+            channels.push(planes.subarray(start, start + renderedFrames));
         }
+        return { channels, frames: renderedFrames };
     }
 
-    updatePlaybackRate(rate: number) {
-        this.playbackRate = rate;
+    /**
+     * Lets the buffered input be read out without waiting for more input, the stretcher
+     * resets itself once it has all been read.
+     */
+    flush() {
+        this.time_stretcher_flush(this._ptr);
     }
-}
 
-function multiChannelMovingBlockEnergies(
-    input: Float32Array,
-    targetFrames: number,
-    energy: Float32Array,
-    channelCount: number
-) {
-    const blocks = input.length / channelCount - (targetFrames - 1);
-    for (let c = 0; c < channelCount; ++c) {
-        energy[c] = 0;
-        for (let m = 0; m < targetFrames; ++m) {
-            const inputSample = input[m * channelCount + c];
-            energy[c] += inputSample * inputSample;
-        }
-        let slideOut = 0;
-        let slideIn = targetFrames;
-        for (let n = 1; n < blocks; ++n, ++slideIn, ++slideOut) {
-            const slideInValue = input[slideIn * channelCount + c];
-            const slideOutValue = input[slideOut * channelCount + c];
-            energy[c + n * channelCount] =
-                energy[c + (n - 1) * channelCount] - slideOutValue * slideOutValue + slideInValue * slideInValue;
-        }
+    reset() {
+        this.time_stretcher_reset(this._ptr);
     }
-}
 
-function multiChannelDotProduct(
-    a: Float32Array,
-    aOffsetFrames: number,
-    b: Float32Array,
-    bOffsetFrames: number,
-    frameCount: number,
-    dotProduct: Float32Array,
-    channelCount: number
-) {
-    for (let c = 0; c < channelCount; ++c) {
-        dotProduct[c] = 0;
-        for (let n = 0; n < frameCount; ++n) {
-            const aValue = a[(aOffsetFrames + n) * channelCount + c];
-            const bValue = b[(bOffsetFrames + n) * channelCount + c];
-            dotProduct[c] += aValue * bValue;
+    destroy() {
+        super.destroy();
+        if (this._ptr !== 0) {
+            this.time_stretcher_destroy(this._ptr);
+            this._ptr = 0;
         }
     }
-}
 
-function multiChannelSimilarityMeasure(
-    dotProdAB: Float32Array,
-    energyA: Float32Array,
-    energyB: Float32Array,
-    energyBIndex: number,
-    channelCount: number
-): number {
-    const epsilon = 1e-12;
-    let similarityMeasure = 0;
-    for (let c = 0; c < channelCount; ++c) {
-        similarityMeasure += dotProdAB[c] / Math.sqrt(energyA[c] * energyB[c + energyBIndex] + epsilon);
+    _getPlanes() {
+        return this.getBuffer(this.channelCount * TIME_STRETCHER_CHUNK_FRAMES * 2 * FLOAT_BYTE_LENGTH);
     }
-    return similarityMeasure;
 }
 
-function inInterval(value: number, interval: [number, number]) {
-    return value >= interval[0] && value <= interval[1];
+export default interface TimeStretcher {
+    time_stretcher_create: (channelCount: number, sampleRate: number) => number;
+    time_stretcher_destroy: (ptr: number) => void;
+    time_stretcher_reset: (ptr: number) => void;
+    time_stretcher_set_playback_rate: (ptr: number, playbackRate: number) => void;
+    time_stretcher_get_writable_frames: (ptr: number) => number;
+    time_stretcher_get_buffered_frames: (ptr: number) => number;
+    time_stretcher_flush: (ptr: number) => void;
+    time_stretcher_write: (ptr: number, planesPtr: number, planeStride: number, frameCount: number) => number;
+    time_stretcher_read: (ptr: number, planesPtr: number, planeStride: number, frameCount: number) => number;
 }
 
-const similarity = new Float32Array(3);
-const dotProd = new Float32Array(10);
-let normalizedCandidateIndex: number = 0;
-let candidateSimilarity: number = 0;
-
-function quadraticInterpolation() {
-    const a = 0.5 * (similarity[2] + similarity[0]) - similarity[1];
-    const b = 0.5 * (similarity[2] - similarity[0]);
-    const c = similarity[1];
-    if (a === 0) {
-        normalizedCandidateIndex = 0;
-        candidateSimilarity = similarity[1];
-    } else {
-        normalizedCandidateIndex = -b / (2 * a);
-        candidateSimilarity =
-            a * normalizedCandidateIndex * normalizedCandidateIndex + b * normalizedCandidateIndex + c;
-    }
+function afterInitialized(_wasm: WebAssemblyWrapper, exports: WebAssembly.Exports) {
+    TimeStretcher.prototype.time_stretcher_create = exports.time_stretcher_create as any;
+    TimeStretcher.prototype.time_stretcher_destroy = exports.time_stretcher_destroy as any;
+    TimeStretcher.prototype.time_stretcher_reset = exports.time_stretcher_reset as any;
+    TimeStretcher.prototype.time_stretcher_set_playback_rate = exports.time_stretcher_set_playback_rate as any;
+    TimeStretcher.prototype.time_stretcher_get_writable_frames = exports.time_stretcher_get_writable_frames as any;
+    TimeStretcher.prototype.time_stretcher_get_buffered_frames = exports.time_stretcher_get_buffered_frames as any;
+    TimeStretcher.prototype.time_stretcher_flush = exports.time_stretcher_flush as any;
+    TimeStretcher.prototype.time_stretcher_write = exports.time_stretcher_write as any;
+    TimeStretcher.prototype.time_stretcher_read = exports.time_stretcher_read as any;
 }
 
-function decimatedSearch(
-    decimation: number,
-    excludeIntervalFrames: [number, number],
-    target: Float32Array,
-    search: Float32Array,
-    energyTargets: Float32Array,
-    energyCandidateSamples: Float32Array,
-    channelCount: number
-): number {
-    const blockSize = target.length / channelCount;
-    const candidateFrames = search.length / channelCount - (blockSize - 1);
-    let n = 0;
-    multiChannelDotProduct(target, 0, search, n, blockSize, dotProd, channelCount);
-    similarity[0] = multiChannelSimilarityMeasure(
-        dotProd,
-        energyTargets,
-        energyCandidateSamples,
-        n * channelCount,
-        channelCount
-    );
-    let bestSimilarity = similarity[0];
-    let optimalIndex = 0;
-    n += decimation;
-    if (n >= candidateFrames) {
-        return 0;
-    }
-    multiChannelDotProduct(target, 0, search, n, blockSize, dotProd, channelCount);
-    similarity[1] = multiChannelSimilarityMeasure(
-        dotProd,
-        energyTargets,
-        energyCandidateSamples,
-        n * channelCount,
-        channelCount
-    );
-    n += decimation;
-    if (n >= candidateFrames) {
-        return similarity[1] > similarity[0] ? decimation : 0;
-    }
-    for (; n < candidateFrames; n += decimation) {
-        multiChannelDotProduct(target, 0, search, n, blockSize, dotProd, channelCount);
-        similarity[2] = multiChannelSimilarityMeasure(
-            dotProd,
-            energyTargets,
-            energyCandidateSamples,
-            n * channelCount,
-            channelCount
-        );
-        if (
-            (similarity[1] > similarity[0] && similarity[1] >= similarity[2]) ||
-            (similarity[1] >= similarity[0] && similarity[1] > similarity[2])
-        ) {
-            quadraticInterpolation();
-            const candidateIndex = n - decimation + ((normalizedCandidateIndex * decimation + 0.5) | 0);
-            if (candidateIndex > bestSimilarity && !inInterval(candidateIndex, excludeIntervalFrames)) {
-                optimalIndex = candidateIndex;
-                bestSimilarity = candidateSimilarity;
-            }
-        } else if (
-            n + decimation >= candidateFrames &&
-            similarity[2] >= bestSimilarity &&
-            !inInterval(n, excludeIntervalFrames)
-        ) {
-            optimalIndex = n;
-            bestSimilarity = similarity[2];
-        }
-        similarity[0] = similarity[1];
-        similarity[1] = similarity[2];
-    }
-    return optimalIndex;
-}
-
-function fullSearch(
-    lowLimit: number,
-    highLimit: number,
-    excludeIntervalFrames: [number, number],
-    target: Float32Array,
-    search: Float32Array,
-    energyTargets: Float32Array,
-    energyCandidateSamples: Float32Array,
-    channelCount: number
-): number {
-    const blockSize = target.length / channelCount;
-    let bestSimilarity = Math.fround(1.17549e-38);
-    let optimalIndex = 0;
-    for (let n = lowLimit; n <= highLimit; ++n) {
-        if (inInterval(n, excludeIntervalFrames)) {
-            continue;
-        }
-        multiChannelDotProduct(target, 0, search, n, blockSize, dotProd, channelCount);
-        const similarity = multiChannelSimilarityMeasure(
-            dotProd,
-            energyTargets,
-            energyCandidateSamples,
-            n * channelCount,
-            channelCount
-        );
-        if (similarity > bestSimilarity) {
-            bestSimilarity = similarity;
-            optimalIndex = n;
-        }
-    }
-    return optimalIndex;
-}
-function getOptimalIndex(
-    search: Float32Array,
-    target: Float32Array,
-    excludeIntervalFrames: [number, number],
-    channelCount: number
-): number {
-    const targetFrames = target.length / channelCount;
-    const candidateFrames = search.length / channelCount - (targetFrames - 1);
-    const searchDecimation = 5;
-    const energyTargets = allocF32(channelCount);
-    const energyCandidateSamples = allocF32(channelCount * candidateFrames);
-    multiChannelMovingBlockEnergies(search, targetFrames, energyCandidateSamples, channelCount);
-    multiChannelDotProduct(target, 0, target, 0, targetFrames, energyTargets, channelCount);
-    const optimalIndex = decimatedSearch(
-        searchDecimation,
-        excludeIntervalFrames,
-        target,
-        search,
-        energyTargets,
-        energyCandidateSamples,
-        channelCount
-    );
-    const lowLimit = Math.max(0, optimalIndex - searchDecimation);
-    const highLimit = Math.min(candidateFrames - 1, optimalIndex + searchDecimation);
-    return fullSearch(
-        lowLimit,
-        highLimit,
-        excludeIntervalFrames,
-        target,
-        search,
-        energyTargets,
-        energyCandidateSamples,
-        channelCount
-    );
-}
+moduleEvents.on(`audio_afterInitialized`, afterInitialized);
@@ -59,6 +59,7 @@ const outputAssets = {
     audioWasm: `../dist/wasm/audio.${buildType}.wasm`,
     zipperWasm: `../dist/wasm/zipper.${buildType}.wasm`,
     generalWasm: `../dist/wasm/general.${buildType}.wasm`,
+    visualizerWasm: `../dist/wasm/visualizer.${buildType}.wasm`,
     generalWorker: "../dist/generalWorker.js",
     audioWorker: "../dist/audioWorker.js",
     audioWorklet: "../dist/sinkWorklet.js",
@@ -84,6 +85,7 @@ const define = {
     "process.env.AUDIO_WASM_PATH": `"${resolveWebPath(outputAssets.audioWasm)}"`,
     "process.env.GENERAL_WASM_PATH": `"${resolveWebPath(outputAssets.generalWasm)}"`,
     "process.env.ZIPPER_WASM_PATH": `"${resolveWebPath(outputAssets.zipperWasm)}"`,
+    "process.env.VISUALIZER_WASM_PATH": `"${resolveWebPath(outputAssets.visualizerWasm)}"`,
     "process.env.SERVICE_WORKER_PATH": `"${resolveWebPath(serviceWorkerOutput)}"`,
     "process.env.MP3_CODEC_PATH": `"${resolveWebPath(outputAssets.mp3Codec)}"`,
     "process.env.REVISION": `"${revision}"`,
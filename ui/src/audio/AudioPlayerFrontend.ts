@@ -6,6 +6,7 @@ import {
     getCurve,
     MAX_SUSTAINED_AUDIO_SECONDS,
     MIN_SUSTAINED_AUDIO_SECONDS,
+    normalizePlaybackRate,
     RENDERED_CHANNEL_COUNT,
     SUSTAINED_BUFFERED_AUDIO_RATIO,
 } from "shared/audio";
@@ -67,6 +68,7 @@ export default class AudioPlayerFrontend extends WorkerFrontend<AudioPlayerResul
     private _suspensionTimeoutId: number = -1;
     private _ignoreNextTrackLoads: boolean = false;
     private _audioPlayerBackendPort: MessagePort | null = null;
+    private _playbackRate: number = 1;
 
     constructor(deps: Deps) {
         super("audio", deps.audioWorker);
@@ -131,6 +133,18 @@ export default class AudioPlayerFrontend extends WorkerFrontend<AudioPlayerResul
         return this.effectPreferencesBindingContext.getCrossfadeDuration();
     }
 
+    get playbackRate() {
+        return this._playbackRate;
+    }
+
+    /**
+     * Changes the tempo without changing the pitch.
+     */
+    setPlaybackRate(playbackRate: number) {
+        this._playbackRate = normalizePlaybackRate(playbackRate);
+        void this._updateBackendConfig({ playbackRate: this._playbackRate });
+    }
+
     private _handleAudioWorkletMessage = (e: MessageEvent<any>) => {
         const message = decode(AudioWorkletMessage, e.data);
         switch (message.type) {
@@ -435,6 +449,7 @@ export default class AudioPlayerFrontend extends WorkerFrontend<AudioPlayerResul
                 sampleRate: this.sampleRate,
                 sustainedBufferedAudioSeconds: this.totalSustainedAudioSeconds,
                 bufferTime: this.bufferLengthSeconds,
+                playbackRate: this._playbackRate,
                 visualizerPort,
             },
             [visualizerPort]
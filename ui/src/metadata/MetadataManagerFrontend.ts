@@ -3,6 +3,7 @@ import {
     FileReference,
     fileReferenceToTrackUid,
     ITrack,
+    LoudnessOfTracksResult,
     MetadataManagerBackendActions,
     MetadataResult,
     TrackInfo,
@@ -465,6 +466,8 @@ export default class MetadataManagerFrontend extends WorkerFrontend<MetadataResu
                 return this._acoustIdDataFetched(result.trackInfo, result.trackInfoUpdated);
             case "albumArt":
                 return this._albumArtResultReceived(result.trackUid, result.albumArt, result.requestReason);
+            case "loudnessOfTracks":
+                return this._loudnessOfTracksReceived(result);
             case "allFilesPersisted":
                 return this._allFilesHaveBeenPersisted();
             case "databaseClosed":
@@ -491,6 +494,15 @@ export default class MetadataManagerFrontend extends WorkerFrontend<MetadataResu
         this.postMessageToMetadataBackend("getAlbumArt", { trackUid, artist, album, preference, requestReason });
     };
 
+    /**
+     * Integrated loudness and loudness range of the tracks played back to back, such as an
+     * album, emitted as loudnessOfTracksReceived.
+     */
+    getLoudnessOfTracks = (tracks: Track[], requestReason: string) => {
+        const trackUids = tracks.map(track => track.uid());
+        this.postMessageToMetadataBackend("getLoudnessOfTracks", { trackUids, requestReason });
+    };
+
     mapTrackUidsToTracks = async (trackUids: ArrayBuffer[]) => {
         const label = "mapTrackUidsToTracks";
         await this.ready();
@@ -560,6 +572,22 @@ export default class MetadataManagerFrontend extends WorkerFrontend<MetadataResu
         }
     };
 
+    _loudnessOfTracksReceived = ({
+        trackUids,
+        integratedLoudness,
+        loudnessRange,
+        requestReason,
+    }: LoudnessOfTracksResult) => {
+        const tracks: Track[] = [];
+        for (const trackUid of trackUids) {
+            const track = this.getTrackByTrackUid(trackUid);
+            if (track) {
+                tracks.push(track);
+            }
+        }
+        this.emit("loudnessOfTracksReceived", tracks, { integratedLoudness, loudnessRange }, requestReason);
+    };
+
     _acoustIdDataFetched = (trackInfo: TrackInfo, trackInfoUpdated: boolean) => {
         const { trackUid } = trackInfo;
         const track = this.getTrackByTrackUid(trackUid);
@@ -666,6 +694,11 @@ interface MetadataManagerEventsMap {
     newTrackFromTmpFileReceived: (track: Track) => void;
     mediaLibrarySizeChanged: (count: number) => void;
     albumArtReceived: (track: Track, albumArt: string | string[] | null, requestReason: string) => void;
+    loudnessOfTracksReceived: (
+        tracks: Track[],
+        loudness: { integratedLoudness: number; loudnessRange: number },
+        requestReason: string
+    ) => void;
     allFilesPersisted: () => void;
 }
 
@@ -36,7 +36,7 @@ export default class Default2dImageRenderer {
         this.context.fillRect(0, 0, this.width, this.height);
     }
 
-    drawCaps(bins: Float64Array) {
+    drawCaps(bins: Float32Array) {
         const highestBinHeight = this.renderer.getHighestBinHeight();
         const { gapWidth, capSeparator, currentCapPositions } = this.renderer;
         const binSpace = this.renderer.binWidth + gapWidth;
@@ -71,7 +71,7 @@ export default class Default2dImageRenderer {
         }
     }
 
-    drawBins(bins: Float64Array) {
+    drawBins(bins: Float32Array) {
         const highestBinHeight = this.renderer.getHighestBinHeight();
         const { binWidth, gapWidth } = this.renderer;
         const fullWidth = binWidth + gapWidth * 2;
@@ -255,7 +255,7 @@ export default class Renderer {
         }
     }
 
-    drawBins(now: number, bins: Float64Array) {
+    drawBins(now: number, bins: Float32Array) {
         if (this.contextLost) {
             return false;
         }
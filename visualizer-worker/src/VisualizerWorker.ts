@@ -1,4 +1,5 @@
 import { setIsDevelopment } from "shared/util";
+import WebAssemblyWrapper from "shared/wasm/WebAssemblyWrapper";
 
 import AudioVisualizerBackend from "./AudioVisualizerBackend";
 
@@ -26,5 +27,18 @@ self.addEventListener(`unhandledrejection`, event => {
 
 void (async () => {
     setIsDevelopment(isDevelopment);
-    new AudioVisualizerBackend().start();
+
+    const request = new Request(process.env.VISUALIZER_WASM_PATH!, {
+        cache: env.isDevelopment() ? `no-store` : `default`,
+    });
+    const response = await fetch(request);
+    if (!response.ok) {
+        throw new Error(`response not ok: ${response.status}`);
+    }
+    const bufferSource = await response.arrayBuffer();
+    const module = await WebAssembly.compile(bufferSource);
+    const wasm = new WebAssemblyWrapper(module, `visualizer`);
+    await wasm.start();
+
+    new AudioVisualizerBackend(wasm).start();
 })();
@@ -235,7 +235,7 @@ export default class WebGl2dImageRenderer extends EventEmitter {
         }
     }
 
-    populateCapTexturePositions(bins: Float64Array) {
+    populateCapTexturePositions(bins: Float32Array) {
         if (this.capTexturePositionsPopulatedForLength !== bins.length) {
             const capSourceX = this.renderer.source!.capX - this.renderer.gapWidth;
             const capSourceY = this.renderer.source!.capY - this.renderer.gapWidth;
@@ -265,7 +265,7 @@ export default class WebGl2dImageRenderer extends EventEmitter {
         }
     }
 
-    drawCaps(bins: Float64Array) {
+    drawCaps(bins: Float32Array) {
         if (this.positionIndex !== 0) throw new Error(`caps must be drawn first`);
         this.populateCapTexturePositions(bins);
         const highestBinHeight = this.renderer.getHighestBinHeight();
@@ -309,7 +309,7 @@ export default class WebGl2dImageRenderer extends EventEmitter {
         this.draws += bins.length;
     }
 
-    drawBins(bins: Float64Array) {
+    drawBins(bins: Float32Array) {
         const positions = this.positionsInt32View;
         let j = this.positionIndex / 2;
 